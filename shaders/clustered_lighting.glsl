@@ -0,0 +1,125 @@
+// Clustered forward/deferred lighting, shared by scene.frag and deferred_lighting.frag.
+// The light lists are laid out as described in src/light_clusters.h; needs frame_uniforms.glsl.
+uniform samplerBuffer uLights;
+uniform usamplerBuffer uClusters;
+uniform usamplerBuffer uLightIndices;
+
+// Shadow lookups, laid out as ShadowUniforms in src/shadow_maps.h. The matrices take view-space
+// positions to shadow texture coordinates (atlas matrices into their own tile) and depth.
+layout (std140) uniform ShadowUniforms
+{
+    mat4 cascade_matrices[4];
+    vec4 cascade_splits;    // Far view depth of each cascade
+    vec4 cascade_texels;    // View-space size of a texel of each cascade
+    vec4 shadow_params;     // x = cascades in use, y = tiles per atlas row, z = 1 / y, w = atlas texel size
+    mat4 tile_matrices[64];
+};
+uniform sampler2DArrayShadow uShadowCascades;
+uniform sampler2DShadow uShadowAtlas;
+
+// First index and light count of the cluster holding a fragment at a view-space position;
+// depths outside the sliced range have no lights
+uvec2 light_cluster(vec2 frag_coord, vec3 position)
+{
+    float depth = -position.z;
+    if (depth < cluster_depth.z || depth > cluster_depth.w)
+        return uvec2(0u);
+    ivec3 cell = ivec3(vec3(frag_coord / cluster_grid.w, log(depth) * cluster_depth.x + cluster_depth.y));
+    cell = clamp(cell, ivec3(0), ivec3(cluster_grid.xyz) - 1);
+    return texelFetch(uClusters, (cell.z * int(cluster_grid.y) + cell.y) * int(cluster_grid.x) + cell.x).xy;
+}
+
+// Blue -> green -> red over [0, 1], white past it
+vec3 light_heat(uvec2 range)
+{
+    float t = float(range.y) / 32.0;
+    if (t > 1.0)
+        return vec3(1.0);
+    return clamp(vec3(2.0 * t - 0.5, 1.5 - abs(2.0 * t - 1.0) * 2.0, 1.0 - 2.0 * t), 0.0, 1.0);
+}
+
+// Sun visibility from the first cascade reaching the point's depth, 4 taps of 2x2 PCF.
+// The lookup is pushed out along the normal by two texels to keep acne off lit slopes.
+float sun_shadow(vec3 position, vec3 n)
+{
+    int count = int(shadow_params.x);
+    int c = 0;
+    while (c < count && -position.z > cascade_splits[c])
+        c++;
+    if (c >= count)
+        return 1.0;
+    vec4 s = cascade_matrices[c] * vec4(position + n * (2.0 * cascade_texels[c]), 1.0);
+    vec2 texel = 0.5 / vec2(textureSize(uShadowCascades, 0).xy);
+    float lit = texture(uShadowCascades, vec4(s.xy + vec2(-texel.x, -texel.y), float(c), s.z));
+    lit += texture(uShadowCascades, vec4(s.xy + vec2(texel.x, -texel.y), float(c), s.z));
+    lit += texture(uShadowCascades, vec4(s.xy + vec2(-texel.x, texel.y), float(c), s.z));
+    lit += texture(uShadowCascades, vec4(s.xy + vec2(texel.x, texel.y), float(c), s.z));
+    return lit * 0.25;
+}
+
+// Visibility from one shadow atlas tile; taps are clamped to the tile so they never read a neighbour
+float tile_shadow(int tile, vec3 position)
+{
+    vec4 s = tile_matrices[tile] * vec4(position, 1.0);
+    s.xyz /= s.w;
+    int row = int(shadow_params.y);
+    vec2 lo = vec2(float(tile % row), float(tile / row)) * shadow_params.z + 1.5 * shadow_params.w;
+    vec2 hi = lo + shadow_params.z - 3.0 * shadow_params.w;
+    float texel = 0.5 * shadow_params.w;
+    float lit = texture(uShadowAtlas, vec3(clamp(s.xy + vec2(-texel, -texel), lo, hi), s.z));
+    lit += texture(uShadowAtlas, vec3(clamp(s.xy + vec2(texel, -texel), lo, hi), s.z));
+    lit += texture(uShadowAtlas, vec3(clamp(s.xy + vec2(-texel, texel), lo, hi), s.z));
+    lit += texture(uShadowAtlas, vec3(clamp(s.xy + vec2(texel, texel), lo, hi), s.z));
+    return lit * 0.25;
+}
+
+// Light reaching a view-space point from the headlight, the sun and its cluster's lights.
+// n must be normalised and face the eye.
+vec3 surface_light(vec3 position, vec3 n, uvec2 range)
+{
+    vec3 light = vec3(lighting.x * (0.35 + 0.65 * dot(n, normalize(-position))));
+    float sun = max(dot(n, -sun_direction.xyz), 0.0);
+    if (sun > 0.0 && sun_direction.w > 0.5)
+        sun *= sun_shadow(position, n);
+    light += sun_colour.rgb * sun;
+
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int l = int(texelFetch(uLightIndices, int(range.x + i)).r) * 4;
+        vec4 position_range = texelFetch(uLights, l);
+        vec4 colour_cone = texelFetch(uLights, l + 1);
+        vec4 direction_cone = texelFetch(uLights, l + 2);
+        vec4 shadow = texelFetch(uLights, l + 3);
+
+        vec3 to_light = position_range.xyz - position;
+        float d2 = max(dot(to_light, to_light), 1e-8);
+        float r2 = position_range.w * position_range.w;
+        if (d2 >= r2)
+            continue;
+        vec3 l_dir = to_light * inversesqrt(d2);
+        // Inverse-square-like falloff, windowed to reach zero exactly at the binned range
+        float window = 1.0 - (d2 * d2) / (r2 * r2);
+        float attenuation = window * window / (1.0 + 16.0 * d2 / r2);
+        float cone = clamp((dot(-l_dir, direction_cone.xyz) - colour_cone.w) * direction_cone.w, 0.0, 1.0);
+        float amount = max(dot(n, l_dir), 0.0) * attenuation * cone;
+        if (amount > 0.0 && shadow.x >= 0.0)
+        {
+            // Point lights use the cube face (+X, -X, +Y, -Y, +Z, -Z tiles) facing the point in world space
+            int tile = int(shadow.x);
+            if (shadow.y > 0.5)
+            {
+                vec3 d = transpose(mat3(view)) * -to_light;
+                vec3 a = abs(d);
+                if (a.x >= a.y && a.x >= a.z)
+                    tile += d.x < 0.0 ? 1 : 0;
+                else if (a.y >= a.z)
+                    tile += d.y < 0.0 ? 3 : 2;
+                else
+                    tile += d.z < 0.0 ? 5 : 4;
+            }
+            amount *= tile_shadow(tile, position + n * (0.01 * sqrt(d2)));
+        }
+        light += colour_cone.rgb * amount;
+    }
+    return light;
+}
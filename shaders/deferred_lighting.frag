@@ -0,0 +1,40 @@
+#version 330 core
+// Deferred lighting: one fullscreen pass reading the G-buffer (layout in src/gbuffer.h) and
+// shading every covered pixel with its light cluster, exactly like the forward path would
+out vec4 FragColor;
+
+#include "frame_uniforms.glsl"
+#include "clustered_lighting.glsl"
+
+uniform sampler2D uAlbedo;
+uniform sampler2D uNormal;
+uniform sampler2D uDepth;
+uniform mat4 uInverseProjection;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    // The G-buffer is pooled and may be larger than the viewport, so address it by pixel
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(uDepth, pixel, 0).r;
+    if (depth >= 1.0)
+        discard;    // Background keeps the clear colour
+
+    vec4 ndc = vec4(vec3(gl_FragCoord.xy * viewport_size.zw, depth) * 2.0 - 1.0, 1.0);
+    vec4 view_position = uInverseProjection * ndc;
+    vec3 position = view_position.xyz / view_position.w;
+    vec3 n = oct_decode(texelFetch(uNormal, pixel, 0).rg * 2.0 - 1.0);
+
+    uvec2 range = light_cluster(gl_FragCoord.xy, position);
+    if (lighting.y > 0.5)
+        FragColor = vec4(light_heat(range), 1.0);
+    else
+        FragColor = vec4(texelFetch(uAlbedo, pixel, 0).rgb * surface_light(position, n, range), 1.0);
+}
@@ -0,0 +1,15 @@
+// Per-frame camera/global data, bound once at UNIFORM_BINDING_FRAME (see src/frame_uniforms.h)
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 camera_position;   // xyz = world position
+    vec4 viewport_size;     // xy = pixels, zw = 1 / pixels
+    vec4 time;              // x = seconds since start
+    vec4 cluster_grid;      // xyz = light clusters per axis, w = tile size in pixels
+    vec4 cluster_depth;     // x, y = depth slice scale and bias, zw = view depth range sliced
+    vec4 lighting;          // x = headlight strength, y = 1 for the light heat view
+    vec4 sun_direction;     // xyz = view-space direction the sunlight travels, w = 1 with shadows
+    vec4 sun_colour;        // rgb = colour * intensity, 0 without a sun
+};
@@ -0,0 +1,10 @@
+#version 330 core
+// One oversized triangle covering the viewport, no vertex buffer needed (see src/fullscreen_pass.h)
+out vec2 vUV;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    vUV = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+// Base level of the Hi-Z pyramid (see src/occlusion_culling.h): each output texel holds the
+// farthest depth of its uFootprint x uFootprint block of the rendered depth region
+out float FragDepth;
+
+uniform sampler2D uDepth;
+uniform ivec2 uSourceSize;  // Rendered region of uDepth in texels
+uniform int uFootprint;
+
+void main()
+{
+    ivec2 first = ivec2(gl_FragCoord.xy) * uFootprint;
+    ivec2 last = min(first + ivec2(uFootprint), uSourceSize);
+    float depth = 0.0;
+    for (int y = first.y; y < last.y; y++)
+        for (int x = first.x; x < last.x; x++)
+            depth = max(depth, texelFetch(uDepth, ivec2(x, y), 0).r);
+    FragDepth = depth;
+}
@@ -0,0 +1,9 @@
+#version 330 core
+// Overdraw heat view: drawn with additive blending, so each shaded fragment adds one step
+// and the image brightens from red through yellow to white where fragments stack up
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(0.12, 0.06, 0.02, 1.0);
+}
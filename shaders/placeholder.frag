@@ -0,0 +1,9 @@
+#version 330 core
+// Drawn with scene.vert while the real material program is still compiling
+in vec4 vColour;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(vec3(0.5), vColour.a);
+}
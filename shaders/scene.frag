@@ -0,0 +1,63 @@
+#version 330 core
+// Forward shading with the clustered lights; with GBUFFER, writes the deferred path's
+// G-buffer instead (layout in src/gbuffer.h) and leaves lighting to deferred_lighting.frag
+in vec4 vColour;
+in vec3 vNormal;
+in vec3 vViewPosition;
+in vec2 vUV;
+flat in vec4 vTextureRect;
+flat in float vTextureLayer;
+
+#include "frame_uniforms.glsl"
+
+// The object's streamed texture, or a white texel for untextured objects; pooled textures are a
+// rect of a uAlbedoArray layer instead (see src/texture_pool.h)
+uniform sampler2D uAlbedoMap;
+uniform sampler2DArray uAlbedoArray;
+
+vec3 albedo_texel()
+{
+    // Explicit gradients of the unwrapped UVs: the wrap into the rect would otherwise pick the
+    // smallest mip along the seam, and the layer may differ between neighbouring pixels
+    vec2 dx = dFdx(vUV);
+    vec2 dy = dFdy(vUV);
+    if (vTextureLayer < 0.0)
+        return textureGrad(uAlbedoMap, vUV, dx, dy).rgb;
+    vec2 uv = vTextureRect.xy + fract(vUV) * vTextureRect.zw;
+    return textureGrad(uAlbedoArray, vec3(uv, vTextureLayer), dx * vTextureRect.zw, dy * vTextureRect.zw).rgb;
+}
+
+#ifdef GBUFFER
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+vec2 oct_encode(vec3 n)
+{
+    vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+    if (n.z < 0.0)
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    return p;
+}
+#else
+out vec4 FragColor;
+#include "clustered_lighting.glsl"
+#endif
+
+void main()
+{
+    // Two-sided: light the side facing the eye (quads are drawn without culling)
+    vec3 n = normalize(mat3(view) * vNormal);
+    n = dot(n, vViewPosition) > 0.0 ? -n : n;
+    vec3 albedo = vColour.rgb * albedo_texel();
+
+#ifdef GBUFFER
+    gAlbedo = vec4(albedo, 1.0);
+    gNormal = vec4(oct_encode(n) * 0.5 + 0.5, 0.0, 0.0);
+#else
+    uvec2 range = light_cluster(gl_FragCoord.xy, vViewPosition);
+    if (lighting.y > 0.5)
+        FragColor = vec4(light_heat(range), 1.0);
+    else
+        FragColor = vec4(albedo * surface_light(vViewPosition, n, range), vColour.a);
+#endif
+}
@@ -0,0 +1,54 @@
+#version 330 core
+// Camera data comes from the shared FrameUniforms block; per-object data comes from the
+// per-instance stream (InstanceData in src/instance_renderer.h), indexed by gl_InstanceID
+// through the attribute divisor. Attribute locations match MESH_ATTRIB_* in src/mesh.h.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aUV;
+layout (location = 4) in vec4 aModelRow0;
+layout (location = 5) in vec4 aModelRow1;
+layout (location = 6) in vec4 aModelRow2;
+layout (location = 7) in vec4 aColour;
+layout (location = 8) in vec4 aTextureRect;     // Pooled textures' rect in their array layer
+layout (location = 9) in float aTextureLayer;   // -1 for a texture of its own
+// Per-mesh constants for quantized vertex formats (see src/vertex_format.h)
+layout (location = 10) in vec4 aPositionOffset; // w = 1 when aNormal.xy is octahedral
+layout (location = 11) in vec4 aPositionScale;
+layout (location = 12) in vec4 aUVTransform;    // xy = offset, zw = scale
+
+#include "frame_uniforms.glsl"
+
+out vec4 vColour;
+out vec3 vNormal;
+out vec3 vViewPosition;
+out vec2 vUV;
+flat out vec4 vTextureRect;
+flat out float vTextureLayer;
+
+// The depth pre-pass and the GL_EQUAL shading pass are separate programs sharing this shader;
+// invariance guarantees they produce bit-identical depths
+invariant gl_Position;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec4 local = vec4(aPositionOffset.xyz + aPos * aPositionScale.xyz, 1.0);
+    vec4 world = vec4(dot(aModelRow0, local), dot(aModelRow1, local), dot(aModelRow2, local), 1.0);
+    gl_Position = view_projection * world;
+    vViewPosition = (view * world).xyz;
+
+    // The model rows transform normals exactly for uniform scales, approximately otherwise
+    vec3 normal = aPositionOffset.w > 0.5 ? oct_decode(aNormal.xy) : aNormal;
+    vNormal = vec3(dot(aModelRow0.xyz, normal), dot(aModelRow1.xyz, normal), dot(aModelRow2.xyz, normal));
+    vUV = aUVTransform.xy + aUV * aUVTransform.zw;
+    vColour = aColour;
+    vTextureRect = aTextureRect;
+    vTextureLayer = aTextureLayer;
+}
@@ -0,0 +1,29 @@
+#version 330 core
+// Stretches the rendered part of a (possibly larger, pooled) source texture over the target.
+// Bilinear by default; with SHARPEN, a 4-tap unsharp mask in source texels restores some of
+// the edge contrast lost to the lower render resolution.
+in vec2 vUV;
+out vec4 FragColor;
+
+uniform sampler2D uSource;
+uniform vec2 uUVMax;        // Far corner of the rendered region in source texture coordinates
+uniform vec2 uTexelSize;    // 1 / source texture size
+uniform float uSharpness;
+
+vec3 fetch(vec2 uv)
+{
+    // Keep taps inside the rendered region; the rest of the pooled texture is stale
+    return texture(uSource, clamp(uv, uTexelSize * 0.5, uUVMax - uTexelSize * 0.5)).rgb;
+}
+
+void main()
+{
+    vec2 uv = vUV * uUVMax;
+    vec3 colour = fetch(uv);
+#ifdef SHARPEN
+    vec3 neighbours = fetch(uv + vec2(uTexelSize.x, 0.0)) + fetch(uv - vec2(uTexelSize.x, 0.0)) +
+                      fetch(uv + vec2(0.0, uTexelSize.y)) + fetch(uv - vec2(0.0, uTexelSize.y));
+    colour = max(colour + uSharpness * (colour - neighbours * 0.25), vec3(0.0));
+#endif
+    FragColor = vec4(colour, 1.0);
+}
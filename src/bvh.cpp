@@ -0,0 +1,527 @@
+#include "bvh.h"
+#include "job_system.h"
+
+#include <algorithm>
+
+// Half the surface area; only ratios matter for the SAH
+static float half_area(const glm::vec3& lo, const glm::vec3& hi)
+{
+    glm::vec3 d = glm::max(hi - lo, glm::vec3(0.0f));
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// Entry distance of the ray into the box, or -1 if it misses within [0, max_t]
+static float ray_box(const glm::vec3& origin, const glm::vec3& inv_dir, const glm::vec3& lo, const glm::vec3& hi, float max_t)
+{
+    glm::vec3 t0 = (lo - origin) * inv_dir;
+    glm::vec3 t1 = (hi - origin) * inv_dir;
+    glm::vec3 t_small = glm::min(t0, t1);
+    glm::vec3 t_big = glm::max(t0, t1);
+    float t_enter = glm::max(glm::max(t_small.x, t_small.y), glm::max(t_small.z, 0.0f));
+    float t_exit = glm::min(glm::min(t_big.x, t_big.y), glm::min(t_big.z, max_t));
+    return t_enter <= t_exit ? t_enter : -1.0f;
+}
+
+enum BoxClass { BOX_OUTSIDE, BOX_INTERSECTS, BOX_INSIDE };
+
+static BoxClass classify_box(const Frustum& frustum, const glm::vec3& lo, const glm::vec3& hi)
+{
+    BoxClass result = BOX_INSIDE;
+    for (const glm::vec4& p : frustum.planes)
+    {
+        // Corner furthest along the plane normal decides "outside", the nearest one "inside"
+        glm::vec3 far_corner(p.x >= 0.0f ? hi.x : lo.x, p.y >= 0.0f ? hi.y : lo.y, p.z >= 0.0f ? hi.z : lo.z);
+        glm::vec3 near_corner(p.x >= 0.0f ? lo.x : hi.x, p.y >= 0.0f ? lo.y : hi.y, p.z >= 0.0f ? lo.z : hi.z);
+        if (p.x * far_corner.x + p.y * far_corner.y + p.z * far_corner.z + p.w < 0.0f)
+            return BOX_OUTSIDE;
+        if (p.x * near_corner.x + p.y * near_corner.y + p.z * near_corner.z + p.w < 0.0f)
+            result = BOX_INTERSECTS;
+    }
+    return result;
+}
+
+void Bvh::clear()
+{
+    root = -1;
+    nodes.clear();
+    items.clear();
+    item_leaf.clear();
+    item_lo.clear();
+    item_hi.clear();
+    build_cost = 0.0f;
+}
+
+// Bound items [begin, end) into lo/hi and, unless they should stay a leaf, partition them
+// around the cheapest binned SAH plane and return the split point in mid
+bool Bvh::split(int begin, int end, glm::vec3& lo, glm::vec3& hi, int& mid)
+{
+    BuildItem* data = build_items.data();
+    lo = glm::vec3(1e30f);
+    hi = glm::vec3(-1e30f);
+    glm::vec3 centroid_lo(1e30f), centroid_hi(-1e30f);
+    for (int i = begin; i < end; i++)
+    {
+        lo = glm::min(lo, data[i].lo);
+        hi = glm::max(hi, data[i].hi);
+        centroid_lo = glm::min(centroid_lo, data[i].centroid);
+        centroid_hi = glm::max(centroid_hi, data[i].centroid);
+    }
+    const int count = end - begin;
+    if (count <= max_leaf_items)
+        return false;
+
+    // Bin all three axes in one pass over the items
+    struct Bin
+    {
+        glm::vec3 lo = glm::vec3(1e30f), hi = glm::vec3(-1e30f);
+        int count = 0;
+    };
+    Bin bins[3][bin_count];
+    glm::vec3 to_bin(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroid_hi[axis] - centroid_lo[axis];
+        to_bin[axis] = extent > 1e-12f ? bin_count / extent : 0.0f;
+    }
+    for (int i = begin; i < end; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int b = std::min((int)((data[i].centroid[axis] - centroid_lo[axis]) * to_bin[axis]), bin_count - 1);
+            Bin& bin = bins[axis][b];
+            bin.lo = glm::min(bin.lo, data[i].lo);
+            bin.hi = glm::max(bin.hi, data[i].hi);
+            bin.count++;
+        }
+    }
+
+    float best_cost = 1e30f;
+    int best_axis = -1, best_bin = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (to_bin[axis] == 0.0f)
+            continue;
+        // Sweep from the right to get the cost of everything past each plane, then from the left
+        float right_area[bin_count];
+        int right_count[bin_count];
+        Bin right;
+        for (int b = bin_count - 1; b > 0; b--)
+        {
+            right.lo = glm::min(right.lo, bins[axis][b].lo);
+            right.hi = glm::max(right.hi, bins[axis][b].hi);
+            right.count += bins[axis][b].count;
+            right_area[b] = half_area(right.lo, right.hi);
+            right_count[b] = right.count;
+        }
+        Bin left;
+        for (int b = 0; b < bin_count - 1; b++)
+        {
+            left.lo = glm::min(left.lo, bins[axis][b].lo);
+            left.hi = glm::max(left.hi, bins[axis][b].hi);
+            left.count += bins[axis][b].count;
+            if (left.count == 0 || right_count[b + 1] == 0)
+                continue;
+            float cost = half_area(left.lo, left.hi) * left.count + right_area[b + 1] * right_count[b + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b + 1;
+            }
+        }
+    }
+
+    if (best_axis >= 0)
+    {
+        // Splitting costs one traversal step; keep small sets as a leaf if that is cheaper
+        const float node_area = half_area(lo, hi);
+        float split_cost = 1.0f + (node_area > 0.0f ? best_cost / node_area : 0.0f);
+        if (split_cost >= (float)count && count <= 4 * max_leaf_items)
+            return false;
+        const float cmin = centroid_lo[best_axis];
+        const float scale = to_bin[best_axis];
+        BuildItem* middle = std::partition(data + begin, data + end, [&](const BuildItem& item)
+        {
+            return std::min((int)((item.centroid[best_axis] - cmin) * scale), bin_count - 1) < best_bin;
+        });
+        mid = (int)(middle - data);
+        if (mid > begin && mid < end)
+            return true;
+    }
+    // All centroids coincide: any split is as good as another, halve the range
+    mid = begin + count / 2;
+    return true;
+}
+
+void Bvh::build_subtree(int begin, int end, std::vector<BvhNode>& out)
+{
+    struct Work { int node, begin, end; };
+    out.clear();
+    out.emplace_back();
+    std::vector<Work> stack;
+    stack.push_back({ 0, begin, end });
+    while (!stack.empty())
+    {
+        Work work = stack.back();
+        stack.pop_back();
+        glm::vec3 lo, hi;
+        int mid = 0;
+        bool internal = split(work.begin, work.end, lo, hi, mid);
+        out[work.node].lo = lo;
+        out[work.node].hi = hi;
+        if (!internal)
+        {
+            out[work.node].first = work.begin;
+            out[work.node].count = work.end - work.begin;
+            continue;
+        }
+        int left = (int)out.size();
+        out.emplace_back();
+        out.emplace_back();
+        out[left].parent = out[left + 1].parent = work.node;
+        out[work.node].left = left;
+        out[work.node].right = left + 1;
+        stack.push_back({ left, work.begin, mid });
+        stack.push_back({ left + 1, mid, work.end });
+    }
+}
+
+void Bvh::build(const std::vector<glm::vec3>& lo, const std::vector<glm::vec3>& hi)
+{
+    clear();
+    const int count = (int)lo.size();
+    if (count == 0)
+        return;
+    item_lo = lo;
+    item_hi = hi;
+    items.resize(count);
+    // Partitioning moves the items' bounds along with them, so every split reads memory in order
+    build_items.resize(count);
+    job_system().parallel_for(count, 65536, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            build_items[i] = { lo[i], hi[i], (lo[i] + hi[i]) * 0.5f, (uint32_t)i };
+    });
+
+    // Split the top of the tree here until the ranges are small enough to hand out, so every
+    // worker gets several subtrees and uneven splits still balance out
+    struct Work { int node, begin, end; };
+    const int threads = job_system().thread_count();
+    const int serial_limit = std::max(count / (threads * 4), 4096);
+    std::vector<Work> frontier, tasks;
+    root = 0;
+    nodes.emplace_back();
+    frontier.push_back({ 0, 0, count });
+    while (!frontier.empty())
+    {
+        Work work = frontier.back();
+        frontier.pop_back();
+        if (threads < 2 || work.end - work.begin <= serial_limit)
+        {
+            tasks.push_back(work);
+            continue;
+        }
+        glm::vec3 node_lo, node_hi;
+        int mid = 0;
+        bool internal = split(work.begin, work.end, node_lo, node_hi, mid);
+        nodes[work.node].lo = node_lo;
+        nodes[work.node].hi = node_hi;
+        if (!internal)
+        {
+            nodes[work.node].first = work.begin;
+            nodes[work.node].count = work.end - work.begin;
+            continue;
+        }
+        int left = (int)nodes.size();
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[left].parent = nodes[left + 1].parent = work.node;
+        nodes[work.node].left = left;
+        nodes[work.node].right = left + 1;
+        frontier.push_back({ left, work.begin, mid });
+        frontier.push_back({ left + 1, mid, work.end });
+    }
+
+    std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+    job_system().run_tasks((int)tasks.size(), [&](int t)
+    {
+        build_subtree(tasks[t].begin, tasks[t].end, subtrees[t]);
+    });
+
+    // Stitch: each subtree root replaces its placeholder node, the rest are appended
+    for (size_t t = 0; t < tasks.size(); t++)
+    {
+        const std::vector<BvhNode>& local = subtrees[t];
+        const int placeholder = tasks[t].node;
+        const int offset = (int)nodes.size() - 1;
+        auto remap = [&](int k) { return k == 0 ? placeholder : offset + k; };
+        nodes.resize(nodes.size() + local.size() - 1);
+        for (int k = 0; k < (int)local.size(); k++)
+        {
+            BvhNode node = local[k];
+            node.parent = k == 0 ? nodes[placeholder].parent : remap(node.parent);
+            if (!node.is_leaf())
+            {
+                node.left = remap(node.left);
+                node.right = remap(node.right);
+            }
+            nodes[remap(k)] = node;
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        items[i] = build_items[i].index;
+    build_items.clear();
+    build_items.shrink_to_fit();
+
+    item_leaf.assign(count, -1);
+    for (int n = 0; n < (int)nodes.size(); n++)
+        for (int i = 0; i < nodes[n].count; i++)
+            item_leaf[items[nodes[n].first + i]] = n;
+
+    build_cost = sah_cost();
+}
+
+void Bvh::refit_from(int node)
+{
+    while (node >= 0)
+    {
+        BvhNode& n = nodes[node];
+        glm::vec3 lo = glm::min(nodes[n.left].lo, nodes[n.right].lo);
+        glm::vec3 hi = glm::max(nodes[n.left].hi, nodes[n.right].hi);
+        // Once a node's bounds are unchanged, none of its ancestors can change either
+        if (lo == n.lo && hi == n.hi)
+            return;
+        n.lo = lo;
+        n.hi = hi;
+        node = n.parent;
+    }
+}
+
+void Bvh::insert(const glm::vec3& lo, const glm::vec3& hi)
+{
+    const int item = item_count();
+    item_lo.push_back(lo);
+    item_hi.push_back(hi);
+    items.push_back((uint32_t)item);
+
+    int leaf = (int)nodes.size();
+    nodes.emplace_back();
+    nodes[leaf].lo = lo;
+    nodes[leaf].hi = hi;
+    nodes[leaf].first = (int)items.size() - 1;
+    nodes[leaf].count = 1;
+    item_leaf.push_back(leaf);
+    if (root < 0)
+    {
+        root = leaf;
+        return;
+    }
+
+    // Walk down towards the sibling whose pairing grows the tree's total area the least
+    int sibling = root;
+    while (!nodes[sibling].is_leaf())
+    {
+        const BvhNode& n = nodes[sibling];
+        float area = half_area(n.lo, n.hi);
+        float combined = half_area(glm::min(n.lo, lo), glm::max(n.hi, hi));
+        float cost_here = 2.0f * combined;
+        float inherited = 2.0f * (combined - area);
+        auto descend_cost = [&](int child)
+        {
+            const BvhNode& c = nodes[child];
+            float grown = half_area(glm::min(c.lo, lo), glm::max(c.hi, hi));
+            return (c.is_leaf() ? grown : grown - half_area(c.lo, c.hi)) + inherited;
+        };
+        float cost_left = descend_cost(n.left);
+        float cost_right = descend_cost(n.right);
+        if (cost_here < cost_left && cost_here < cost_right)
+            break;
+        sibling = cost_left < cost_right ? n.left : n.right;
+    }
+
+    int parent = (int)nodes.size();
+    nodes.emplace_back();
+    int old_parent = nodes[sibling].parent;
+    nodes[parent].parent = old_parent;
+    nodes[parent].left = sibling;
+    nodes[parent].right = leaf;
+    nodes[parent].lo = glm::min(nodes[sibling].lo, lo);
+    nodes[parent].hi = glm::max(nodes[sibling].hi, hi);
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+    if (old_parent < 0)
+    {
+        root = parent;
+        return;
+    }
+    if (nodes[old_parent].left == sibling)
+        nodes[old_parent].left = parent;
+    else
+        nodes[old_parent].right = parent;
+    refit_from(old_parent);
+}
+
+void Bvh::update(int item, const glm::vec3& lo, const glm::vec3& hi)
+{
+    item_lo[item] = lo;
+    item_hi[item] = hi;
+    int leaf = item_leaf[item];
+    BvhNode& n = nodes[leaf];
+    glm::vec3 leaf_lo(1e30f), leaf_hi(-1e30f);
+    for (int i = 0; i < n.count; i++)
+    {
+        leaf_lo = glm::min(leaf_lo, item_lo[items[n.first + i]]);
+        leaf_hi = glm::max(leaf_hi, item_hi[items[n.first + i]]);
+    }
+    if (leaf_lo == n.lo && leaf_hi == n.hi)
+        return;
+    n.lo = leaf_lo;
+    n.hi = leaf_hi;
+    refit_from(n.parent);
+}
+
+float Bvh::sah_cost() const
+{
+    if (root < 0)
+        return 0.0f;
+    double cost = 0.0;
+    for (const BvhNode& n : nodes)
+        cost += half_area(n.lo, n.hi) * (n.is_leaf() ? n.count : 1);
+    float root_area = half_area(nodes[root].lo, nodes[root].hi);
+    return root_area > 0.0f ? (float)(cost / root_area) : 0.0f;
+}
+
+void Bvh::collect(int node, std::vector<uint32_t>& out) const
+{
+    std::vector<int> stack;
+    stack.push_back(node);
+    while (!stack.empty())
+    {
+        const BvhNode& n = nodes[stack.back()];
+        stack.pop_back();
+        if (n.is_leaf())
+        {
+            out.insert(out.end(), items.begin() + n.first, items.begin() + n.first + n.count);
+            continue;
+        }
+        stack.push_back(n.left);
+        stack.push_back(n.right);
+    }
+}
+
+void Bvh::query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const
+{
+    if (root < 0)
+        return;
+    std::vector<int> stack;
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const int node = stack.back();
+        stack.pop_back();
+        const BvhNode& n = nodes[node];
+        BoxClass box = classify_box(frustum, n.lo, n.hi);
+        if (box == BOX_OUTSIDE)
+            continue;
+        if (box == BOX_INSIDE)
+        {
+            collect(node, out);
+            continue;
+        }
+        if (n.is_leaf())
+        {
+            for (int i = 0; i < n.count; i++)
+            {
+                uint32_t item = items[n.first + i];
+                if (classify_box(frustum, item_lo[item], item_hi[item]) != BOX_OUTSIDE)
+                    out.push_back(item);
+            }
+            continue;
+        }
+        stack.push_back(n.left);
+        stack.push_back(n.right);
+    }
+}
+
+void Bvh::query_box(const glm::vec3& lo, const glm::vec3& hi, std::vector<uint32_t>& out) const
+{
+    if (root < 0)
+        return;
+    auto overlaps = [&](const glm::vec3& a_lo, const glm::vec3& a_hi)
+    {
+        return a_lo.x <= hi.x && a_hi.x >= lo.x && a_lo.y <= hi.y && a_hi.y >= lo.y && a_lo.z <= hi.z && a_hi.z >= lo.z;
+    };
+    std::vector<int> stack;
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const BvhNode& n = nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(n.lo, n.hi))
+            continue;
+        if (!n.is_leaf())
+        {
+            stack.push_back(n.left);
+            stack.push_back(n.right);
+            continue;
+        }
+        for (int i = 0; i < n.count; i++)
+        {
+            uint32_t item = items[n.first + i];
+            if (overlaps(item_lo[item], item_hi[item]))
+                out.push_back(item);
+        }
+    }
+}
+
+int Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_t,
+                 const std::function<float(int item, float best_t)>& intersect, float& hit_t) const
+{
+    int hit = -1;
+    hit_t = max_t;
+    if (root < 0)
+        return -1;
+    const glm::vec3 inv_dir = glm::vec3(1.0f) / direction;
+
+    struct Entry { int node; float t; };
+    std::vector<Entry> stack;
+    float root_t = ray_box(origin, inv_dir, nodes[root].lo, nodes[root].hi, hit_t);
+    if (root_t >= 0.0f)
+        stack.push_back({ root, root_t });
+    while (!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.t > hit_t)
+            continue;
+        const BvhNode& n = nodes[entry.node];
+        if (n.is_leaf())
+        {
+            for (int i = 0; i < n.count; i++)
+            {
+                uint32_t item = items[n.first + i];
+                if (ray_box(origin, inv_dir, item_lo[item], item_hi[item], hit_t) < 0.0f)
+                    continue;
+                float t = intersect((int)item, hit_t);
+                if (t >= 0.0f && t < hit_t)
+                {
+                    hit_t = t;
+                    hit = (int)item;
+                }
+            }
+            continue;
+        }
+        float t_left = ray_box(origin, inv_dir, nodes[n.left].lo, nodes[n.left].hi, hit_t);
+        float t_right = ray_box(origin, inv_dir, nodes[n.right].lo, nodes[n.right].hi, hit_t);
+        // Push the far child first so the near one is visited first and shrinks hit_t early
+        bool left_first = t_right < 0.0f || (t_left >= 0.0f && t_left <= t_right);
+        Entry near_entry = left_first ? Entry{ n.left, t_left } : Entry{ n.right, t_right };
+        Entry far_entry = left_first ? Entry{ n.right, t_right } : Entry{ n.left, t_left };
+        if (far_entry.t >= 0.0f)
+            stack.push_back(far_entry);
+        if (near_entry.t >= 0.0f)
+            stack.push_back(near_entry);
+    }
+    return hit;
+}
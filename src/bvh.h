@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum_culling.h"
+
+// Node of a Bvh. Internal nodes have two children; leaves own a range of Bvh::items.
+struct BvhNode
+{
+    glm::vec3 lo = glm::vec3(0.0f);
+    glm::vec3 hi = glm::vec3(0.0f);
+    int parent = -1;
+    int left = -1, right = -1;      // Internal node children
+    int first = 0, count = 0;       // Leaf range in Bvh::items; count > 0 marks a leaf
+
+    bool is_leaf() const { return count > 0; }
+};
+
+// Bounding volume hierarchy over axis-aligned boxes, addressed by item index.
+//
+// build() is a binned SAH build (bin_count bins per axis): the top of the tree is split on the
+// calling thread until there are enough independent ranges, then the subtrees are built in
+// parallel on the job system and stitched together. After that the tree is kept up to date
+// incrementally: update() refits one item's leaf and walks its parent chain, insert() adds a
+// new leaf next to the sibling that grows the least. Both are O(depth), but they let the tree
+// drift from what a fresh build would produce; sah_cost() measures how far, so callers can
+// rebuild when it degrades.
+class Bvh
+{
+public:
+    static const int max_leaf_items = 4;
+    static const int bin_count = 16;
+
+    // Item i has bounds [lo[i], hi[i]]
+    void build(const std::vector<glm::vec3>& lo, const std::vector<glm::vec3>& hi);
+    void clear();
+
+    // Add item item_count() with the given bounds
+    void insert(const glm::vec3& lo, const glm::vec3& hi);
+    // Change one item's bounds and refit its ancestors
+    void update(int item, const glm::vec3& lo, const glm::vec3& hi);
+
+    int item_count() const { return (int)item_lo.size(); }
+    int node_count() const { return (int)nodes.size(); }
+
+    // Expected cost of a random query relative to the root box (SAH, traversal cost 1 per node,
+    // 1 per item); O(nodes). build_cost is the value straight after the last build().
+    float sah_cost() const;
+    float build_cost = 0.0f;
+
+    // Items whose boxes intersect the frustum (conservatively: a box is culled only when it is
+    // entirely outside one plane); subtrees entirely inside are taken without further tests
+    void query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+    // Items whose boxes overlap [lo, hi]
+    void query_box(const glm::vec3& lo, const glm::vec3& hi, std::vector<uint32_t>& out) const;
+
+    // Closest hit along origin + t * direction for t in [0, max_t]. Nodes are visited near to
+    // far; intersect(item, best_t) returns the item's exact hit distance or a negative value
+    // for a miss. Returns the hit item (and its t in hit_t), or -1.
+    int raycast(const glm::vec3& origin, const glm::vec3& direction, float max_t,
+                const std::function<float(int item, float best_t)>& intersect, float& hit_t) const;
+
+    int root = -1;
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> items;        // Item indices, in leaf order
+    std::vector<int> item_leaf;         // Leaf node holding each item
+    std::vector<glm::vec3> item_lo, item_hi;
+
+private:
+    bool split(int begin, int end, glm::vec3& lo, glm::vec3& hi, int& mid);
+    void build_subtree(int begin, int end, std::vector<BvhNode>& out);
+    void refit_from(int node);
+    void collect(int node, std::vector<uint32_t>& out) const;
+
+    struct BuildItem
+    {
+        glm::vec3 lo, hi, centroid;
+        uint32_t index;
+    };
+    std::vector<BuildItem> build_items;     // Only used during build()
+};
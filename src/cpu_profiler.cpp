@@ -0,0 +1,99 @@
+#include "cpu_profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+std::atomic<bool> CpuProfiler::enabled{ true };
+
+CpuProfiler& cpu_profiler()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+int64_t cpu_profiler_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::thread_buffer()
+{
+    // Buffers are never freed, so a thread's pointer stays valid after it exits
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->index = (int)buffers.size() - 1;
+        snprintf(buffer->name, sizeof(buffer->name), "Thread %d", buffer->index);
+    }
+    return *buffer;
+}
+
+void CpuProfiler::name_thread(const char* name)
+{
+    ThreadBuffer& buffer = thread_buffer();
+    std::lock_guard<std::mutex> lock(mutex);
+    snprintf(buffer.name, sizeof(buffer.name), "%s", name);
+}
+
+void CpuProfiler::end_frame()
+{
+    const int64_t now = cpu_profiler_now_ns();
+    Frame frame;
+    frame.start_ns = frame_start_ns > 0 ? frame_start_ns : now;
+    frame.end_ns = now;
+    frame_start_ns = now;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+        {
+            // Zones up to written are complete; anything a whole buffer behind was overwritten
+            const uint32_t written = buffer->written.load(std::memory_order_acquire);
+            if (written - buffer->read > (uint32_t)buffer_zones)
+            {
+                dropped_zones += (int)(written - buffer->read - buffer_zones);
+                buffer->read = written - buffer_zones;
+            }
+            if (!paused)
+            {
+                for (uint32_t i = buffer->read; i != written; i++)
+                    frame.zones.push_back(buffer->zones[i % buffer_zones]);
+            }
+            buffer->read = written;
+        }
+    }
+    if (paused)
+        return;
+
+    // Children finish, and so are written, before their parents
+    std::sort(frame.zones.begin(), frame.zones.end(), [](const Zone& a, const Zone& b)
+    {
+        return a.thread != b.thread ? a.thread < b.thread : (a.start_ns != b.start_ns ? a.start_ns < b.start_ns : a.depth < b.depth);
+    });
+    newest = (newest + 1) % history_frames;
+    if ((int)history.size() < history_frames)
+        history.push_back(std::move(frame));
+    else
+        history[newest] = std::move(frame);
+}
+
+const CpuProfiler::Frame& CpuProfiler::frame(int age) const
+{
+    return history[(newest - age + history_frames) % history_frames];
+}
+
+int CpuProfiler::thread_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int)buffers.size();
+}
+
+const char* CpuProfiler::thread_name(int thread) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return thread >= 0 && thread < (int)buffers.size() ? buffers[thread]->name : "";
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Scoped-zone CPU profiler. PROFILE_ZONE("Name") times the rest of the enclosing scope on whatever
+// thread runs it; zones nest. Each thread writes finished zones into a buffer of its own, with no
+// locks (only its first zone registers the buffer), and end_frame() on the main thread drains every
+// buffer into the frame that just ended. The last history_frames frames are kept for the profiler
+// window's flame graph and per-zone statistics.
+//
+// Timestamps come from steady_clock. A disabled profiler costs each zone one relaxed atomic load;
+// building without AEROSLR_PROFILER removes the zones altogether. Zone names must outlive the
+// profiler (string literals). A zone belongs to the frame whose end_frame() drains it, so zones on
+// worker threads can start in the frame before; on the main thread none should span end_frame().
+class CpuProfiler
+{
+public:
+    static const int buffer_zones = 1 << 14;    // Per thread, between two end_frame() calls
+    static const int history_frames = 300;
+
+    struct Zone
+    {
+        const char* name;
+        int64_t start_ns;
+        int64_t end_ns;
+        int thread;
+        int depth;
+    };
+
+    struct Frame
+    {
+        int64_t start_ns = 0;
+        int64_t end_ns = 0;
+        std::vector<Zone> zones;                // By thread, then start time
+    };
+
+    struct ThreadBuffer
+    {
+        Zone zones[buffer_zones];
+        std::atomic<uint32_t> written{ 0 };     // Zones ever written; the owning thread only adds
+        uint32_t read = 0;                      // Zones drained by end_frame()
+        int depth = 0;                          // Open zones on the owning thread
+        int index = 0;
+        char name[32] = {};
+    };
+
+    static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+    static void set_enabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // Name the calling thread in the profiler window
+    void name_thread(const char* name);
+
+    // Close the frame that began at the previous call; call once per frame on the main thread
+    void end_frame();
+
+    // Completed frames, 0 the newest; valid up to frame_count()
+    int frame_count() const { return (int)history.size(); }
+    const Frame& frame(int age) const;
+    int thread_count() const;
+    const char* thread_name(int thread) const;
+
+    ThreadBuffer& thread_buffer();
+
+    bool paused = false;                        // Keep the history as it is (zones are still drained)
+    int dropped_zones = 0;                      // Overwritten before end_frame() drained them
+
+private:
+    static std::atomic<bool> enabled;
+
+    mutable std::mutex mutex;                   // Guards buffers, taken once per thread and per frame
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<Frame> history;                 // Ring of history_frames
+    int newest = -1;
+    int64_t frame_start_ns = 0;
+};
+
+// The application-wide profiler
+CpuProfiler& cpu_profiler();
+
+int64_t cpu_profiler_now_ns();
+
+// Times the scope it lives in (use through PROFILE_ZONE)
+class CpuZone
+{
+public:
+    explicit CpuZone(const char* zone_name)
+    {
+        if (!CpuProfiler::is_enabled())
+            return;
+        buffer = &cpu_profiler().thread_buffer();
+        name = zone_name;
+        depth = buffer->depth++;
+        start_ns = cpu_profiler_now_ns();
+    }
+
+    ~CpuZone()
+    {
+        if (!buffer)
+            return;
+        const uint32_t index = buffer->written.load(std::memory_order_relaxed);
+        CpuProfiler::Zone& zone = buffer->zones[index % CpuProfiler::buffer_zones];
+        zone.name = name;
+        zone.start_ns = start_ns;
+        zone.end_ns = cpu_profiler_now_ns();
+        zone.thread = buffer->index;
+        zone.depth = depth;
+        buffer->depth--;
+        buffer->written.store(index + 1, std::memory_order_release);
+    }
+
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    CpuProfiler::ThreadBuffer* buffer = nullptr;
+    const char* name = nullptr;
+    int64_t start_ns = 0;
+    int depth = 0;
+};
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+#ifdef AEROSLR_PROFILER
+#define PROFILE_ZONE(name) CpuZone PROFILE_ZONE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
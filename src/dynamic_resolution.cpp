@@ -0,0 +1,93 @@
+#include "dynamic_resolution.h"
+#include "fullscreen_pass.h"
+#include "gl_state.h"
+
+#include <math.h>
+
+bool DynamicResolution::link(UpscaleProgram& upscale_program, GLuint program)
+{
+    upscale_program = UpscaleProgram();
+    if (!program)
+        return false;
+    upscale_program.program = program;
+    gl_state().use_program(program);
+    glUniform1i(glGetUniformLocation(program, "uSource"), 0);
+    upscale_program.uv_max_location = glGetUniformLocation(program, "uUVMax");
+    upscale_program.texel_size_location = glGetUniformLocation(program, "uTexelSize");
+    upscale_program.sharpness_location = glGetUniformLocation(program, "uSharpness");
+    return true;
+}
+
+bool DynamicResolution::init(ShaderManager& shaders)
+{
+    // Small enough to build up front; the manager's placeholder only suits scene geometry
+    bool bilinear = link(bilinear_program, shaders.load_program("fullscreen.vert", "upscale.frag"));
+    bool sharpened = link(sharpen_program, shaders.load_program("fullscreen.vert", "upscale.frag", { "SHARPEN" }));
+    timer.init(GL_TIME_ELAPSED);
+    return bilinear && sharpened;
+}
+
+void DynamicResolution::shutdown()
+{
+    timer.shutdown();
+    // Programs belong to the ShaderManager
+    bilinear_program = sharpen_program = UpscaleProgram();
+}
+
+void DynamicResolution::update()
+{
+    GLuint64 elapsed_ns = 0;
+    if (timer.poll(elapsed_ns))
+    {
+        gpu_ms = (float)(elapsed_ns / 1.0e6);
+        new_sample = true;
+    }
+
+    if (!enabled)
+    {
+        scale = scale < min_scale ? min_scale : (scale > max_scale ? max_scale : scale);
+        return;
+    }
+    if (!new_sample || gpu_ms <= 0.0f)
+        return;
+    new_sample = false;
+
+    float ratio = budget_ms / gpu_ms;
+    if (ratio > 0.9f && ratio < 1.05f)
+        return;
+    // Back off quickly when over budget, creep back up when under it
+    float target = scale * sqrtf(ratio);
+    float rate = ratio < 1.0f ? 0.5f : 0.1f;
+    float next = scale + (target - scale) * rate;
+    // Snap to 1/64 steps so tiny corrections do not resize the target every frame, rounding away
+    // from the current scale so a slow climb still reaches max_scale instead of rounding back
+    next = next > scale ? ceilf(next * 64.0f) / 64.0f : floorf(next * 64.0f) / 64.0f;
+    scale = next < min_scale ? min_scale : (next > max_scale ? max_scale : next);
+}
+
+void DynamicResolution::begin_gpu_timer()
+{
+    timer.begin();
+}
+
+void DynamicResolution::end_gpu_timer()
+{
+    timer.end();
+}
+
+void DynamicResolution::upscale(const RenderTarget& source)
+{
+    const UpscaleProgram& program = sharpen ? sharpen_program : bilinear_program;
+    if (!program.program)
+        return;
+    gl_state().use_program(program.program);
+    gl_state().set_depth_test(false);
+    gl_state().set_blend(false);
+    gl_state().set_cull_face(false);
+    gl_state().polygon_mode(GL_FILL);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, source.colour_texture);
+    glUniform2f(program.uv_max_location, source.u_max(), source.v_max());
+    glUniform2f(program.texel_size_location, 1.0f / source.alloc_width, 1.0f / source.alloc_height);
+    glUniform1f(program.sharpness_location, sharpness);
+    draw_fullscreen_triangle();
+}
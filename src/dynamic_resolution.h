@@ -0,0 +1,55 @@
+#pragma once
+#include <glad/glad.h>
+#include "render_target.h"
+#include "gpu_query.h"
+#include "shader_manager.h"
+
+// Holds the viewport's GPU time under a budget by scaling the resolution the scene renders at,
+// then stretches the result back over the canvas with a bilinear or sharpening upscale.
+//
+// GPU time comes from a QueryRing of GL_TIME_ELAPSED queries, read back only once available,
+// so the controller reacts a couple of frames late but never stalls. GPU cost
+// scales roughly with pixel count, so the per-axis scale moves by the square root of the
+// budget ratio, damped and with a dead band to avoid oscillating around the budget.
+class DynamicResolution
+{
+public:
+    bool init(ShaderManager& shaders);
+    void shutdown();
+
+    // Read back finished timings and pick this frame's scale; call before sizing the targets
+    void update();
+
+    // Bracket the viewport's GPU work (scene and upscale)
+    void begin_gpu_timer();
+    void end_gpu_timer();
+
+    // Draw the rendered region of source over the currently bound target's viewport
+    void upscale(const RenderTarget& source);
+
+    bool enabled = true;
+    bool sharpen = true;
+    float sharpness = 0.5f;
+    float budget_ms = 8.0f;     // Target GPU time for the viewport
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    float scale = 1.0f;         // Per-axis render scale in use (set by hand when disabled)
+    float gpu_ms = 0.0f;        // Most recent measured viewport GPU time
+
+private:
+    QueryRing timer;
+    bool new_sample = false;
+
+    struct UpscaleProgram
+    {
+        GLuint program = 0;
+        GLint uv_max_location = -1;
+        GLint texel_size_location = -1;
+        GLint sharpness_location = -1;
+    };
+
+    bool link(UpscaleProgram& upscale_program, GLuint program);
+
+    UpscaleProgram bilinear_program;
+    UpscaleProgram sharpen_program;
+};
@@ -0,0 +1,45 @@
+#include "frame_uniforms.h"
+#include "gl_state.h"
+
+#include <string.h>
+
+void FrameUniformBuffer::init()
+{
+    GLint offset_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    alignment = offset_alignment > 0 ? (size_t)offset_alignment : 256;
+    // Room for a few dozen views per frame before the region has to grow
+    stream.init(GL_UNIFORM_BUFFER, 32 * alignment);
+}
+
+void FrameUniformBuffer::shutdown()
+{
+    stream.shutdown();
+}
+
+void FrameUniformBuffer::begin_frame(int views)
+{
+    stream.begin_frame((size_t)views * alignment);
+}
+
+void FrameUniformBuffer::push(const FrameUniforms& uniforms)
+{
+    StreamBuffer::Allocation allocation = stream.allocate(sizeof(FrameUniforms), alignment);
+    if (allocation.ptr == nullptr)
+        return;
+    memcpy(allocation.ptr, &uniforms, sizeof(FrameUniforms));
+    stream.flush();
+    gl_state().bind_buffer_range(GL_UNIFORM_BUFFER, UNIFORM_BINDING_FRAME, stream.buffer, allocation.offset, sizeof(FrameUniforms));
+}
+
+void FrameUniformBuffer::end_frame()
+{
+    stream.end_frame();
+}
+
+void FrameUniformBuffer::bind_block(GLuint program)
+{
+    GLuint block = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, UNIFORM_BINDING_FRAME);
+}
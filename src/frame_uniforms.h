@@ -0,0 +1,65 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "stream_buffer.h"
+
+// Uniform block binding points shared by every program
+enum
+{
+    UNIFORM_BINDING_FRAME = 0,
+    UNIFORM_BINDING_SHADOWS = 1     // ShadowUniforms, see shadow_maps.h
+};
+
+// Per-frame camera/global data, laid out to match the std140 "FrameUniforms" block:
+//
+//     layout (std140) uniform FrameUniforms
+//     {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 view_projection;
+//         vec4 camera_position;   // xyz = world position
+//         vec4 viewport_size;     // xy = pixels, zw = 1 / pixels
+//         vec4 time;              // x = seconds since start
+//         vec4 cluster_grid;      // xyz = light clusters per axis, w = tile size in pixels
+//         vec4 cluster_depth;     // x, y = depth slice scale and bias, zw = view depth range sliced
+//         vec4 lighting;          // x = headlight strength, y = 1 for the light heat view
+//         vec4 sun_direction;     // xyz = view-space direction the sunlight travels, w = 1 with shadows
+//         vec4 sun_colour;        // rgb = colour * intensity, 0 without a sun
+//     };
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::vec4 camera_position;
+    glm::vec4 viewport_size;
+    glm::vec4 time;
+    glm::vec4 cluster_grid;
+    glm::vec4 cluster_depth;
+    glm::vec4 lighting;
+    glm::vec4 sun_direction;
+    glm::vec4 sun_colour;
+};
+
+// Streams FrameUniforms through a ring buffer and keeps the latest block bound at
+// UNIFORM_BINDING_FRAME, so switching programs does not re-upload any camera state.
+// A frame may push several blocks (one per view); each push rebinds the range.
+class FrameUniformBuffer
+{
+public:
+    void init();
+    void shutdown();
+
+    // views is the number of push() calls the frame will make
+    void begin_frame(int views = 1);
+    void push(const FrameUniforms& uniforms);
+    // Call after the last draw that reads this frame's blocks
+    void end_frame();
+
+    // Point a program's FrameUniforms block (if it has one) at UNIFORM_BINDING_FRAME; call once after linking
+    static void bind_block(GLuint program);
+
+private:
+    StreamBuffer stream;
+    size_t alignment = 256;
+};
@@ -0,0 +1,234 @@
+#include "frustum_culling.h"
+#include "job_system.h"
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AEROSLR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AEROSLR_TARGET_AVX2
+#else
+#define AEROSLR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+Frustum extract_frustum(const glm::mat4& m)
+{
+    // Gribb/Hartmann: each plane is the fourth row of the matrix plus or minus one of the others
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;    // Left
+    frustum.planes[1] = row3 - row0;    // Right
+    frustum.planes[2] = row3 + row1;    // Bottom
+    frustum.planes[3] = row3 - row1;    // Top
+    frustum.planes[4] = row3 + row2;    // Near
+    frustum.planes[5] = row3 - row2;    // Far
+    for (glm::vec4& plane : frustum.planes)
+    {
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f)
+            plane /= length;
+    }
+    return frustum;
+}
+
+void BoundingSpheres::resize(int count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+}
+
+static int cull_scalar(const Frustum& frustum, const BoundingSpheres& s, int begin, int end, uint32_t* out)
+{
+    int written = 0;
+    for (int i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for (const glm::vec4& p : frustum.planes)
+            inside &= p.x * s.x[i] + p.y * s.y[i] + p.z * s.z[i] + p.w > -s.radius[i];
+        // Branch-free compaction: always write, only advance when visible
+        out[written] = (uint32_t)i;
+        written += inside ? 1 : 0;
+    }
+    return written;
+}
+
+#ifdef AEROSLR_X86
+static int cull_sse(const Frustum& frustum, const BoundingSpheres& s, int begin, int end, uint32_t* out)
+{
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++)
+    {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    int written = 0;
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&s.x[i]);
+        __m128 y = _mm_loadu_ps(&s.y[i]);
+        __m128 z = _mm_loadu_ps(&s.z[i]);
+        __m128 neg_r = _mm_xor_ps(_mm_loadu_ps(&s.radius[i]), sign);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, neg_r));
+        }
+        int mask = _mm_movemask_ps(inside);
+        if (mask == 0)
+            continue;   // Off-screen runs are the common case in big scenes
+        for (int lane = 0; lane < 4; lane++)
+        {
+            out[written] = (uint32_t)(i + lane);
+            written += (mask >> lane) & 1;
+        }
+    }
+    return written + cull_scalar(frustum, s, i, end, out + written);
+}
+
+AEROSLR_TARGET_AVX2
+static int cull_avx2(const Frustum& frustum, const BoundingSpheres& s, int begin, int end, uint32_t* out)
+{
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++)
+    {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    int written = 0;
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&s.x[i]);
+        __m256 y = _mm256_loadu_ps(&s.y[i]);
+        __m256 z = _mm256_loadu_ps(&s.z[i]);
+        __m256 neg_r = _mm256_xor_ps(_mm256_loadu_ps(&s.radius[i]), sign);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 d = _mm256_fmadd_ps(px[p], x, _mm256_fmadd_ps(py[p], y, _mm256_fmadd_ps(pz[p], z, pw[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_r, _CMP_GT_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        if (mask == 0)
+            continue;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            out[written] = (uint32_t)(i + lane);
+            written += (mask >> lane) & 1;
+        }
+    }
+    return written + cull_scalar(frustum, s, i, end, out + written);
+}
+
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+CullKernel cull_kernel()
+{
+#ifdef AEROSLR_X86
+    static const CullKernel kernel = cpu_has_avx2() ? CULL_KERNEL_AVX2 : CULL_KERNEL_SSE;
+    return kernel;
+#else
+    return CULL_KERNEL_SCALAR;
+#endif
+}
+
+const char* cull_kernel_name(CullKernel kernel)
+{
+    switch (kernel)
+    {
+    case CULL_KERNEL_AVX2: return "AVX2";
+    case CULL_KERNEL_SSE:  return "SSE";
+    default:               return "scalar";
+    }
+}
+
+int cull_spheres(const Frustum& frustum, const BoundingSpheres& spheres, int begin, int end, uint32_t* out)
+{
+    switch (cull_kernel())
+    {
+#ifdef AEROSLR_X86
+    case CULL_KERNEL_AVX2: return cull_avx2(frustum, spheres, begin, end, out);
+    case CULL_KERNEL_SSE:  return cull_sse(frustum, spheres, begin, end, out);
+#endif
+    default:               return cull_scalar(frustum, spheres, begin, end, out);
+    }
+}
+
+// One core handles this many spheres in well under a millisecond; only split bigger sets
+static const int parallel_cull_threshold = 262144;
+
+void FrustumCuller::cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible)
+{
+    auto start = std::chrono::steady_clock::now();
+    const int count = spheres.size();
+    visible.resize(count);
+
+    int threads = job_system().thread_count();
+    if (count < parallel_cull_threshold || threads < 2)
+    {
+        visible.resize(cull_spheres(frustum, spheres, 0, count, visible.data()));
+    }
+    else
+    {
+        // Each chunk compacts into its own slice of the output, then the slices are closed up
+        // in order, so the result matches the single-threaded one
+        int chunks = threads;
+        int chunk_size = (count + chunks - 1) / chunks;
+        chunk_counts.assign(chunks, 0);
+        job_system().run_tasks(chunks, [&](int chunk)
+        {
+            int begin = chunk * chunk_size;
+            int end = begin + chunk_size < count ? begin + chunk_size : count;
+            if (begin < end)
+                chunk_counts[chunk] = cull_spheres(frustum, spheres, begin, end, visible.data() + begin);
+        });
+        int written = chunk_counts[0];
+        for (int chunk = 1; chunk < chunks; chunk++)
+        {
+            memmove(visible.data() + written, visible.data() + chunk * chunk_size, chunk_counts[chunk] * sizeof(uint32_t));
+            written += chunk_counts[chunk];
+        }
+        visible.resize(written);
+    }
+
+    cull_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Six inward-facing planes (xyz = unit normal, w = distance), from a view-projection matrix.
+// A point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+Frustum extract_frustum(const glm::mat4& view_projection);
+
+// World-space bounding spheres as structure-of-arrays, so the culling kernels load 4 or 8
+// objects' worth of one component with a single instruction
+struct BoundingSpheres
+{
+    std::vector<float> x, y, z, radius;
+
+    int size() const { return (int)x.size(); }
+    void resize(int count);
+    void set(int i, const glm::vec3& centre, float r) { x[i] = centre.x; y[i] = centre.y; z[i] = centre.z; radius[i] = r; }
+};
+
+// Which kernel cull_spheres() uses on this CPU
+enum CullKernel
+{
+    CULL_KERNEL_SCALAR,
+    CULL_KERNEL_SSE,
+    CULL_KERNEL_AVX2
+};
+
+CullKernel cull_kernel();
+const char* cull_kernel_name(CullKernel kernel);
+
+// Append the indices in [begin, end) whose spheres intersect the frustum to out (which must
+// have room for end - begin entries) and return how many were written. Indices stay in order.
+int cull_spheres(const Frustum& frustum, const BoundingSpheres& spheres, int begin, int end, uint32_t* out);
+
+// Culls a whole set into a compact visible index list, split across the job system's threads
+// once there are enough spheres to be worth it
+class FrustumCuller
+{
+public:
+    void cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible);
+
+    double cull_ms = 0.0;       // Time taken by the last cull()
+
+private:
+    std::vector<int> chunk_counts;
+};
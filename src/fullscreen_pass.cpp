@@ -0,0 +1,19 @@
+#include "fullscreen_pass.h"
+#include "gl_state.h"
+
+static GLuint empty_vao = 0;
+
+void draw_fullscreen_triangle()
+{
+    if (empty_vao == 0)
+        glGenVertexArrays(1, &empty_vao);
+    gl_state().bind_vertex_array(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void shutdown_fullscreen_pass()
+{
+    gl_state().forget_vertex_array(empty_vao);
+    glDeleteVertexArrays(1, &empty_vao);
+    empty_vao = 0;
+}
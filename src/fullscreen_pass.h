@@ -0,0 +1,8 @@
+#pragma once
+#include <glad/glad.h>
+
+// Draws one triangle covering the whole viewport, for post-processing passes.
+// Pair with shaders/fullscreen.vert, which builds the corners from gl_VertexID and outputs
+// vUV in [0, 1]; core profiles still need a VAO bound, so an empty one is kept for it.
+void draw_fullscreen_triangle();
+void shutdown_fullscreen_pass();
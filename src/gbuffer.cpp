@@ -0,0 +1,93 @@
+#include "gbuffer.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+
+static GLuint create_attachment(GLenum format, GLenum pixel_type, int width, int height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, pixel_type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+bool GBuffer::init()
+{
+    glGenFramebuffers(1, &framebuffer);
+    glGenFramebuffers(1, &lighting_framebuffer);
+    return framebuffer != 0 && lighting_framebuffer != 0;
+}
+
+void GBuffer::shutdown()
+{
+    gl_state().forget_texture(albedo_texture);
+    gl_state().forget_texture(normal_texture);
+    gl_state().forget_framebuffer(framebuffer);
+    gl_state().forget_framebuffer(lighting_framebuffer);
+    glDeleteTextures(1, &albedo_texture);
+    glDeleteTextures(1, &normal_texture);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteFramebuffers(1, &lighting_framebuffer);
+    albedo_texture = normal_texture = framebuffer = lighting_framebuffer = 0;
+    depth_texture = colour_texture = 0;
+    alloc_width = alloc_height = 0;
+}
+
+bool GBuffer::attach(const RenderTarget& target)
+{
+    if (target.alloc_width == alloc_width && target.alloc_height == alloc_height &&
+        target.depth_texture == depth_texture && target.colour_texture == colour_texture)
+        return true;
+
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (target.alloc_width != alloc_width || target.alloc_height != alloc_height)
+    {
+        gl_state().forget_texture(albedo_texture);
+        gl_state().forget_texture(normal_texture);
+        glDeleteTextures(1, &albedo_texture);
+        glDeleteTextures(1, &normal_texture);
+        albedo_texture = create_attachment(GL_RGBA8, GL_UNSIGNED_BYTE, target.alloc_width, target.alloc_height);
+        normal_texture = create_attachment(GL_RGB10_A2, GL_UNSIGNED_INT_2_10_10_10_REV, target.alloc_width, target.alloc_height);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_texture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_texture, 0);
+        const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, draw_buffers);
+        alloc_width = target.alloc_width;
+        alloc_height = target.alloc_height;
+        reallocations++;
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depth_texture, 0);
+    depth_texture = target.depth_texture;
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, lighting_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colour_texture, 0);
+    colour_texture = target.colour_texture;
+    GLenum lighting_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE || lighting_status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "G-buffer %dx%d incomplete (0x%x, 0x%x)\n", alloc_width, alloc_height, status, lighting_status);
+        depth_texture = colour_texture = 0;     // Retry next frame
+        return false;
+    }
+    return true;
+}
+
+void GBuffer::bind(const RenderTarget& target)
+{
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl_state().viewport(0, 0, target.width, target.height);
+}
+
+void GBuffer::bind_lighting(const RenderTarget& target)
+{
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, lighting_framebuffer);
+    gl_state().viewport(0, 0, target.width, target.height);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <glad/glad.h>
+#include <stddef.h>
+#include "render_target.h"
+
+// G-buffer for the deferred path, pooled at a RenderTarget's allocation size and sharing its
+// depth texture, so the lighting pass and the forward passes after it use the same depth:
+//
+//     attachment 0  GL_RGBA8     albedo (rgb), a unused
+//     attachment 1  GL_RGB10_A2  octahedral view-space normal (rg, 10 bits each), b/a unused
+//
+// 8 bytes per pixel on top of the target's own colour and 24-bit depth. Position is not stored;
+// the lighting pass rebuilds it from depth. b/a are free for material parameters once there are any.
+// The lighting pass samples that depth, so it writes through a second framebuffer holding only
+// the target's colour texture rather than the target's own (which would be a feedback loop).
+class GBuffer
+{
+public:
+    static const int bytes_per_pixel = 8;
+
+    bool init();
+    void shutdown();
+
+    // Follow target's allocation and depth texture, reallocating when either changed;
+    // false if the framebuffer is incomplete
+    bool attach(const RenderTarget& target);
+
+    // Bind the framebuffer (both attachments as draw buffers) and set the viewport to target's size
+    void bind(const RenderTarget& target);
+    // Bind target's colour texture without its depth, for the lighting pass
+    void bind_lighting(const RenderTarget& target);
+
+    size_t bytes() const { return (size_t)alloc_width * alloc_height * bytes_per_pixel; }
+
+    GLuint framebuffer = 0;
+    GLuint lighting_framebuffer = 0;
+    GLuint albedo_texture = 0;
+    GLuint normal_texture = 0;
+    int alloc_width = 0, alloc_height = 0;
+    int reallocations = 0;
+
+private:
+    GLuint depth_texture = 0;   // The attached target's, not owned
+    GLuint colour_texture = 0;
+};
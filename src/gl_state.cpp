@@ -0,0 +1,303 @@
+#include "gl_state.h"
+
+#include <string.h>
+
+GLStateCache& gl_state()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+bool gl_has_extension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void GLStateCache::invalidate()
+{
+    program = unknown;
+    vertex_array = unknown;
+    for (GLuint& b : buffers)
+        b = unknown;
+    for (BufferRange& range : uniform_ranges)
+        range = { unknown, -1, -1 };
+    active_texture_unit = -1;
+    for (int i = 0; i < max_texture_units; i++)
+    {
+        texture_targets[i] = unknown;
+        textures[i] = unknown;
+    }
+    draw_framebuffer = read_framebuffer = unknown;
+    polygon = unknown;
+    blend = FLAG_UNKNOWN;
+    blend_src = blend_dst = unknown;
+    depth_test = FLAG_UNKNOWN;
+    depth_write = FLAG_UNKNOWN;
+    colour_write = FLAG_UNKNOWN;
+    depth_compare = unknown;
+    cull_face = FLAG_UNKNOWN;
+    scissor_test = FLAG_UNKNOWN;
+    for (int i = 0; i < 4; i++)
+        scissor_rect[i] = viewport_rect[i] = -1;
+}
+
+// Count the call and report whether it needs to reach GL
+bool GLStateCache::check(bool changed)
+{
+    if (changed)
+        frame_stats.issued++;
+    else
+        frame_stats.elided++;
+    return changed;
+}
+
+bool GLStateCache::set_flag(int& cached, GLenum cap, bool enabled)
+{
+    int wanted = enabled ? FLAG_ON : FLAG_OFF;
+    if (!check(cached != wanted))
+        return false;
+    cached = wanted;
+    if (enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+    return true;
+}
+
+int GLStateCache::buffer_slot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:         return BUFFER_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT;
+    case GL_UNIFORM_BUFFER:       return BUFFER_UNIFORM;
+    case GL_TEXTURE_BUFFER:       return BUFFER_TEXTURE;
+    case GL_COPY_READ_BUFFER:     return BUFFER_COPY_READ;
+    case GL_COPY_WRITE_BUFFER:    return BUFFER_COPY_WRITE;
+    case GL_PIXEL_PACK_BUFFER:    return BUFFER_PIXEL_PACK;
+    case GL_PIXEL_UNPACK_BUFFER:  return BUFFER_PIXEL_UNPACK;
+    default:                      return -1;
+    }
+}
+
+void GLStateCache::use_program(GLuint p)
+{
+    if (!check(program != p))
+        return;
+    program = p;
+    glUseProgram(p);
+}
+
+void GLStateCache::bind_vertex_array(GLuint vao)
+{
+    if (!check(vertex_array != vao))
+        return;
+    vertex_array = vao;
+    // The element buffer binding belongs to the VAO, so it changes with it
+    buffers[BUFFER_ELEMENT] = unknown;
+    glBindVertexArray(vao);
+}
+
+void GLStateCache::bind_buffer(GLenum target, GLuint buffer)
+{
+    int slot = buffer_slot(target);
+    if (slot < 0)
+    {
+        frame_stats.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (!check(buffers[slot] != buffer))
+        return;
+    buffers[slot] = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void GLStateCache::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    if (target != GL_UNIFORM_BUFFER || index >= (GLuint)max_uniform_bindings)
+    {
+        frame_stats.issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+        int slot = buffer_slot(target);
+        if (slot >= 0)
+            buffers[slot] = buffer;
+        return;
+    }
+    BufferRange& range = uniform_ranges[index];
+    if (!check(range.buffer != buffer || range.offset != offset || range.size != size))
+        return;
+    range = { buffer, offset, size };
+    buffers[BUFFER_UNIFORM] = buffer;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLStateCache::bind_texture(int unit, GLenum target, GLuint texture)
+{
+    if (unit < 0 || unit >= max_texture_units)
+    {
+        frame_stats.issued += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        active_texture_unit = -1;
+        return;
+    }
+    if (!check(textures[unit] != texture || texture_targets[unit] != target))
+        return;
+    if (active_texture_unit != unit)
+    {
+        frame_stats.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_texture_unit = unit;
+    }
+    textures[unit] = texture;
+    texture_targets[unit] = target;
+    glBindTexture(target, texture);
+}
+
+void GLStateCache::bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    if (!check((draw && draw_framebuffer != framebuffer) || (read && read_framebuffer != framebuffer)))
+        return;
+    if (draw)
+        draw_framebuffer = framebuffer;
+    if (read)
+        read_framebuffer = framebuffer;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void GLStateCache::polygon_mode(GLenum mode)
+{
+    if (!check(polygon != mode))
+        return;
+    polygon = mode;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLStateCache::set_blend(bool enabled)
+{
+    set_flag(blend, GL_BLEND, enabled);
+}
+
+void GLStateCache::blend_func(GLenum src, GLenum dst)
+{
+    if (!check(blend_src != src || blend_dst != dst))
+        return;
+    blend_src = src;
+    blend_dst = dst;
+    glBlendFunc(src, dst);
+}
+
+void GLStateCache::set_depth_test(bool enabled)
+{
+    set_flag(depth_test, GL_DEPTH_TEST, enabled);
+}
+
+void GLStateCache::depth_mask(bool write)
+{
+    int wanted = write ? FLAG_ON : FLAG_OFF;
+    if (!check(depth_write != wanted))
+        return;
+    depth_write = wanted;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLStateCache::colour_mask(bool write)
+{
+    int wanted = write ? FLAG_ON : FLAG_OFF;
+    if (!check(colour_write != wanted))
+        return;
+    colour_write = wanted;
+    GLboolean mask = write ? GL_TRUE : GL_FALSE;
+    glColorMask(mask, mask, mask, mask);
+}
+
+void GLStateCache::depth_func(GLenum func)
+{
+    if (!check(depth_compare != func))
+        return;
+    depth_compare = func;
+    glDepthFunc(func);
+}
+
+void GLStateCache::set_cull_face(bool enabled)
+{
+    set_flag(cull_face, GL_CULL_FACE, enabled);
+}
+
+void GLStateCache::set_scissor_test(bool enabled)
+{
+    set_flag(scissor_test, GL_SCISSOR_TEST, enabled);
+}
+
+void GLStateCache::scissor(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+    GLint rect[4] = { x, y, w, h };
+    if (!check(memcmp(rect, scissor_rect, sizeof(rect)) != 0))
+        return;
+    memcpy(scissor_rect, rect, sizeof(rect));
+    glScissor(x, y, w, h);
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+    GLint rect[4] = { x, y, w, h };
+    if (!check(memcmp(rect, viewport_rect, sizeof(rect)) != 0))
+        return;
+    memcpy(viewport_rect, rect, sizeof(rect));
+    glViewport(x, y, w, h);
+}
+
+void GLStateCache::forget_buffer(GLuint buffer)
+{
+    // GL unbinds a deleted buffer from every target it was bound to
+    for (GLuint& b : buffers)
+        if (b == buffer)
+            b = 0;
+    for (BufferRange& range : uniform_ranges)
+        if (range.buffer == buffer)
+            range = { 0, 0, 0 };
+}
+
+void GLStateCache::forget_vertex_array(GLuint vao)
+{
+    if (vertex_array == vao)
+    {
+        vertex_array = 0;
+        buffers[BUFFER_ELEMENT] = unknown;
+    }
+}
+
+void GLStateCache::forget_program(GLuint p)
+{
+    // A deleted program stays in use until another is bound, but its name may be recycled
+    if (program == p)
+        program = unknown;
+}
+
+void GLStateCache::forget_texture(GLuint texture)
+{
+    // Deleted textures revert to 0 on every unit they were bound to
+    for (int i = 0; i < max_texture_units; i++)
+        if (textures[i] == texture)
+            textures[i] = 0;
+}
+
+void GLStateCache::forget_framebuffer(GLuint framebuffer)
+{
+    // Deleting the bound framebuffer rebinds the default one
+    if (draw_framebuffer == framebuffer)
+        draw_framebuffer = 0;
+    if (read_framebuffer == framebuffer)
+        read_framebuffer = 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <glad/glad.h>
+
+// Thin GL state tracker: remembers the last value set for each piece of state and
+// skips calls that would set a value that is already in effect.
+// All renderer code binds through gl_state() so the shadow copy stays accurate. After
+// code we do not control touches GL (e.g. ImGui_ImplOpenGL3_RenderDrawData), call
+// invalidate() so the next call for each state is issued unconditionally.
+class GLStateCache
+{
+public:
+    static const int max_texture_units = 16;
+    static const int max_uniform_bindings = 16;
+
+    // Per-frame counters of GL calls issued and calls skipped because the value was already set
+    struct Stats
+    {
+        int issued = 0;
+        int elided = 0;
+    };
+
+    GLStateCache() { invalidate(); }
+
+    void begin_frame() { frame_stats = Stats(); }
+    void invalidate();
+    const Stats& stats() const { return frame_stats; }
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER, GL_COPY_*_BUFFER, GL_PIXEL_*_BUFFER
+    void bind_buffer(GLenum target, GLuint buffer);
+    // Indexed uniform buffer binding (also changes the generic GL_UNIFORM_BUFFER binding)
+    void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void bind_texture(int unit, GLenum target, GLuint texture);
+    // GL_FRAMEBUFFER binds both the draw and read framebuffer
+    void bind_framebuffer(GLenum target, GLuint framebuffer);
+    void polygon_mode(GLenum mode);
+
+    void set_blend(bool enabled);
+    void blend_func(GLenum src, GLenum dst);
+    void set_depth_test(bool enabled);
+    void depth_mask(bool write);
+    // All four channels together; depth-only passes turn colour writes off
+    void colour_mask(bool write);
+    void depth_func(GLenum func);
+    void set_cull_face(bool enabled);
+    void set_scissor_test(bool enabled);
+    void scissor(GLint x, GLint y, GLsizei w, GLsizei h);
+    void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+
+    // Call when deleting GL objects, so a recycled name is not mistaken for one still bound
+    void forget_buffer(GLuint buffer);
+    void forget_vertex_array(GLuint vao);
+    void forget_program(GLuint program);
+    void forget_texture(GLuint texture);
+    void forget_framebuffer(GLuint framebuffer);
+
+private:
+    enum { BUFFER_ARRAY, BUFFER_ELEMENT, BUFFER_UNIFORM, BUFFER_TEXTURE, BUFFER_COPY_READ, BUFFER_COPY_WRITE, BUFFER_PIXEL_PACK, BUFFER_PIXEL_UNPACK, BUFFER_TARGET_COUNT };
+    // Tri-state for enable flags so "never set" is distinct from enabled/disabled
+    enum { FLAG_UNKNOWN = -1, FLAG_OFF = 0, FLAG_ON = 1 };
+
+    static int buffer_slot(GLenum target);
+    bool set_flag(int& cached, GLenum cap, bool enabled);
+    bool check(bool changed);
+
+    // Sentinel for "unknown" GL object names and enums
+    static const GLuint unknown = 0xFFFFFFFFu;
+
+    GLuint program = unknown;
+    GLuint vertex_array = unknown;
+    GLuint buffers[BUFFER_TARGET_COUNT];
+    struct BufferRange { GLuint buffer; GLintptr offset; GLsizeiptr size; };
+    BufferRange uniform_ranges[max_uniform_bindings];
+    int active_texture_unit = -1;
+    GLenum texture_targets[max_texture_units];
+    GLuint textures[max_texture_units];
+    GLuint draw_framebuffer = unknown;
+    GLuint read_framebuffer = unknown;
+    GLenum polygon = unknown;
+    int blend = FLAG_UNKNOWN;
+    GLenum blend_src = unknown, blend_dst = unknown;
+    int depth_test = FLAG_UNKNOWN;
+    int depth_write = FLAG_UNKNOWN;
+    int colour_write = FLAG_UNKNOWN;
+    GLenum depth_compare = unknown;
+    int cull_face = FLAG_UNKNOWN;
+    int scissor_test = FLAG_UNKNOWN;
+    GLint scissor_rect[4] = { -1, -1, -1, -1 };
+    GLint viewport_rect[4] = { -1, -1, -1, -1 };
+    Stats frame_stats;
+};
+
+// The cache for the main GL context
+GLStateCache& gl_state();
+
+// True if the current context advertises the named extension (e.g. "GL_ARB_buffer_storage").
+// The bundled glad loader is generated without extensions, so they are queried here instead.
+bool gl_has_extension(const char* name);
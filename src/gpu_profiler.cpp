@@ -0,0 +1,148 @@
+#include "gpu_profiler.h"
+
+GpuProfiler& gpu_profiler()
+{
+    static GpuProfiler profiler;
+    return profiler;
+}
+
+void GpuProfiler::init()
+{
+    for (Frame& frame : frames)
+    {
+        glGenQueries(max_passes * 2, frame.queries);
+        frame.pass_count = 0;
+        frame.last_query = -1;
+        frame.pending = false;
+    }
+    initialised = true;
+}
+
+void GpuProfiler::shutdown()
+{
+    if (!initialised)
+        return;
+    for (Frame& frame : frames)
+    {
+        glDeleteQueries(max_passes * 2, frame.queries);
+        frame = Frame();
+    }
+    recording = nullptr;
+    depth = overflow = 0;
+    passes.clear();
+    initialised = false;
+}
+
+void GpuProfiler::collect()
+{
+    // Timestamps complete in submission order, so a frame is done once its last query is.
+    // Frames are visited oldest first so the newest finished one is published.
+    for (int i = 0; i < max_frames; i++)
+    {
+        Frame* oldest = nullptr;
+        for (Frame& frame : frames)
+        {
+            if (frame.pending && (!oldest || frame.number < oldest->number))
+                oldest = &frame;
+        }
+        if (!oldest)
+            return;
+        if (oldest->last_query >= 0)
+        {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(oldest->queries[oldest->last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+
+            GLuint64 first = ~(GLuint64)0, last = 0;
+            passes.clear();
+            for (int p = 0; p < oldest->pass_count; p++)
+            {
+                GLuint64 begin_ns = 0, end_ns = 0;
+                glGetQueryObjectui64v(oldest->queries[p * 2], GL_QUERY_RESULT, &begin_ns);
+                glGetQueryObjectui64v(oldest->queries[p * 2 + 1], GL_QUERY_RESULT, &end_ns);
+                first = begin_ns < first ? begin_ns : first;
+                last = end_ns > last ? end_ns : last;
+                const Pass& pass = oldest->passes[p];
+                passes.push_back({ pass.name, pass.depth, end_ns > begin_ns ? (float)((end_ns - begin_ns) / 1.0e6) : 0.0f, pass.cpu_ms });
+            }
+            frame_gpu_ms = last > first ? (float)((last - first) / 1.0e6) : 0.0f;
+            latency = (int)(frame_number - oldest->number);
+        }
+        oldest->pending = false;
+    }
+}
+
+void GpuProfiler::begin_frame()
+{
+    frame_number++;
+    recording = nullptr;
+    depth = overflow = 0;
+    if (!initialised)
+        return;
+    collect();
+    if (!enabled)
+        return;
+
+    Frame& frame = frames[frame_number % max_frames];
+    if (frame.pending)
+    {
+        dropped_frames++;
+        return;
+    }
+    frame.pass_count = 0;
+    frame.last_query = -1;
+    frame.number = frame_number;
+    recording = &frame;
+}
+
+void GpuProfiler::end_frame()
+{
+    // Passes left open are closed here so the frame can still be read back
+    overflow = 0;
+    while (depth > 0)
+        end_pass();
+    if (recording)
+        recording->pending = true;
+    recording = nullptr;
+}
+
+void GpuProfiler::begin_pass(const char* name)
+{
+    if (depth == max_depth)
+    {
+        overflow++;
+        return;
+    }
+    int index = -1;
+    if (recording && recording->pass_count < max_passes)
+    {
+        index = recording->pass_count++;
+        Pass& pass = recording->passes[index];
+        pass.name = name;
+        pass.depth = depth;
+        pass.cpu_ms = 0.0f;
+        pass.cpu_begin = std::chrono::steady_clock::now();
+        glQueryCounter(recording->queries[index * 2], GL_TIMESTAMP);
+        recording->last_query = index * 2;
+    }
+    stack[depth++] = index;
+}
+
+void GpuProfiler::end_pass()
+{
+    if (overflow > 0)
+    {
+        overflow--;
+        return;
+    }
+    if (depth == 0)
+        return;
+    const int index = stack[--depth];
+    if (!recording || index < 0)
+        return;
+    glQueryCounter(recording->queries[index * 2 + 1], GL_TIMESTAMP);
+    recording->last_query = index * 2 + 1;
+    Pass& pass = recording->passes[index];
+    pass.cpu_ms = (float)std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pass.cpu_begin).count();
+}
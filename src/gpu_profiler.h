@@ -0,0 +1,77 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <vector>
+
+// Per-pass GPU and CPU timings of the frame. Each pass is bracketed by two GL_TIMESTAMP queries
+// (so passes can nest, which GL_TIME_ELAPSED queries cannot), and each frame records into its own
+// slot of a ring of max_frames. begin_frame() reads back only the slots whose last query the GPU
+// has finished, so results arrive a couple of frames late and the CPU never waits on them; if the
+// GPU falls a whole ring behind, the frame is dropped rather than waited on.
+//
+// CPU time is the time spent between begin_pass() and end_pass() on the calling thread, which for
+// GL passes is the cost of issuing the commands rather than of executing them.
+class GpuProfiler
+{
+public:
+    static const int max_frames = 4;
+    static const int max_passes = 32;           // Per frame; further passes are not timed
+    static const int max_depth = 8;
+
+    struct PassTiming
+    {
+        const char* name;
+        int depth;                              // Nesting level, 0 for top-level passes
+        float gpu_ms;
+        float cpu_ms;
+    };
+
+    void init();
+    void shutdown();
+
+    // Read back finished frames, then start recording this one; call on the GL thread
+    void begin_frame();
+    void end_frame();
+
+    // Bracket a pass; name must outlive the results (a string literal)
+    void begin_pass(const char* name);
+    void end_pass();
+
+    bool enabled = true;
+    std::vector<PassTiming> passes;             // Newest frame read back, in the order passes began
+    float frame_gpu_ms = 0.0f;                  // From its first timestamp to its last
+    int latency = 0;                            // Frames between recording it and reading it back
+    int dropped_frames = 0;                     // Not recorded because the ring was still in flight
+
+private:
+    struct Pass
+    {
+        const char* name;
+        int depth;
+        std::chrono::steady_clock::time_point cpu_begin;
+        float cpu_ms;
+    };
+
+    struct Frame
+    {
+        GLuint queries[max_passes * 2] = {};    // Begin and end timestamp of each pass
+        Pass passes[max_passes];
+        int pass_count = 0;
+        int last_query = -1;                    // Issued last, so the GPU finishes it last
+        unsigned number = 0;
+        bool pending = false;
+    };
+
+    void collect();
+
+    Frame frames[max_frames];
+    Frame* recording = nullptr;
+    int stack[max_depth] = {};                  // Open passes of the recording frame, -1 if untimed
+    int depth = 0;
+    int overflow = 0;                           // Passes opened beyond max_depth, ignored
+    unsigned frame_number = 0;
+    bool initialised = false;
+};
+
+// The application-wide profiler (init() once a GL context is current)
+GpuProfiler& gpu_profiler();
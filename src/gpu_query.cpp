@@ -0,0 +1,57 @@
+#include "gpu_query.h"
+
+void QueryRing::init(GLenum query_target, int query_count)
+{
+    target = query_target;
+    count = query_count < 1 ? 1 : (query_count > max_queries ? max_queries : query_count);
+    glGenQueries(count, queries);
+    next = 0;
+}
+
+void QueryRing::shutdown()
+{
+    glDeleteQueries(count, queries);
+    for (int i = 0; i < max_queries; i++)
+    {
+        queries[i] = 0;
+        pending[i] = false;
+    }
+    count = 0;
+}
+
+void QueryRing::begin()
+{
+    active = count > 0 && !pending[next];
+    if (active)
+        glBeginQuery(target, queries[next]);
+}
+
+void QueryRing::end()
+{
+    if (!active)
+        return;
+    glEndQuery(target);
+    pending[next] = true;
+    next = (next + 1) % count;
+    active = false;
+}
+
+bool QueryRing::poll(GLuint64& value)
+{
+    // Oldest first (next is the slot to reuse), so the newest finished result wins
+    bool found = false;
+    for (int i = 0; i < count; i++)
+    {
+        int index = (next + i) % count;
+        if (!pending[index])
+            continue;
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &value);
+        pending[index] = false;
+        found = true;
+    }
+    return found;
+}
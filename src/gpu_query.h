@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/glad.h>
+
+// A ring of GL queries of one kind (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) for measuring the
+// same span every frame without stalling: each frame begins the next query in the ring, and
+// poll() only reads results the GPU has already made available, so they arrive a few frames
+// late. If the GPU falls a whole ring behind, that frame is skipped rather than waited on.
+class QueryRing
+{
+public:
+    static const int max_queries = 8;
+
+    void init(GLenum target, int count = 4);
+    void shutdown();
+
+    void begin();
+    void end();
+
+    // Collect finished queries; true if any arrived, with the newest result in value
+    bool poll(GLuint64& value);
+
+private:
+    GLenum target = GL_TIME_ELAPSED;
+    int count = 0;
+    GLuint queries[max_queries] = {};
+    bool pending[max_queries] = {};
+    int next = 0;
+    bool active = false;
+};
@@ -0,0 +1,81 @@
+#include "instance_renderer.h"
+#include "gl_state.h"
+
+#include <stddef.h>
+
+static uint32_t pack_unorm8(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (uint32_t)(v * 255.0f + 0.5f);
+}
+
+static uint16_t pack_unorm16(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+void pack_instance(InstanceData& out, const glm::mat4& model, const glm::vec4& colour, const glm::vec4& texture_rect, float texture_layer)
+{
+    // glm matrices are column-major, so gather each row across the columns
+    for (int row = 0; row < 3; row++)
+        out.model_rows[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+    out.colour = pack_unorm8(colour.r) | (pack_unorm8(colour.g) << 8) | (pack_unorm8(colour.b) << 16) | (pack_unorm8(colour.a) << 24);
+    for (int k = 0; k < 4; k++)
+        out.texture_rect[k] = pack_unorm16(texture_rect[k]);
+    out.texture_layer = texture_layer;
+}
+
+void InstanceBuffer::init()
+{
+    // Room for 16k instances per region to start with, grown on demand
+    stream.init(GL_ARRAY_BUFFER, 16384 * sizeof(InstanceData));
+    base_offset = 0;
+}
+
+void InstanceBuffer::shutdown()
+{
+    stream.shutdown();
+}
+
+InstanceData* InstanceBuffer::map(int count)
+{
+    size_t bytes = (size_t)count * sizeof(InstanceData);
+    stream.begin_frame(bytes);
+    StreamBuffer::Allocation allocation = stream.allocate(bytes, 16);
+    base_offset = allocation.offset;
+    return (InstanceData*)allocation.ptr;
+}
+
+void InstanceBuffer::unmap()
+{
+    stream.flush();
+}
+
+void InstanceBuffer::end_frame()
+{
+    stream.end_frame();
+}
+
+void InstanceBuffer::attach(GLuint vao, GLuint first_location)
+{
+    gl_state().bind_vertex_array(vao);
+    for (GLuint i = 0; i < attribute_count; i++)
+    {
+        glEnableVertexAttribArray(first_location + i);
+        glVertexAttribDivisor(first_location + i, 1);
+    }
+    set_first_instance(first_location, 0);
+    gl_state().bind_vertex_array(0);
+}
+
+void InstanceBuffer::set_first_instance(GLuint first_location, int first_instance)
+{
+    size_t base = base_offset + (size_t)first_instance * sizeof(InstanceData);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, stream.buffer);
+    for (GLuint row = 0; row < 3; row++)
+        glVertexAttribPointer(first_location + row, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, model_rows) + row * sizeof(glm::vec4)));
+    glVertexAttribPointer(first_location + 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, colour)));
+    glVertexAttribPointer(first_location + 4, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, texture_rect)));
+    glVertexAttribPointer(first_location + 5, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, texture_layer)));
+}
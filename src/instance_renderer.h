@@ -0,0 +1,50 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "stream_buffer.h"
+
+// Per-instance data streamed to the GPU for instanced draws.
+// The model matrix is stored as its first three rows (the last row is always 0,0,0,1)
+// and the colour is packed as RGBA8. The texture rect (UNORM16 offset and scale) and array
+// layer place pooled textures (see texture_pool.h); layer -1 samples the bound 2D texture.
+// One instance costs 64 bytes.
+struct InstanceData
+{
+    glm::vec4 model_rows[3];
+    uint32_t colour;
+    uint16_t texture_rect[4];
+    float texture_layer;
+};
+
+void pack_instance(InstanceData& out, const glm::mat4& model, const glm::vec4& colour,
+                   const glm::vec4& texture_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), float texture_layer = -1.0f);
+
+// Vertex buffer holding one InstanceData per instance, bound to a VAO with an attribute divisor of 1.
+// Instances are written straight into a persistently mapped ring (see stream_buffer.h), once per frame:
+// map() -> write -> unmap() -> draws -> end_frame().
+class InstanceBuffer
+{
+public:
+    // Number of vertex attribute locations used by the instance attributes
+    static const GLuint attribute_count = 6;
+
+    void init();
+    void shutdown();
+
+    // Reserve this frame's instance storage; the returned memory may be filled from any thread
+    InstanceData* map(int count);
+    void unmap();
+    // Fence this frame's instances once every draw using them has been submitted
+    void end_frame();
+
+    // Configure per-instance attributes [first_location, first_location + attribute_count) on vao
+    void attach(GLuint vao, GLuint first_location);
+
+    // Point the instance attributes of the currently bound VAO at first_instance.
+    // GL 3.3 has no base-instance draws, so batches sharing one upload re-specify the offset instead.
+    void set_first_instance(GLuint first_location, int first_instance);
+
+    StreamBuffer stream;
+    size_t base_offset = 0;     // Byte offset of this frame's instance 0 in stream.buffer
+};
@@ -0,0 +1,135 @@
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <stdio.h>
+
+JobSystem& job_system()
+{
+    static JobSystem system;
+    static bool initialised = false;
+    if (!initialised)
+    {
+        system.init();
+        initialised = true;
+    }
+    return system;
+}
+
+void JobSystem::init(int worker_count)
+{
+    if (worker_count < 0)
+    {
+        int hardware = (int)std::thread::hardware_concurrency();
+        worker_count = hardware > 1 ? hardware - 1 : 0;
+    }
+    quit = false;
+    for (int i = 0; i < worker_count; i++)
+        workers.emplace_back(&JobSystem::worker_loop, this, i);
+}
+
+void JobSystem::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void JobSystem::execute_tasks(const std::function<void(int)>& task, int task_count)
+{
+    for (int index = next_task.fetch_add(1); index < task_count; index = next_task.fetch_add(1))
+    {
+        {
+            PROFILE_ZONE("Job");
+            task(index);
+        }
+        if (finished_tasks.fetch_add(1) + 1 == task_count)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+}
+
+void JobSystem::worker_loop(int worker_index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "Worker %d", worker_index);
+    cpu_profiler().name_thread(name);
+    unsigned seen_generation = 0;
+    for (;;)
+    {
+        const std::function<void(int)>* task;
+        int task_count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen_generation; });
+            if (quit)
+                return;
+            seen_generation = generation;
+            task = current_task;
+            task_count = current_task_count;
+            if (task == nullptr)
+                continue;
+            // run_tasks() waits for this to drop back to zero, so the task outlives our use of it
+            active_workers++;
+        }
+        execute_tasks(*task, task_count);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active_workers == 0)
+                done.notify_all();
+        }
+    }
+}
+
+void JobSystem::run_tasks(int task_count, const std::function<void(int)>& task)
+{
+    if (task_count <= 0)
+        return;
+    if (workers.empty() || task_count == 1)
+    {
+        for (int i = 0; i < task_count; i++)
+            task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_task = &task;
+        current_task_count = task_count;
+        next_task.store(0);
+        finished_tasks.store(0);
+        generation++;
+    }
+    wake.notify_all();
+    execute_tasks(task, task_count);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return finished_tasks.load() == task_count && active_workers == 0; });
+    current_task = nullptr;
+}
+
+void JobSystem::parallel_for(int count, int min_batch, const std::function<void(int, int)>& fn)
+{
+    if (count <= 0)
+        return;
+    if (min_batch < 1)
+        min_batch = 1;
+    // A few batches per thread so uneven batches balance out
+    int batches = thread_count() * 4;
+    int batch_size = (count + batches - 1) / batches;
+    if (batch_size < min_batch)
+        batch_size = min_batch;
+    batches = (count + batch_size - 1) / batch_size;
+    run_tasks(batches, [&](int batch)
+    {
+        int begin = batch * batch_size;
+        int end = begin + batch_size < count ? begin + batch_size : count;
+        fn(begin, end);
+    });
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork/join worker pool for data-parallel frame work (sorting, culling, light binning, ...).
+// The calling thread always takes part, so run_tasks() also works with zero workers.
+class JobSystem
+{
+public:
+    // worker_count < 0 picks hardware_concurrency - 1
+    void init(int worker_count = -1);
+    void shutdown();
+
+    // Number of threads that execute tasks, including the caller
+    int thread_count() const { return (int)workers.size() + 1; }
+
+    // Run task(index) for index in [0, task_count) and block until all have finished.
+    // Task indices are stable, so callers can use them to address per-task scratch data.
+    void run_tasks(int task_count, const std::function<void(int)>& task);
+
+    // Split [0, count) into batches of at least min_batch items and run fn(begin, end) on each
+    void parallel_for(int count, int min_batch, const std::function<void(int, int)>& fn);
+
+private:
+    void worker_loop(int worker_index);
+    void execute_tasks(const std::function<void(int)>& task, int task_count);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* current_task = nullptr;
+    int current_task_count = 0;
+    std::atomic<int> next_task{ 0 };
+    std::atomic<int> finished_tasks{ 0 };
+    int active_workers = 0;     // Workers still inside the current run; guarded by mutex
+    unsigned generation = 0;
+    bool quit = false;
+};
+
+// The application-wide worker pool (lazily initialised with the default worker count)
+JobSystem& job_system();
@@ -0,0 +1,322 @@
+#include "light_clusters.h"
+#include "scene_renderer.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <math.h>
+#include <chrono>
+
+void LightClusters::init()
+{
+    GLint texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+    max_buffer_texels = texels > 0 ? texels : 65536;
+
+    const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    glGenBuffers(BUFFER_COUNT, buffers);
+    glGenTextures(BUFFER_COUNT, textures);
+    for (int b = 0; b < BUFFER_COUNT; b++)
+    {
+        // A texture buffer follows its buffer's data store, so it only has to be attached once
+        capacity[b] = 256;
+        gl_state().bind_buffer(GL_TEXTURE_BUFFER, buffers[b]);
+        glBufferData(GL_TEXTURE_BUFFER, capacity[b], nullptr, GL_STREAM_DRAW);
+        gl_state().bind_texture(0, GL_TEXTURE_BUFFER, textures[b]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[b], buffers[b]);
+    }
+    gl_state().bind_buffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::shutdown()
+{
+    for (int b = 0; b < BUFFER_COUNT; b++)
+    {
+        gl_state().forget_texture(textures[b]);
+        gl_state().forget_buffer(buffers[b]);
+    }
+    glDeleteTextures(BUFFER_COUNT, textures);
+    glDeleteBuffers(BUFFER_COUNT, buffers);
+    for (int b = 0; b < BUFFER_COUNT; b++)
+    {
+        textures[b] = buffers[b] = 0;
+        capacity[b] = 0;
+    }
+}
+
+void LightClusters::upload(int buffer, const void* data, size_t bytes)
+{
+    // Orphan the old store so the GPU can keep reading last frame's lists while we write
+    gl_state().bind_buffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+    while (capacity[buffer] < bytes)
+        capacity[buffer] *= 2;
+    glBufferData(GL_TEXTURE_BUFFER, capacity[buffer], nullptr, GL_STREAM_DRAW);
+    if (bytes > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+}
+
+void LightClusters::update(const std::vector<Light>& lights, const glm::mat4& transform, const SceneView& view, const std::vector<int>* shadow_tiles)
+{
+    PROFILE_ZONE("Bin Lights");
+    auto start = std::chrono::steady_clock::now();
+    stats = Stats();
+    const int light_count = (int)lights.size();
+    stats.lights = light_count;
+
+    tile_size = clustered ? glm::max(tile_pixels, 8) : glm::max(view.width, view.height);
+    grid_x = (view.width + tile_size - 1) / tile_size;
+    grid_y = (view.height + tile_size - 1) / tile_size;
+    grid_z = clustered ? glm::clamp(depth_slices, 1, 64) : 1;
+    const int tiles = grid_x * grid_y;
+    stats.clusters = tiles * grid_z;
+
+    // Transform and bound every light, and find the tiles its bound covers on screen
+    const glm::mat4 to_view = view.view * transform;
+    const glm::mat4& projection = view.projection;
+    bounds.resize(light_count);
+    light_data.resize((size_t)light_count * texels_per_light);
+    job_system().parallel_for(light_count, 1024, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const Light& light = lights[i];
+            LightBounds& b = bounds[i];
+            glm::vec3 position = glm::vec3(to_view * glm::vec4(light.position, 1.0f));
+            glm::vec3 direction(0.0f);
+            float cos_outer = -2.0f, cone_scale = 1.0f;     // Point lights: the cone term is always 1
+            b.centre = position;
+            b.radius = light.range;
+            if (light.type == LIGHT_SPOT)
+            {
+                // Smallest sphere around the cone: for wide cones the base circle, otherwise the
+                // sphere through the apex and the base rim
+                direction = glm::normalize(glm::vec3(to_view * glm::vec4(light.direction, 0.0f)));
+                float outer = glm::radians(glm::clamp(light.outer_angle, 1.0f, 89.0f));
+                float inner = glm::radians(glm::clamp(light.inner_angle, 0.0f, glm::degrees(outer)));
+                cos_outer = cosf(outer);
+                cone_scale = 1.0f / glm::max(cosf(inner) - cos_outer, 1e-4f);
+                float along = outer > 0.785398f ? light.range * cos_outer : light.range / (2.0f * cos_outer);
+                b.centre = position + direction * along;
+                b.radius = outer > 0.785398f ? light.range * sinf(outer) : along;
+            }
+            glm::vec4* data = &light_data[(size_t)i * texels_per_light];
+            data[0] = glm::vec4(position, light.range);
+            data[1] = glm::vec4(light.colour * light.intensity, cos_outer);
+            data[2] = glm::vec4(direction, cone_scale);
+            int shadow_tile = shadow_tiles && i < (int)shadow_tiles->size() ? (*shadow_tiles)[i] : -1;
+            data[3] = glm::vec4((float)shadow_tile, light.type == LIGHT_POINT ? 1.0f : 0.0f, 0.0f, 0.0f);
+
+            float depth = -b.centre.z;
+            b.visible = depth + b.radius > view.near_plane && depth - b.radius < view.far_plane;
+            if (!b.visible)
+                continue;
+
+            // The bound's box, clipped to the depth range, projects inside the hull of its corners
+            float d0 = glm::max(depth - b.radius, view.near_plane);
+            float d1 = glm::min(depth + b.radius, view.far_plane);
+            glm::vec2 lo(1e30f), hi(-1e30f);
+            for (int c = 0; c < 8; c++)
+            {
+                glm::vec4 corner((c & 1) ? b.centre.x + b.radius : b.centre.x - b.radius,
+                                 (c & 2) ? b.centre.y + b.radius : b.centre.y - b.radius,
+                                 (c & 4) ? -d1 : -d0, 1.0f);
+                glm::vec4 clip = projection * corner;
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                lo = glm::min(lo, ndc);
+                hi = glm::max(hi, ndc);
+            }
+            glm::vec2 size((float)view.width, (float)view.height);
+            glm::vec2 pixel_lo = (lo * 0.5f + 0.5f) * size;
+            glm::vec2 pixel_hi = (hi * 0.5f + 0.5f) * size;
+            if (pixel_hi.x < 0.0f || pixel_hi.y < 0.0f || pixel_lo.x >= size.x || pixel_lo.y >= size.y)
+            {
+                b.visible = false;
+                continue;
+            }
+            b.x0 = glm::clamp((int)floorf(pixel_lo.x / tile_size), 0, grid_x - 1);
+            b.x1 = glm::clamp((int)floorf(pixel_hi.x / tile_size), 0, grid_x - 1);
+            b.y0 = glm::clamp((int)floorf(pixel_lo.y / tile_size), 0, grid_y - 1);
+            b.y1 = glm::clamp((int)floorf(pixel_hi.y / tile_size), 0, grid_y - 1);
+        }
+    });
+
+    // Keep the visible lights, and slice only the depth range they reach: the scene rarely
+    // fills near..far, and exponential slices over all of it would leave few where it matters
+    int visible = 0;
+    depth_near = 1e30f;
+    depth_far = 0.0f;
+    for (int i = 0; i < light_count; i++)
+    {
+        if (!bounds[i].visible)
+            continue;
+        float depth = -bounds[i].centre.z;
+        depth_near = glm::min(depth_near, glm::max(depth - bounds[i].radius, view.near_plane));
+        depth_far = glm::max(depth_far, glm::min(depth + bounds[i].radius, view.far_plane));
+        bounds[visible] = bounds[i];
+        for (int k = 0; k < texels_per_light; k++)
+            light_data[(size_t)visible * texels_per_light + k] = light_data[(size_t)i * texels_per_light + k];
+        visible++;
+    }
+    stats.visible_lights = visible;
+    if (visible == 0)
+        depth_near = depth_far = 0.0f;     // No depth passes the shader's range test
+    depth_far = glm::max(depth_far, depth_near * 1.001f);
+    slice_scale = visible > 0 ? (float)grid_z / logf(depth_far / depth_near) : 0.0f;
+    slice_bias = visible > 0 ? -logf(depth_near) * slice_scale : 0.0f;
+
+    // Bucket the lights by the depth slices they overlap
+    slice_first.assign(grid_z + 1, 0);
+    for (int k = 0; k < visible; k++)
+    {
+        LightBounds& b = bounds[k];
+        float depth = -b.centre.z;
+        b.z0 = glm::clamp((int)floorf(logf(glm::max(depth - b.radius, depth_near)) * slice_scale + slice_bias), 0, grid_z - 1);
+        b.z1 = glm::clamp((int)floorf(logf(glm::min(depth + b.radius, depth_far)) * slice_scale + slice_bias), 0, grid_z - 1);
+        for (int z = b.z0; z <= b.z1; z++)
+            slice_first[z + 1]++;
+    }
+    for (int z = 0; z < grid_z; z++)
+        slice_first[z + 1] += slice_first[z];
+    slice_lights.resize(slice_first[grid_z]);
+    {
+        std::vector<uint32_t> fill(slice_first.begin(), slice_first.end() - 1);
+        for (int k = 0; k < visible; k++)
+            for (int z = bounds[k].z0; z <= bounds[k].z1; z++)
+                slice_lights[fill[z]++] = (uint32_t)k;
+    }
+
+    // Each slice fills its own clusters: test the light's bound against the box of every
+    // cluster in its tile range, then counting-sort the hits by tile
+    if ((int)slices.size() < grid_z)
+        slices.resize(grid_z);
+    job_system().run_tasks(grid_z, [&](int z)
+    {
+        Slice& slice = slices[z];
+        slice.hits.clear();
+        slice.first.assign(tiles + 1, 0);
+        slice.max_cluster_lights = 0;
+
+        const float d0 = expf(((float)z - slice_bias) / slice_scale);
+        const float d1 = expf(((float)z + 1.0f - slice_bias) / slice_scale);
+        // View-space extent of every tile column and row over the slice's depth range: the
+        // unprojected tile edges at both ends of the slice
+        auto unproject = [&](float ndc, float d, int axis)
+        {
+            float w = projection[3][3] - projection[2][3] * d;
+            return (ndc * w - projection[3][axis] + projection[2][axis] * d) / projection[axis][axis];
+        };
+        auto edges = [&](int count, int pixels, int axis, std::vector<glm::vec2>& out)
+        {
+            out.resize(count);
+            for (int t = 0; t < count; t++)
+            {
+                float n0 = (float)(t * tile_size) / (float)pixels * 2.0f - 1.0f;
+                float n1 = glm::min((float)((t + 1) * tile_size), (float)pixels) / (float)pixels * 2.0f - 1.0f;
+                float a = unproject(n0, d0, axis), b = unproject(n0, d1, axis);
+                float c = unproject(n1, d0, axis), d = unproject(n1, d1, axis);
+                out[t] = glm::vec2(glm::min(glm::min(a, b), glm::min(c, d)), glm::max(glm::max(a, b), glm::max(c, d)));
+            }
+        };
+        edges(grid_x, view.width, 0, slice.columns);
+        edges(grid_y, view.height, 1, slice.rows);
+
+        for (uint32_t s = slice_first[z]; s < slice_first[z + 1]; s++)
+        {
+            const uint32_t k = slice_lights[s];
+            const LightBounds& b = bounds[k];
+            const float radius2 = b.radius * b.radius;
+            float dz = glm::max(glm::max(-d1 - b.centre.z, b.centre.z + d0), 0.0f);
+            for (int ty = b.y0; ty <= b.y1; ty++)
+            {
+                const glm::vec2& row = slice.rows[ty];
+                float dy = glm::max(glm::max(row.x - b.centre.y, b.centre.y - row.y), 0.0f);
+                float dyz2 = dy * dy + dz * dz;
+                if (dyz2 > radius2)
+                    continue;
+                for (int tx = b.x0; tx <= b.x1; tx++)
+                {
+                    const glm::vec2& column = slice.columns[tx];
+                    float dx = glm::max(glm::max(column.x - b.centre.x, b.centre.x - column.y), 0.0f);
+                    if (dx * dx + dyz2 > radius2)
+                        continue;
+                    uint32_t tile = (uint32_t)(ty * grid_x + tx);
+                    slice.hits.push_back(tile);
+                    slice.hits.push_back(k);
+                    slice.first[tile + 1]++;
+                }
+            }
+        }
+
+        for (int t = 0; t < tiles; t++)
+        {
+            slice.max_cluster_lights = glm::max(slice.max_cluster_lights, (int)slice.first[t + 1]);
+            slice.first[t + 1] += slice.first[t];
+        }
+        slice.indices.resize(slice.hits.size() / 2);
+        std::vector<uint32_t>& fill = slice.first;
+        for (size_t h = 0; h < slice.hits.size(); h += 2)
+            slice.indices[fill[slice.hits[h]]++] = slice.hits[h + 1];
+        // The fill pass advanced every tile's start to the next one's; shift them back
+        for (int t = tiles; t > 0; t--)
+            fill[t] = fill[t - 1];
+        fill[0] = 0;
+    });
+
+    // Concatenate the slices' lists; pairs past the texture buffer limit are dropped
+    slice_base.resize(grid_z + 1);
+    slice_base[0] = 0;
+    for (int z = 0; z < grid_z; z++)
+    {
+        slice_base[z + 1] = slice_base[z] + (uint32_t)slices[z].indices.size();
+        stats.max_cluster_lights = glm::max(stats.max_cluster_lights, slices[z].max_cluster_lights);
+    }
+    const uint32_t total = glm::min(slice_base[grid_z], (uint32_t)max_buffer_texels);
+    stats.indices = (int)total;
+    stats.dropped = (int)(slice_base[grid_z] - total);
+    cluster_data.resize((size_t)stats.clusters * 2);
+    indices.resize(total);
+    job_system().run_tasks(grid_z, [&](int z)
+    {
+        const Slice& slice = slices[z];
+        for (int t = 0; t < tiles; t++)
+        {
+            uint32_t first = slice_base[z] + slice.first[t];
+            uint32_t end = glm::min(slice_base[z] + slice.first[t + 1], total);
+            uint32_t* cluster = &cluster_data[((size_t)z * tiles + t) * 2];
+            cluster[0] = first;
+            cluster[1] = end > first ? end - first : 0;
+        }
+        uint32_t end = glm::min(slice_base[z + 1], total);
+        for (uint32_t i = slice_base[z]; i < end; i++)
+            indices[i] = slice.indices[i - slice_base[z]];
+    });
+    auto upload_start = std::chrono::steady_clock::now();
+    stats.assign_ms = std::chrono::duration<double, std::milli>(upload_start - start).count();
+
+    upload(BUFFER_LIGHTS, light_data.data(), (size_t)visible * texels_per_light * sizeof(glm::vec4));
+    upload(BUFFER_CLUSTERS, cluster_data.data(), cluster_data.size() * sizeof(uint32_t));
+    upload(BUFFER_INDICES, indices.data(), indices.size() * sizeof(uint32_t));
+    gl_state().bind_buffer(GL_TEXTURE_BUFFER, 0);
+    stats.upload_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - upload_start).count();
+}
+
+void LightClusters::bind() const
+{
+    gl_state().bind_texture(TEXTURE_UNIT_LIGHTS, GL_TEXTURE_BUFFER, textures[BUFFER_LIGHTS]);
+    gl_state().bind_texture(TEXTURE_UNIT_LIGHT_CLUSTERS, GL_TEXTURE_BUFFER, textures[BUFFER_CLUSTERS]);
+    gl_state().bind_texture(TEXTURE_UNIT_LIGHT_INDICES, GL_TEXTURE_BUFFER, textures[BUFFER_INDICES]);
+}
+
+void LightClusters::uniforms(glm::vec4& cluster_grid, glm::vec4& cluster_depth) const
+{
+    cluster_grid = glm::vec4((float)grid_x, (float)grid_y, (float)grid_z, (float)tile_size);
+    cluster_depth = glm::vec4(slice_scale, slice_bias, depth_near, depth_far);
+}
+
+void LightClusters::bind_samplers(GLuint program)
+{
+    // Expects program to be current; a program without the samplers just gets location -1
+    glUniform1i(glGetUniformLocation(program, "uLights"), TEXTURE_UNIT_LIGHTS);
+    glUniform1i(glGetUniformLocation(program, "uClusters"), TEXTURE_UNIT_LIGHT_CLUSTERS);
+    glUniform1i(glGetUniformLocation(program, "uLightIndices"), TEXTURE_UNIT_LIGHT_INDICES);
+}
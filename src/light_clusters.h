@@ -0,0 +1,111 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+
+struct SceneView;
+
+// Texture units the light buffers are bound to while the scene is shaded
+enum
+{
+    TEXTURE_UNIT_LIGHTS = 8,
+    TEXTURE_UNIT_LIGHT_CLUSTERS = 9,
+    TEXTURE_UNIT_LIGHT_INDICES = 10
+};
+
+// Clustered forward lighting. The view frustum is split into screen tiles of tile_pixels and
+// depth_slices exponential depth slices, covering only the depth range the visible lights reach.
+// Every frame the lights are transformed and bounded on the worker threads, each slice's
+// clusters are filled by its own task (sphere vs cluster box), and the result goes to three
+// texture buffers the scene shader reads per fragment:
+//
+//     uLights        RGBA32F, texels_per_light texels per visible light: view position + range,
+//                    colour * intensity + cos(outer angle), view direction + 1 / cone falloff width,
+//                    first shadow atlas tile (-1 for none) + 1 for point lights
+//     uClusters      RG32UI, 1 texel per cluster: first entry in uLightIndices, light count
+//     uLightIndices  R32UI, every cluster's light list back to back
+//
+// The cluster of a fragment is found from gl_FragCoord and its view depth, using the
+// cluster_grid/cluster_depth fields of FrameUniforms (see uniforms()).
+class LightClusters
+{
+public:
+    struct Stats
+    {
+        int lights = 0;
+        int visible_lights = 0;     // Lights whose bounds touch the view frustum
+        int clusters = 0;
+        int indices = 0;            // Cluster/light pairs
+        int max_cluster_lights = 0;
+        int dropped = 0;            // Pairs past GL_MAX_TEXTURE_BUFFER_SIZE, not shaded
+        double assign_ms = 0.0;     // Transform, bound and bin on the CPU
+        double upload_ms = 0.0;
+    };
+
+    void init();
+    void shutdown();
+
+    static const int texels_per_light = 4;
+
+    // Bin lights (world space, each moved by transform first) for one view and upload the buffers.
+    // shadow_tiles, if given, holds each light's first shadow atlas tile (see ShadowMaps::light_tiles).
+    void update(const std::vector<Light>& lights, const glm::mat4& transform, const SceneView& view,
+                const std::vector<int>* shadow_tiles = nullptr);
+    // Bind the buffers to their TEXTURE_UNIT_* units
+    void bind() const;
+    // Fill the cluster fields of FrameUniforms for the last update()
+    void uniforms(glm::vec4& cluster_grid, glm::vec4& cluster_depth) const;
+
+    // Point a program's light samplers at their texture units; call once after linking
+    static void bind_samplers(GLuint program);
+
+    bool clustered = true;      // With false, every visible light goes into one cluster (for comparison)
+    int tile_pixels = 64;
+    int depth_slices = 24;
+    Stats stats;
+
+private:
+    enum { BUFFER_LIGHTS, BUFFER_CLUSTERS, BUFFER_INDICES, BUFFER_COUNT };
+
+    // View-space bound of one light and the range of clusters it may touch
+    struct LightBounds
+    {
+        glm::vec3 centre;
+        float radius;
+        int x0, x1, y0, y1, z0, z1;
+        bool visible;
+    };
+
+    // Scratch for the task filling one depth slice
+    struct Slice
+    {
+        std::vector<uint32_t> hits;     // Tile, light pairs, in light order
+        std::vector<uint32_t> first;    // Per tile, into indices
+        std::vector<uint32_t> indices;
+        std::vector<glm::vec2> columns, rows;   // View-space x/y range of each tile column/row
+        int max_cluster_lights = 0;
+    };
+
+    void upload(int buffer, const void* data, size_t bytes);
+
+    GLuint buffers[BUFFER_COUNT] = {};
+    GLuint textures[BUFFER_COUNT] = {};
+    size_t capacity[BUFFER_COUNT] = {};
+    int max_buffer_texels = 65536;
+
+    int grid_x = 1, grid_y = 1, grid_z = 1;
+    int tile_size = 64;
+    float depth_near = 0.0f, depth_far = 0.0f;
+    float slice_scale = 0.0f, slice_bias = 0.0f;
+
+    std::vector<LightBounds> bounds;
+    std::vector<glm::vec4> light_data;
+    std::vector<uint32_t> slice_first;      // Per slice, into slice_lights (one extra at the end)
+    std::vector<uint32_t> slice_lights;     // Visible lights overlapping each slice
+    std::vector<Slice> slices;
+    std::vector<uint32_t> slice_base;       // Per slice, its first entry in the final index list
+    std::vector<uint32_t> cluster_data;
+    std::vector<uint32_t> indices;
+};
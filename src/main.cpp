@@ -18,13 +18,29 @@
 #include <stdio.h>
 #include <math.h>
 #include <vector>
+#include <algorithm>
 #define GL_SILENCE_DEPRECATION
 #include <string>
+#include <unordered_map>
 #include <cstring>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "scene.h"
+#include "mesh.h"
+#include "mesh_import.h"
+#include "scene_renderer.h"
+#include "scene_bvh.h"
+#include "shader_manager.h"
+#include "texture_cache.h"
+#include "render_target.h"
+#include "dynamic_resolution.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "fullscreen_pass.h"
+#include "gl_state.h"
+#include "job_system.h"
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
 #endif
@@ -46,6 +62,7 @@ static void glfw_error_callback(int error, const char* description)
     fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
 
+
 // Main code
 int main(int, char**)
 {
@@ -168,28 +185,29 @@ int main(int, char**)
     bool show_properties_window = true;
     bool show_viewport_window = true;
     bool show_viewport_toolbar_window = true;
+    bool show_texture_streaming_window = true;
+    bool show_cpu_profiler_window = true;
+    int profiler_selected_age = 0;     // Frame shown in the CPU profiler's flame graph, 0 the newest
 
     bool viewport_wireframe = false;
+    bool viewport_instancing = true;   // Draw scene objects with instanced calls instead of one call each
+    bool viewport_texture_batching = true;  // Objects with textures on one pool page share a draw
+    bool animate_lights = true;        // Turn the light field about the view axis, so lights are re-binned as they move
     
-    // Triangle management - use vector to track individual triangles
-    std::vector<int> triangle_ids;
-    // Parallel vector to store persistent triangle names (so InputText has stable storage)
-    std::vector<std::string> triangle_names;
-    int next_triangle_id = 0;
+    // Triangle management - parallel vectors tracking individual triangles (see scene.h)
+    Scene scene;
     // Rename popup state
     int rename_target = -1;
     char rename_buf[64] = {0};
     // Deferred popup triggers (open at root ID stack)
     bool open_about_popup = false;
     bool open_rename_popup = false;
+    bool open_import_popup = false;
+    // Import popup state
+    char import_path_buf[260] = {0};
+    std::string import_error;
 
-    {
-        char default_name[32];
-        snprintf(default_name, sizeof(default_name), "Triangle %d", next_triangle_id);
-        triangle_ids.push_back(next_triangle_id);
-        triangle_names.push_back(std::string(default_name));
-        next_triangle_id++;
-    }
+    scene.add_object("Triangle");
 
     ImVec4 clear_color = ImVec4(0.08f, 0.08f, 0.09f, 1.00f);  // WINDOW BACKGROUND (very dark)
 
@@ -199,8 +217,10 @@ int main(int, char**)
     double previous_time = glfwGetTime();
     int frame_count = 0;
     float fps = 0.0f;
+    GLStateCache::Stats gl_state_stats;
+    double startup_ms = -1.0;   // glfwInit to the first presented frame (glfwGetTime starts at init)
 
-    // Track the on-screen canvas rect used for OpenGL rendering inside the ImGui Viewport window
+    // Track the on-screen canvas rect of the viewport image inside the ImGui Viewport window
     ImVec2 viewport_canvas_pos = ImVec2(0.0f, 0.0f);   // Top-left in ImGui screen space
     ImVec2 viewport_canvas_size = ImVec2(0.0f, 0.0f);  // Size in pixels (ImGui screen space)
 
@@ -210,87 +230,50 @@ int main(int, char**)
 
     // OPENGL STUFF HERE
 
-    // SHADERS
-    const char* vertexShaderSource = R"(
-        #version 330 core
-        layout (location = 0) in vec2 aPos;
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
-        
-        void main()
-        {
-            // aPos is a vec2, expand to vec4 with z=0.0
-            gl_Position = projection * view * model * vec4(aPos, 0.0, 1.0);
-        }
-    )";
-    
-    const char* fragmentShaderSource = R"(
-        #version 330 core
-        out vec4 FragColor;
-        
-        void main()
-        {
-            FragColor = vec4(0.639, 0.816, 0.988, 1.0); // Bright white color
-        }
-    )";
-    
-    // ogl
-    // Transform will be computed per-frame in the render loop
-
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    
-    // Create shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Query uniform locations for model/view/projection so we can upload matrices later
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-
-    // Clean up shaders (no longer needed after linking)
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // TRIANGLE 🔺
-    GLfloat verts[] = {
-        +0.5f, +0.5f,   // Top vertex
-        -0.5f, -0.5f,   // Bottom left
-        +0.5f, -0.5f,   // Bottom right
-
-        -0.5f, +0.5f,   // Top vertex
-        -0.5f, -0.5f,   // Bottom left
-        +0.5f, +0.5f    // Top right
-    };
-
-    // Create VAO (Vertex Array Object) - REQUIRED for Core Profile
-    GLuint VAO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    
-    // Create and setup VBO (Vertex Buffer Object)
-    GLuint vertexBufferID;
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-
-    // Setup vertex attributes (must be done while VAO is bound)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    
-    // Unbind VAO (good practice)
-    glBindVertexArray(0);
+    // Scene renderer: shaders, meshes, render queue and instance stream (see scene_renderer.h)
+    // Programs are built from AEROSLR_SHADER_DIR, linked binaries are reused from shader_cache/
+    ShaderManager shader_manager;
+    shader_manager.init(AEROSLR_SHADER_DIR, "shader_cache", (GLADloadproc)glfwGetProcAddress);
+    SceneRenderer scene_renderer;
+    if (!scene_renderer.init(shader_manager))
+        fprintf(stderr, "Scene shaders failed to build, the viewport will be empty\n");
+    // Imported textures are block-compressed once and kept as KTX2 files in texture_cache/
+    TextureCache texture_cache;
+    texture_cache.init("texture_cache");
+    TextureFormat texture_import_format = texture_format_supported(TEXTURE_FORMAT_BC1) ? TEXTURE_FORMAT_BC1 : TEXTURE_FORMAT_RGBA8;
+    std::vector<TextureHandle> streamed_textures;   // The Textured Spheres scene's, created on its first use
+    std::vector<TextureHandle> pooled_textures;     // The Pooled Textures scene's, created on its first use
+
+    // The viewport is rendered offscreen and shown as an image in the Viewport window. The scene
+    // renders into scene_target at the dynamic resolution scale; when that is below 100% it is
+    // upscaled into viewport_target at the canvas size, otherwise scene_target is shown directly.
+    RenderTarget scene_target;
+    RenderTarget viewport_target;
+    scene_target.init();
+    viewport_target.init();
+    DynamicResolution dynamic_resolution;
+    if (!dynamic_resolution.init(shader_manager))
+    {
+        fprintf(stderr, "Upscale shaders failed to build, dynamic resolution disabled\n");
+        dynamic_resolution.enabled = false;
+        dynamic_resolution.min_scale = 1.0f;
+    }
+    bool viewport_upscaled = false;
+    // Per-pass GPU timings, read back a few frames late without stalling
+    gpu_profiler().init();
+    cpu_profiler().name_thread("Main");
+
+    // Spatial index over the scene objects, used for BVH culling, click picking and marquee selection
+    SceneBvh scene_bvh;
+    scene_renderer.bvh = &scene_bvh.bvh;
+    int active_object = -1;         // Object shown in the Inspector (the last one clicked)
+    bool marquee_active = false;    // Left button went down over the viewport and is still held
+    ImVec2 marquee_start = ImVec2(0.0f, 0.0f);
+
+    // TRIANGLE 🔺 (mesh 0, the quad test shape)
+    scene_renderer.add_mesh(make_quad_mesh());
+    // Sphere (mesh 1), the built-in mesh with a LOD chain
+    const int sphere_mesh = scene_renderer.add_mesh(make_sphere_mesh());
 
     // Main loop
 #ifdef __EMSCRIPTEN__
@@ -317,7 +300,10 @@ int main(int, char**)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        {
+            PROFILE_ZONE("Poll Events");
+            glfwPollEvents();
+        }
         if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
         {
             ImGui_ImplGlfw_Sleep(10);
@@ -329,10 +315,22 @@ int main(int, char**)
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        // Swap in any programs that finished compiling since last frame
+        shader_manager.update();
+        // Pick the viewport render scale from the latest GPU timings, before the targets are sized
+        dynamic_resolution.update();
+
+        // Every object spins around its own origin on top of its scene transform. The view is
+        // filled in once the viewport knows its render size, and reused for picking and drawing.
+        glm::mat4 spin = glm::mat4(1.0f);
+        spin = glm::rotate(spin, (float)glfwGetTime(), glm::vec3(1.0f, 0.0f, 0.3f));
+        SceneView scene_view;
+
         // MAIN CODE HERE -------------------------------------------------------------
 
         // Simple DockSpace for resizable panels
         {
+            PROFILE_ZONE("Dock Layout");
             ImGuiViewport* vp = ImGui::GetMainViewport();
             ImGui::SetNextWindowPos(vp->WorkPos);
             ImGui::SetNextWindowSize(vp->WorkSize);
@@ -386,8 +384,10 @@ int main(int, char**)
                 // Dock all windows to create shared splitters
                 ImGui::DockBuilderDockWindow("Scene Hierarchy", dock_left);
                 ImGui::DockBuilderDockWindow("Console", dock_bottom);  
+                ImGui::DockBuilderDockWindow("CPU Profiler", dock_bottom);
                 ImGui::DockBuilderDockWindow("Inspector", dock_right_top);
                 ImGui::DockBuilderDockWindow("Properties", dock_right_bottom);
+                ImGui::DockBuilderDockWindow("Texture Streaming", dock_right_bottom);
                 ImGui::DockBuilderDockWindow("Viewport Toolbar", dock_toolbar);
                 ImGui::DockBuilderDockWindow("Viewport", dock_viewport);
                 
@@ -401,10 +401,11 @@ int main(int, char**)
 
         if (ImGui::BeginMainMenuBar())
         {
+            PROFILE_ZONE("Menu Bar");
             if (ImGui::BeginMenu("File"))
             {
                 if (ImGui::MenuItem("New")) { /* do something */ }
-                if (ImGui::MenuItem("Open...")) { /* do something */ }
+                if (ImGui::MenuItem("Open...")) { open_import_popup = true; }
                 if (ImGui::MenuItem("Save")) { /* do something */ }
                 if (ImGui::MenuItem("Exit")) { glfwSetWindowShouldClose(window, GLFW_TRUE); }
                 ImGui::EndMenu();
@@ -450,12 +451,20 @@ int main(int, char**)
                 {
                     show_viewport_window = !show_viewport_window;
                 }
+                if (ImGui::MenuItem("Texture Streaming", nullptr, show_texture_streaming_window))
+                {
+                    show_texture_streaming_window = !show_texture_streaming_window;
+                }
+                if (ImGui::MenuItem("CPU Profiler", nullptr, show_cpu_profiler_window))
+                {
+                    show_cpu_profiler_window = !show_cpu_profiler_window;
+                }
                 ImGui::EndMenu();
             }
 
             {
-                char fps_str[16];
-                snprintf(fps_str, sizeof(fps_str), "FPS: %.1f", fps);
+                char fps_str[48];
+                snprintf(fps_str, sizeof(fps_str), "FPS: %.1f | GPU: %.2f ms", fps, gpu_profiler().frame_gpu_ms);
                 float text_width = ImGui::CalcTextSize(fps_str).x;
                 ImGui::SetCursorPosX(ImGui::GetWindowWidth() - text_width - ImGui::GetStyle().ItemSpacing.x * 2);
                 ImGui::TextUnformatted(fps_str);
@@ -470,6 +479,7 @@ int main(int, char**)
 
         if (show_scene_hierarchy_window)
         {
+            PROFILE_ZONE("Scene Hierarchy");
             ImGui::SetNextWindowPos(ImVec2(0, 30), ImGuiCond_FirstUseEver);
             ImGui::SetNextWindowSize(ImVec2(500, ImGui::GetIO().DisplaySize.y - 530), ImGuiCond_FirstUseEver);
             
@@ -487,13 +497,172 @@ int main(int, char**)
                 if (ImGui::MenuItem("Triangle"))
                 {
             // Create new triangle id and default name
-            char default_name[32];
-            snprintf(default_name, sizeof(default_name), "Triangle %d", next_triangle_id);
-            triangle_ids.push_back(next_triangle_id);
-            triangle_names.push_back(std::string(default_name));
-            next_triangle_id++;
+            scene.add_object("Triangle");
             ImGui::CloseCurrentPopup();
                 }
+                if (ImGui::MenuItem("Sphere"))
+                {
+                    scene.add_object("Sphere", sphere_mesh);
+                    ImGui::CloseCurrentPopup();
+                }
+                if (ImGui::BeginMenu("Stress Test"))
+                {
+                    // Replace the scene with a grid of objects to compare the instanced and per-object paths
+                    const int stress_counts[] = { 1000, 10000, 100000, 1000000 };
+                    for (int count : stress_counts)
+                    {
+                        char label[32];
+                        snprintf(label, sizeof(label), "%d Triangles", count);
+                        if (ImGui::MenuItem(label))
+                        {
+                            scene.clear();
+                            rename_target = -1;
+                            active_object = -1;
+                            scene_add_stress_grid(scene, count, "Triangle");
+                            ImGui::CloseCurrentPopup();
+                        }
+                    }
+                    // Spheres exercise the LOD chain: the denser the grid, the smaller each one is on screen
+                    ImGui::Separator();
+                    for (int count : stress_counts)
+                    {
+                        char label[32];
+                        snprintf(label, sizeof(label), "%d Spheres", count);
+                        if (ImGui::MenuItem(label))
+                        {
+                            scene.clear();
+                            rename_target = -1;
+                            active_object = -1;
+                            scene_add_stress_grid(scene, count, "Sphere", sphere_mesh);
+                            ImGui::CloseCurrentPopup();
+                        }
+                    }
+                    // Lighting benchmark: replaces the lights only, so load a grid to light first
+                    ImGui::Separator();
+                    const int light_counts[] = { 1000, 2500, 5000, 10000 };
+                    for (int count : light_counts)
+                    {
+                        char label[32];
+                        snprintf(label, sizeof(label), "%d Lights", count);
+                        if (ImGui::MenuItem(label))
+                        {
+                            scene.lights.clear();
+                            scene_add_light_field(scene, count);
+                            ImGui::CloseCurrentPopup();
+                        }
+                    }
+                    if (ImGui::MenuItem("Remove Lights", nullptr, false, !scene.lights.empty()))
+                    {
+                        scene.lights.clear();
+                        ImGui::CloseCurrentPopup();
+                    }
+                    // Texture streaming: far more texture data than the budget, only the needed mips resident
+                    ImGui::Separator();
+                    if (ImGui::MenuItem("Textured Spheres"))
+                    {
+                        // 256 textures of 2048^2 are about 5.6 GB with full RGBA8 mip chains (0.7 GB as
+                        // BC1); created once, only their tails are resident until the spheres are seen up
+                        // close. Unless the import format is RGBA8 they go through the texture cache: the
+                        // first run encodes them, later runs stream the cached KTX2 files.
+                        TextureStreamer& streamer = scene_renderer.textures;
+                        std::vector<uint8_t> source;
+                        for (int t = (int)streamed_textures.size(); t < 256; t++)
+                        {
+                            char name[32];
+                            snprintf(name, sizeof(name), "Test Texture %d", t);
+                            TextureGenerator generator = make_test_texture((unsigned)t);
+                            TextureHandle handle = INVALID_TEXTURE;
+                            std::string path;
+                            if (texture_import_format != TEXTURE_FORMAT_RGBA8)
+                            {
+                                source.resize(TextureStreamer::level_bytes(TEXTURE_FORMAT_RGBA8, 2048, 0));
+                                generator(0, 2048, 2048, source.data());
+                                if (texture_cache.import(source.data(), 2048, 2048, texture_import_format, path))
+                                    handle = streamer.create_from_file(name, path);
+                            }
+                            if (handle == INVALID_TEXTURE)
+                                handle = streamer.create(name, 2048, generator);
+                            if (handle == INVALID_TEXTURE)
+                                break;
+                            streamed_textures.push_back(handle);
+                        }
+                        scene.clear();
+                        rename_target = -1;
+                        active_object = -1;
+                        scene_add_stress_grid(scene, 2500, "Sphere", sphere_mesh);
+                        for (int i = 0; i < scene.size(); i++)
+                        {
+                            scene.texture_ids[i] = streamed_textures.empty() ? -1 : streamed_textures[i % streamed_textures.size()];
+                            scene.colours[i] = glm::vec4(1.0f);
+                        }
+                        ImGui::CloseCurrentPopup();
+                    }
+                    if (ImGui::MenuItem("Pooled Textures"))
+                    {
+                        // 256 small textures: half in 64x64 array layers, half of assorted sizes packed
+                        // into atlases. With texture batching the spheres take a handful of draws
+                        // instead of one per texture. They are created once and reused by later clicks.
+                        TextureStreamer& streamer = scene_renderer.textures;
+                        if (pooled_textures.empty())
+                        {
+                            unsigned seed = 12345;
+                            for (int t = 0; t < 256; t++)
+                            {
+                                char name[32];
+                                TextureGenerator generator = make_test_texture((unsigned)(1000 + t));
+                                TextureHandle handle;
+                                if (t % 2 == 0)
+                                {
+                                    snprintf(name, sizeof(name), "Layer Texture %d", t / 2);
+                                    handle = streamer.create(name, 64, generator);
+                                }
+                                else
+                                {
+                                    seed = seed * 1664525u + 1013904223u;
+                                    const int width = 16 + 4 * (int)((seed >> 8) % 45);
+                                    const int height = 16 + 4 * (int)((seed >> 20) % 45);
+                                    snprintf(name, sizeof(name), "Atlas Texture %d", t / 2);
+                                    handle = streamer.create_atlased(name, width, height, generator);
+                                }
+                                if (handle != INVALID_TEXTURE)
+                                    pooled_textures.push_back(handle);
+                            }
+                        }
+                        scene.clear();
+                        rename_target = -1;
+                        active_object = -1;
+                        scene_add_stress_grid(scene, 2500, "Sphere", sphere_mesh);
+                        for (int i = 0; i < scene.size(); i++)
+                        {
+                            scene.texture_ids[i] = pooled_textures.empty() ? -1 : pooled_textures[i % pooled_textures.size()];
+                            scene.colours[i] = glm::vec4(1.0f);
+                        }
+                        ImGui::CloseCurrentPopup();
+                    }
+                    // Shadow caching: static objects are drawn into the shadow maps once, dynamic ones every frame
+                    ImGui::Separator();
+                    if (ImGui::MenuItem("Shadow Test"))
+                    {
+                        scene.clear();
+                        rename_target = -1;
+                        active_object = -1;
+                        scene_add_shadow_test(scene, 2500, sphere_mesh);
+                        ImGui::CloseCurrentPopup();
+                    }
+                    if (ImGui::MenuItem("Make All Static"))
+                    {
+                        for (int i = 0; i < scene.size(); i++)
+                            scene.set_static(i, true);
+                        ImGui::CloseCurrentPopup();
+                    }
+                    if (ImGui::MenuItem("Make All Dynamic"))
+                    {
+                        for (int i = 0; i < scene.size(); i++)
+                            scene.set_static(i, false);
+                        ImGui::CloseCurrentPopup();
+                    }
+                    ImGui::EndMenu();
+                }
                 ImGui::EndPopup();
             }
 
@@ -502,17 +671,27 @@ int main(int, char**)
             // Track which triangle to delete (if any)
             int triangle_to_delete = -1;
 
-            for (int i = 0; i < triangle_ids.size(); i++)
+            for (int i = 0; i < scene.size(); i++)
             {
-                ImGui::PushID(triangle_ids[i]);
+                ImGui::PushID(scene.ids[i]);
 
                 // Use the persistent name for display so edits stick
-                const char* node_label = triangle_names[i].c_str();
+                const char* node_label = scene.names[i].c_str();
 
                 // Use Selectable instead of TreeNode for right-click functionality
-                if (ImGui::Selectable(node_label, false))
+                if (ImGui::Selectable(node_label, scene.selected[i] != 0))
                 {
-                    // left-click selection handling can go here
+                    // Ctrl-click toggles, a plain click selects just this object
+                    if (ImGui::GetIO().KeyCtrl)
+                    {
+                        scene.selected[i] = !scene.selected[i];
+                    }
+                    else
+                    {
+                        scene.clear_selection();
+                        scene.selected[i] = 1;
+                    }
+                    active_object = i;
                 }
 
                 if (ImGui::BeginPopupContextItem())
@@ -523,17 +702,13 @@ int main(int, char**)
                     if (ImGui::MenuItem("Rename"))
                     {
                         rename_target = i;
-                        strncpy_s(rename_buf, sizeof(rename_buf), triangle_names[i].c_str(), _TRUNCATE);
+                        strncpy_s(rename_buf, sizeof(rename_buf), scene.names[i].c_str(), _TRUNCATE);
                         // Defer popup open to root to avoid ID stack mismatch
                         open_rename_popup = true;
                     }
                     if (ImGui::MenuItem("Duplicate"))
                     {
-                        char default_name[32];
-                        snprintf(default_name, sizeof(default_name), "Triangle %d", next_triangle_id);
-                        triangle_ids.push_back(next_triangle_id);
-                        triangle_names.push_back(std::string(default_name));
-                        next_triangle_id++;
+                        scene.duplicate_object(i);
                     }
                     if (ImGui::MenuItem("Delete"))
                     {
@@ -548,10 +723,8 @@ int main(int, char**)
             // Delete the triangle outside the loop to avoid iterator issues
             if (triangle_to_delete >= 0)
             {
-                triangle_ids.erase(triangle_ids.begin() + triangle_to_delete);
-                // Keep names vector in sync
-                if (triangle_to_delete < (int)triangle_names.size())
-                    triangle_names.erase(triangle_names.begin() + triangle_to_delete);
+                // Removes the entry from every parallel vector to keep them in sync
+                scene.remove_object(triangle_to_delete);
                 // If the rename target was after the deleted index, adjust it
                 if (rename_target == triangle_to_delete)
                 {
@@ -561,6 +734,10 @@ int main(int, char**)
                 }
                 else if (rename_target > triangle_to_delete)
                     rename_target--;
+                if (active_object == triangle_to_delete)
+                    active_object = -1;
+                else if (active_object > triangle_to_delete)
+                    active_object--;
             }
 
             ImGui::End();   
@@ -569,6 +746,7 @@ int main(int, char**)
         // CONSOLE
         if (show_console_window)
         {
+            PROFILE_ZONE("Console");
             ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetIO().DisplaySize.y - 500), ImGuiCond_FirstUseEver);
             ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x - 500, 500), ImGuiCond_FirstUseEver);
 
@@ -582,20 +760,91 @@ int main(int, char**)
 
         if (show_inspector_window)
         {
+            PROFILE_ZONE("Inspector");
             ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 500, 30), ImGuiCond_FirstUseEver);
             ImGui::SetNextWindowSize(ImVec2(500, 700), ImGuiCond_FirstUseEver);
 
             ImGui::Begin("Inspector", nullptr, ImGuiWindowFlags_NoCollapse);
-            
 
-            ImGui::Text("This panel is not functional...");  
-            ImGui::End();   
+            int selected_count = (int)std::count(scene.selected.begin(), scene.selected.end(), (unsigned char)1);
+            if (active_object >= 0 && active_object < scene.size())
+            {
+                const int i = active_object;
+                ImGui::Text("%s (id %d)", scene.names[i].c_str(), scene.ids[i]);
+                if (selected_count > 1)
+                    ImGui::TextDisabled("%d objects selected", selected_count);
+                ImGui::Separator();
+
+                // Transform edits have to reach the BVH, so flag the object as moved
+                bool moved = false;
+                moved |= ImGui::DragFloat3("Position", &scene.positions[i].x, 0.01f);
+                moved |= ImGui::DragFloat3("Rotation", &scene.rotations[i].x, 1.0f, -360.0f, 360.0f, "%.1f deg");
+                moved |= ImGui::DragFloat3("Scale", &scene.scales[i].x, 0.01f);
+                ImGui::ColorEdit4("Colour", &scene.colours[i].x);
+                // Static objects do not spin and stay cached in the shadow maps
+                bool is_static = scene.is_static[i] != 0;
+                if (ImGui::Checkbox("Static", &is_static))
+                    scene.set_static(i, is_static);
+
+                const char* mesh_name = scene_renderer.meshes[scene.mesh_ids[i]].name.c_str();
+                if (ImGui::BeginCombo("Mesh", mesh_name))
+                {
+                    for (int m = 0; m < (int)scene_renderer.meshes.size(); m++)
+                    {
+                        ImGui::PushID(m);
+                        if (ImGui::Selectable(scene_renderer.meshes[m].name.c_str(), m == scene.mesh_ids[i]) && m != scene.mesh_ids[i])
+                        {
+                            scene.mesh_ids[i] = m;
+                            moved = true;
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::EndCombo();
+                }
+                if (moved)
+                    scene.mark_moved(i);
+
+                const TextureStreamer& streamer = scene_renderer.textures;
+                const int texture = scene.texture_ids[i];
+                if (ImGui::BeginCombo("Texture", texture >= 0 ? streamer.textures[texture].name.c_str() : "None"))
+                {
+                    if (ImGui::Selectable("None", texture < 0))
+                        scene.texture_ids[i] = -1;
+                    for (int t = 0; t < (int)streamer.textures.size(); t++)
+                    {
+                        ImGui::PushID(t);
+                        if (ImGui::Selectable(streamer.textures[t].name.c_str(), t == texture))
+                            scene.texture_ids[i] = t;
+                        ImGui::PopID();
+                    }
+                    ImGui::EndCombo();
+                }
+
+                const Mesh& mesh = scene_renderer.meshes[scene.mesh_ids[i]];
+                ImGui::SeparatorText("Mesh");
+                ImGui::Text("%d vertices, %d triangles, %d LODs", mesh.vertex_count, mesh.index_count / 3, (int)mesh.lods.size() - 1);
+                ImGui::Text("Vertex format: %d bytes/vertex, %.1f KB", (int)mesh.format.stride(), mesh.vertex_bytes / 1024.0f);
+                if (mesh.source_cache.acmr > 0.0f)
+                    ImGui::Text("ACMR %.3f -> %.3f | ATVR %.3f -> %.3f", mesh.source_cache.acmr, mesh.cache.acmr, mesh.source_cache.atvr, mesh.cache.atvr);
+                else
+                    ImGui::Text("ACMR %.3f | ATVR %.3f", mesh.cache.acmr, mesh.cache.atvr);
+            }
+            else if (selected_count > 0)
+            {
+                ImGui::Text("%d objects selected", selected_count);
+            }
+            else
+            {
+                ImGui::TextDisabled("Nothing selected: click an object in the viewport or the hierarchy");
+            }
+            ImGui::End();
         } 
 
         // PROPERTIES WINDOW
 
         if (show_properties_window)
         {
+            PROFILE_ZONE("Properties");
             ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 500, 730), ImGuiCond_FirstUseEver);
             ImGui::SetNextWindowSize(ImVec2(500, ImGui::GetIO().DisplaySize.y - 530), ImGuiCond_FirstUseEver);
 
@@ -606,10 +855,228 @@ int main(int, char**)
             ImGui::End();   
         }
 
+        // TEXTURE STREAMING WINDOW
+
+        if (show_texture_streaming_window)
+        {
+            PROFILE_ZONE("Texture Streaming");
+            ImGui::Begin("Texture Streaming", nullptr, ImGuiWindowFlags_NoCollapse);
+            TextureStreamer& streamer = scene_renderer.textures;
+            const TextureStreamer::Stats& texture_stats = streamer.stats;
+            const double mb = 1.0 / (1024.0 * 1024.0);
+
+            int budget_mb = (int)(streamer.budget_bytes >> 20);
+            if (ImGui::SliderInt("GPU Budget", &budget_mb, 16, 4096, "%d MB"))
+                streamer.budget_bytes = (size_t)budget_mb << 20;
+            int upload_mb = (int)(streamer.upload_budget >> 20);
+            if (ImGui::SliderInt("Upload / Frame", &upload_mb, 1, 256, "%d MB"))
+                streamer.upload_budget = (size_t)upload_mb << 20;
+            ImGui::Checkbox("Stream", &streamer.streaming);
+            if (ImGui::BeginCombo("Import Format", texture_format_name(texture_import_format)))
+            {
+                for (int f = 0; f < TEXTURE_FORMAT_COUNT; f++)
+                {
+                    const TextureFormat format = (TextureFormat)f;
+                    const ImGuiSelectableFlags flags = texture_format_supported(format) ? 0 : ImGuiSelectableFlags_Disabled;
+                    if (ImGui::Selectable(texture_format_name(format), format == texture_import_format, flags))
+                        texture_import_format = format;
+                }
+                ImGui::EndCombo();
+            }
+
+            ImGui::Text("Resident: %.1f MB of %.1f MB budget", texture_stats.resident_bytes * mb, streamer.budget_bytes * mb);
+            ImGui::Text("Requested: %.1f MB | All levels: %.1f MB", texture_stats.requested_bytes * mb, texture_stats.full_bytes * mb);
+            ImGui::Text("Textures: %d (%d in view) | %d loads pending | %d held back by the budget",
+                        texture_stats.textures, texture_stats.visible_textures, texture_stats.pending_loads, texture_stats.budget_limited);
+            ImGui::Text("This frame: %d uploads (%.1f MB), %d evictions | %.2f ms",
+                        texture_stats.uploads, texture_stats.upload_bytes * mb, texture_stats.evictions, texture_stats.update_ms);
+            ImGui::Checkbox("Pool Small Textures", &streamer.pooling);
+            ImGui::SameLine();
+            ImGui::Text("%d pooled on %d pages (%.1f MB)", texture_stats.pooled_textures, (int)streamer.pool.pages.size(), streamer.pool.bytes * mb);
+            const TextureCache::Stats& cache_stats = texture_cache.stats;
+            ImGui::Text("Imported: %d (%d from cache, %d encoded in %.0f ms) | %.1f MB -> %.1f MB",
+                        cache_stats.imported, cache_stats.cache_hits, cache_stats.encoded, cache_stats.encode_ms,
+                        cache_stats.source_bytes * mb, cache_stats.encoded_bytes * mb);
+
+            // Per texture: finest level resident vs wanted, as level sizes
+            if (ImGui::BeginTable("Textures", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Texture");
+                ImGui::TableSetupColumn("Format");
+                ImGui::TableSetupColumn("Resident");
+                ImGui::TableSetupColumn("Wanted");
+                ImGui::TableSetupColumn("MB");
+                ImGui::TableHeadersRow();
+                ImGuiListClipper clipper;
+                clipper.Begin((int)streamer.textures.size());
+                while (clipper.Step())
+                {
+                    for (int t = clipper.DisplayStart; t < clipper.DisplayEnd; t++)
+                    {
+                        const TextureStreamer::Texture& texture = streamer.textures[t];
+                        size_t bytes = 0;
+                        for (int level = texture.resident_level; level < texture.levels; level++)
+                            bytes += TextureStreamer::level_bytes(texture.format, texture.size, level);
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(texture.name.c_str());
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(texture_format_name(texture.format));
+                        ImGui::TableNextColumn();
+                        if (texture.slot.page >= 0)
+                        {
+                            // Pooled: always whole, its memory is counted with the page
+                            ImGui::Text("page %d/%d", texture.slot.page, texture.slot.layer);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%d", texture.size);
+                            ImGui::TableNextColumn();
+                            ImGui::TextUnformatted("-");
+                            continue;
+                        }
+                        ImGui::Text("%d%s", texture.size >> texture.resident_level, texture.loading_level >= 0 ? " (loading)" : "");
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%d", texture.size >> texture.wanted_level);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.2f", bytes * mb);
+                    }
+                }
+                ImGui::EndTable();
+            }
+            ImGui::End();
+        }
+
+        // CPU PROFILER WINDOW: frame times, one frame's zones as a flame graph, and per-zone totals
+
+        if (show_cpu_profiler_window)
+        {
+            PROFILE_ZONE("CPU Profiler");
+            ImGui::Begin("CPU Profiler", nullptr, ImGuiWindowFlags_NoCollapse);
+            CpuProfiler& profiler = cpu_profiler();
+            bool recording = CpuProfiler::is_enabled();
+            if (ImGui::Checkbox("Record", &recording))
+                CpuProfiler::set_enabled(recording);
+            ImGui::SameLine();
+            if (ImGui::Checkbox("Pause", &profiler.paused) && !profiler.paused)
+                profiler_selected_age = 0;
+            ImGui::SameLine();
+            ImGui::Text("%d frames | %d zones dropped", profiler.frame_count(), profiler.dropped_zones);
+
+            const int frame_count = profiler.frame_count();
+            if (frame_count > 0)
+            {
+                // Oldest first; clicking a bar pauses on that frame
+                float frame_ms[CpuProfiler::history_frames];
+                for (int i = 0; i < frame_count; i++)
+                {
+                    const CpuProfiler::Frame& frame = profiler.frame(frame_count - 1 - i);
+                    frame_ms[i] = (float)((frame.end_ns - frame.start_ns) / 1.0e6);
+                }
+                profiler_selected_age = std::min(profiler_selected_age, frame_count - 1);
+                char overlay[48];
+                snprintf(overlay, sizeof(overlay), "Frame %.2f ms", frame_ms[frame_count - 1 - profiler_selected_age]);
+                ImGui::PlotHistogram("##FrameTimes", frame_ms, frame_count, 0, overlay, 0.0f, 33.3f, ImVec2(-1.0f, 60.0f));
+                if (ImGui::IsItemClicked())
+                {
+                    const float x = (ImGui::GetIO().MousePos.x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x;
+                    profiler_selected_age = frame_count - 1 - std::min(std::max((int)(x * frame_count), 0), frame_count - 1);
+                    profiler.paused = true;
+                }
+
+                // Flame graph: a band per thread, a row per nesting depth, time left to right
+                const CpuProfiler::Frame& frame = profiler.frame(profiler_selected_age);
+                const double frame_ns = (double)std::max<int64_t>(frame.end_ns - frame.start_ns, 1);
+                const float row_height = ImGui::GetTextLineHeight() + 2.0f;
+                ImDrawList* draw_list = ImGui::GetWindowDrawList();
+                const float width = ImGui::GetContentRegionAvail().x;
+                for (size_t first = 0; first < frame.zones.size();)
+                {
+                    const int thread = frame.zones[first].thread;
+                    size_t last = first;
+                    int rows = 1;
+                    while (last < frame.zones.size() && frame.zones[last].thread == thread)
+                        rows = std::max(rows, frame.zones[last++].depth + 1);
+
+                    ImGui::TextDisabled("%s", profiler.thread_name(thread));
+                    const ImVec2 origin = ImGui::GetCursorScreenPos();
+                    ImGui::InvisibleButton(profiler.thread_name(thread), ImVec2(width, rows * row_height));
+                    const bool hovered = ImGui::IsItemHovered();
+                    const ImVec2 mouse = ImGui::GetIO().MousePos;
+                    draw_list->PushClipRect(origin, ImVec2(origin.x + width, origin.y + rows * row_height), true);
+                    for (size_t z = first; z < last; z++)
+                    {
+                        const CpuProfiler::Zone& zone = frame.zones[z];
+                        const float x0 = origin.x + (float)((zone.start_ns - frame.start_ns) / frame_ns) * width;
+                        const float x1 = std::max(origin.x + (float)((zone.end_ns - frame.start_ns) / frame_ns) * width, x0 + 1.0f);
+                        const float y0 = origin.y + zone.depth * row_height;
+                        const ImVec2 min(x0, y0), max(x1, y0 + row_height - 1.0f);
+                        const float hue = (float)(hash_bytes(zone.name, strlen(zone.name)) % 1000) / 1000.0f;
+                        draw_list->AddRectFilled(min, max, ImColor::HSV(hue, 0.45f, 0.65f));
+                        if (x1 - x0 > ImGui::CalcTextSize(zone.name).x + 4.0f)
+                            draw_list->AddText(ImVec2(x0 + 2.0f, y0 + 1.0f), IM_COL32(255, 255, 255, 255), zone.name);
+                        if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+                            ImGui::SetTooltip("%s\n%.3f ms", zone.name, (zone.end_ns - zone.start_ns) / 1.0e6);
+                    }
+                    draw_list->PopClipRect();
+                    first = last;
+                }
+
+                // Per zone over the whole history: calls and inclusive time per frame, longest single call
+                struct ZoneTotals
+                {
+                    const char* name;
+                    int calls;
+                    double total_ms;
+                    double max_ms;
+                };
+                std::vector<ZoneTotals> totals;
+                std::unordered_map<const char*, size_t> zone_rows;     // By name pointer: one row per PROFILE_ZONE site
+                for (int age = 0; age < frame_count; age++)
+                {
+                    for (const CpuProfiler::Zone& zone : profiler.frame(age).zones)
+                    {
+                        auto row = zone_rows.emplace(zone.name, totals.size());
+                        if (row.second)
+                            totals.push_back({ zone.name, 0, 0.0, 0.0 });
+                        ZoneTotals& t = totals[row.first->second];
+                        const double ms = (zone.end_ns - zone.start_ns) / 1.0e6;
+                        t.calls++;
+                        t.total_ms += ms;
+                        t.max_ms = std::max(t.max_ms, ms);
+                    }
+                }
+                std::sort(totals.begin(), totals.end(), [](const ZoneTotals& a, const ZoneTotals& b) { return a.total_ms > b.total_ms; });
+                if (ImGui::BeginTable("Zones", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV))
+                {
+                    ImGui::TableSetupScrollFreeze(0, 1);
+                    ImGui::TableSetupColumn("Zone");
+                    ImGui::TableSetupColumn("Calls / frame");
+                    ImGui::TableSetupColumn("ms / frame");
+                    ImGui::TableSetupColumn("Max ms");
+                    ImGui::TableHeadersRow();
+                    for (const ZoneTotals& t : totals)
+                    {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(t.name);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", (double)t.calls / frame_count);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", t.total_ms / frame_count);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", t.max_ms);
+                    }
+                    ImGui::EndTable();
+                }
+            }
+            ImGui::End();
+        }
+
         // VIEWPORT TOOLBAR
 
         if (show_viewport_toolbar_window)
         {
+            PROFILE_ZONE("Viewport Toolbar");
             ImGui::Begin("Viewport Toolbar", nullptr,
                         ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoScrollbar);
 
@@ -624,6 +1091,70 @@ int main(int, char**)
             {
                 viewport_wireframe = false;
             }
+
+            ImGui::SameLine();
+            {
+                const char* paths[] = { "Forward", "Deferred" };
+                int path = (int)scene_renderer.path;
+                ImGui::SetNextItemWidth(100.0f);
+                if (ImGui::Combo("##Path", &path, paths, IM_ARRAYSIZE(paths)))
+                    scene_renderer.path = (RenderPath)path;
+            }
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Instancing", &viewport_instancing);
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Texture Batching", &viewport_texture_batching);
+
+            ImGui::SameLine();
+            {
+                const char* cull_modes[] = { "No Culling", "Sphere Culling", "BVH Culling" };
+                int cull_mode = (int)scene_renderer.cull_mode;
+                ImGui::SetNextItemWidth(130.0f);
+                if (ImGui::Combo("##Culling", &cull_mode, cull_modes, IM_ARRAYSIZE(cull_modes)))
+                    scene_renderer.cull_mode = (CullMode)cull_mode;
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("Occlusion Culling", &scene_renderer.occlusion_culling);
+            ImGui::SameLine();
+            ImGui::Checkbox("Depth Test", &scene_renderer.depth_test);
+            ImGui::SameLine();
+            ImGui::Checkbox("Depth Pre-pass", &scene_renderer.depth_prepass);
+            ImGui::SameLine();
+            ImGui::Checkbox("Front-to-Back", &scene_renderer.front_to_back);
+            ImGui::SameLine();
+            ImGui::Checkbox("Overdraw View", &scene_renderer.overdraw_view);
+
+            ImGui::SameLine();
+            ImGui::Checkbox("LOD", &scene_renderer.lod_enabled);
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(100.0f);
+            ImGui::SliderFloat("LOD Error", &scene_renderer.lod_pixel_error, 0.25f, 8.0f, "%.2f px");
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Clustered Lights", &scene_renderer.lights.clustered);
+            ImGui::SameLine();
+            ImGui::Checkbox("Light Heat View", &scene_renderer.light_heat_view);
+            ImGui::SameLine();
+            ImGui::Checkbox("Animate Lights", &animate_lights);
+            ImGui::SameLine();
+            ImGui::Checkbox("Sun", &scene.sun.enabled);
+            ImGui::SameLine();
+            ImGui::Checkbox("Shadows", &scene_renderer.shadows.enabled);
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Dynamic Resolution", &dynamic_resolution.enabled);
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(120.0f);
+            if (dynamic_resolution.enabled)
+                ImGui::SliderFloat("GPU Budget", &dynamic_resolution.budget_ms, 1.0f, 33.0f, "%.1f ms");
+            else
+                ImGui::SliderFloat("Render Scale", &dynamic_resolution.scale, dynamic_resolution.min_scale, dynamic_resolution.max_scale, "%.2f");
+            ImGui::SameLine();
+            ImGui::Checkbox("Sharpen", &dynamic_resolution.sharpen);
+            ImGui::SameLine();
+            ImGui::Text("Scale: %d%% | Viewport GPU: %.2f ms", (int)(dynamic_resolution.scale * 100.0f + 0.5f), dynamic_resolution.gpu_ms);
             
             ImGui::End();
         }
@@ -633,6 +1164,7 @@ int main(int, char**)
         // VIEWPORT WINDOW
         if (show_viewport_window)
         {
+            PROFILE_ZONE("Viewport");
             ImGui::Begin("Viewport", nullptr,
                         ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoCollapse);
             
@@ -643,7 +1175,98 @@ int main(int, char**)
             // Debug info to see what's happening
             ImGui::Text("Canvas pos: %.1f, %.1f", canvas_pos.x, canvas_pos.y);
             ImGui::Text("Canvas size: %.1f x %.1f", canvas_size.x, canvas_size.y);
-            ImGui::Text("Triangle count: %d", (int)triangle_ids.size());
+            ImGui::Text("Triangle count: %d", scene.size());
+            const RenderStats& render_stats = scene_renderer.stats;
+            ImGui::Text("Draw calls: %d (%d instances, %d texture binds) | Scene CPU: %.2f ms (sort %.2f ms) | Frame: %.2f ms",
+                        render_stats.draw_calls, render_stats.instances, render_stats.material_binds, render_stats.scene_cpu_ms, render_stats.sort_ms,
+                        1000.0f / ImGui::GetIO().Framerate);
+            {
+                size_t vertex_bytes = 0;
+                for (const Mesh& mesh : scene_renderer.meshes)
+                    vertex_bytes += mesh.vertex_bytes;
+                ImGui::Text("Vertex memory: %.1f KB across %d meshes", vertex_bytes / 1024.0f, (int)scene_renderer.meshes.size());
+            }
+            {
+                // GPU time is what the pass costs to execute, CPU time what it costs to issue
+                GpuProfiler& profiler = gpu_profiler();
+                if (ImGui::TreeNode("GPU Passes", "GPU passes: %.2f ms (%d frames late, %d dropped)",
+                                    profiler.frame_gpu_ms, profiler.latency, profiler.dropped_frames))
+                {
+                    ImGui::Checkbox("Profile", &profiler.enabled);
+                    if (ImGui::BeginTable("GPU Passes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingFixedFit))
+                    {
+                        ImGui::TableSetupColumn("Pass");
+                        ImGui::TableSetupColumn("GPU ms");
+                        ImGui::TableSetupColumn("CPU ms");
+                        ImGui::TableHeadersRow();
+                        for (const GpuProfiler::PassTiming& pass : profiler.passes)
+                        {
+                            ImGui::TableNextRow();
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%*s%s", pass.depth * 2, "", pass.name);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%.3f", pass.gpu_ms);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%.3f", pass.cpu_ms);
+                        }
+                        ImGui::EndTable();
+                    }
+                    ImGui::TreePop();
+                }
+            }
+            ImGui::Text("Triangles: %lld | Objects per LOD: %d / %d / %d / %d", render_stats.triangles,
+                        render_stats.lod_objects[0], render_stats.lod_objects[1], render_stats.lod_objects[2], render_stats.lod_objects[3]);
+            ImGui::Text("Frustum culling: %d culled in %.2f ms (%s)", render_stats.culled, render_stats.cull_ms,
+                        scene_renderer.cull_mode == CULL_BVH ? "BVH" : cull_kernel_name(cull_kernel()));
+            ImGui::Text("BVH: %d nodes, SAH %.1f (%.1f at build) | last build %.2f ms, %d rebuilds, %d refits, %d inserts",
+                        scene_bvh.bvh.node_count(), scene_bvh.bvh.sah_cost(), scene_bvh.bvh.build_cost, scene_bvh.stats.build_ms,
+                        scene_bvh.stats.rebuilds, scene_bvh.stats.refits, scene_bvh.stats.inserts);
+            {
+                const LightClusters& clusters = scene_renderer.lights;
+                ImGui::Text("Lights: %d (%d visible) | %d clusters, %d light refs, max %d per cluster%s | bin %.2f ms, upload %.2f ms",
+                            clusters.stats.lights, clusters.stats.visible_lights, clusters.stats.clusters, clusters.stats.indices,
+                            clusters.stats.max_cluster_lights, clusters.stats.dropped > 0 ? " (truncated)" : "",
+                            clusters.stats.assign_ms, clusters.stats.upload_ms);
+            }
+            {
+                // A still scene should show no passes; moving objects cost a copy per view they touch
+                const ShadowMaps& shadows = scene_renderer.shadows;
+                ImGui::Text("Shadows: %d static redraws (%d casters), %d dynamic passes (%d casters) | %d lights shadowed%s | %.2f ms | %.1f MB",
+                            shadows.stats.static_passes, shadows.stats.static_casters, shadows.stats.dynamic_passes, shadows.stats.dynamic_casters,
+                            shadows.stats.shadowed_lights, shadows.stats.dropped_lights > 0 ? " (atlas full)" : "",
+                            shadows.stats.prepare_ms, shadows.bytes() / (1024.0 * 1024.0));
+            }
+            ImGui::Text("GL state calls: %d issued, %d elided", gl_state_stats.issued, gl_state_stats.elided);
+            ImGui::Text("Overdraw: %.2fx (%.0f fragments shaded)%s", scene_renderer.overdraw, scene_renderer.shaded_samples,
+                        scene_renderer.depth_prepass && scene_renderer.depth_test ? ", after depth pre-pass" : "");
+            if (scene_renderer.prepass_lost_opaque)
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Depth pre-pass: no opaque fragment passed the shading pass's depth test");
+            {
+                // Forward and deferred on the same scene: compare these with the viewport GPU time in the toolbar
+                const double target_bytes = (double)scene_target.alloc_width * scene_target.alloc_height * (4 + 4);
+                const bool deferred = scene_renderer.deferred_active;
+                ImGui::Text("Path: %s | Target %.1f MB + G-buffer %.1f MB | Est. framebuffer traffic %.1f MB/frame",
+                            deferred ? "Deferred" : "Forward", target_bytes / (1024.0 * 1024.0),
+                            deferred ? scene_renderer.gbuffer.bytes() / (1024.0 * 1024.0) : 0.0,
+                            scene_renderer.framebuffer_bytes / (1024.0 * 1024.0));
+            }
+            {
+                const StreamBuffer& stream = scene_renderer.instance_buffer.stream;
+                const StreamBuffer::Stats& stream_stats = stream.stats();
+                ImGui::Text("Instance stream: %s, %.1f KB/frame, %d fence waits",
+                            stream.is_persistent() ? "persistent mapped" : "orphaned",
+                            stream_stats.bytes_written / 1024.0f, stream_stats.fence_waits);
+            }
+            {
+                const ShaderManager::Stats& shader_stats = shader_manager.stats();
+                ImGui::Text("Startup: %.1f ms | Shaders: %.1f ms, %d programs (%d cached, %d compiled, %d pending)%s%s",
+                            startup_ms, shader_stats.load_ms, shader_stats.programs, shader_stats.binary_cache_hits, shader_stats.compiled,
+                            shader_stats.pending, shader_manager.parallel_compile_enabled() ? "" : ", serial compile",
+                            shader_manager.binary_cache_enabled() ? "" : ", binary cache unsupported");
+            }
+            ImGui::Text("Scene target: %d x %d (pool %d x %d, %d reallocations)%s",
+                        scene_target.width, scene_target.height, scene_target.alloc_width, scene_target.alloc_height,
+                        scene_target.reallocations + viewport_target.reallocations, viewport_upscaled ? ", upscaled" : "");
             
             // Adjust canvas size to account for debug text
             canvas_size = ImGui::GetContentRegionAvail();
@@ -651,15 +1274,111 @@ int main(int, char**)
             // Use the remaining content region for the OpenGL canvas
             if (canvas_size.x > 0 && canvas_size.y > 0)
             {
-                // Add a colored rectangle to visualize the canvas area
-                ImDrawList* draw_list = ImGui::GetWindowDrawList();
-                ImVec2 canvas_end = ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y);
-                draw_list->AddRectFilled(canvas_pos, canvas_end, IM_COL32(50, 50, 50, 255));
-                draw_list->AddRect(canvas_pos, canvas_end, IM_COL32(255, 255, 255, 255));
-                
-                // Reserve the entire content space for OpenGL rendering
-                ImGui::InvisibleButton("opengl_canvas", canvas_size);
-                
+                // Size the offscreen target now, before its texture goes into this frame's draw list
+                ImVec2 framebuffer_scale = ImGui::GetIO().DisplayFramebufferScale;
+                int canvas_w = (int)(canvas_size.x * framebuffer_scale.x);
+                int canvas_h = (int)(canvas_size.y * framebuffer_scale.y);
+                int render_w = (int)(canvas_w * dynamic_resolution.scale + 0.5f);
+                int render_h = (int)(canvas_h * dynamic_resolution.scale + 0.5f);
+                scene_target.resize(render_w > 1 ? render_w : 1, render_h > 1 ? render_h : 1);
+                viewport_upscaled = scene_target.width != canvas_w || scene_target.height != canvas_h;
+                if (viewport_upscaled)
+                    viewport_target.resize(canvas_w, canvas_h);
+                const RenderTarget& shown = viewport_upscaled ? viewport_target : scene_target;
+
+                scene_view.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f));
+                float aspect = (float)scene_target.width / (float)scene_target.height;
+                scene_view.projection = glm::perspective(glm::radians(45.0f), aspect, scene_view.near_plane, scene_view.far_plane);
+                scene_view.width = scene_target.width;
+                scene_view.height = scene_target.height;
+                scene_view.time = (float)glfwGetTime();
+
+                // The scene is drawn into the lower-left of the pooled texture; flip V for GL's origin
+                ImGui::Image((ImTextureID)(intptr_t)shown.colour_texture, canvas_size,
+                             ImVec2(0.0f, shown.v_max()), ImVec2(shown.u_max(), 0.0f));
+
+                // SELECTION: click to pick, drag to marquee select; Ctrl adds to the selection
+                ImGuiIO& selection_io = ImGui::GetIO();
+                if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+                {
+                    marquee_active = true;
+                    marquee_start = selection_io.MousePos;
+                }
+                if (marquee_active)
+                {
+                    ImVec2 canvas_max = ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y);
+                    ImVec2 marquee_end = ImVec2(glm::clamp(selection_io.MousePos.x, canvas_pos.x, canvas_max.x),
+                                                glm::clamp(selection_io.MousePos.y, canvas_pos.y, canvas_max.y));
+                    bool dragged = fabsf(marquee_end.x - marquee_start.x) > 4.0f || fabsf(marquee_end.y - marquee_start.y) > 4.0f;
+                    if (dragged)
+                    {
+                        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+                        draw_list->AddRectFilled(marquee_start, marquee_end, IM_COL32(90, 150, 255, 40));
+                        draw_list->AddRect(marquee_start, marquee_end, IM_COL32(90, 150, 255, 200));
+                    }
+
+                    if (ImGui::IsMouseReleased(ImGuiMouseButton_Left))
+                    {
+                        marquee_active = false;
+                        scene_bvh.sync(scene, scene_renderer.meshes);
+                        const glm::mat4 view_projection = scene_view.projection * scene_view.view;
+                        auto to_ndc = [&](ImVec2 p)
+                        {
+                            return glm::vec2((p.x - canvas_pos.x) / canvas_size.x * 2.0f - 1.0f,
+                                             1.0f - (p.y - canvas_pos.y) / canvas_size.y * 2.0f);
+                        };
+                        if (!selection_io.KeyCtrl)
+                            scene.clear_selection();
+
+                        if (dragged)
+                        {
+                            glm::vec2 a = to_ndc(marquee_start), b = to_ndc(marquee_end);
+                            std::vector<uint32_t> hits;
+                            scene_bvh.select(sub_frustum(view_projection, glm::min(a, b), glm::max(a, b)), hits);
+                            for (uint32_t i : hits)
+                                scene.selected[i] = 1;
+                            if (!hits.empty())
+                                active_object = (int)hits[0];
+                        }
+                        else
+                        {
+                            // Unproject the click onto the near and far planes
+                            glm::vec2 ndc = to_ndc(marquee_end);
+                            glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+                            glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc, -1.0f, 1.0f);
+                            glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+                            glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+                            glm::vec3 direction = glm::vec3(far_point) / far_point.w - origin;
+                            float hit_t = 0.0f;
+                            int hit = scene_bvh.pick(scene, scene_renderer.meshes, spin, origin, direction, hit_t);
+                            if (hit >= 0)
+                                scene.selected[hit] = selection_io.KeyCtrl ? !scene.selected[hit] : 1;
+                            active_object = hit;
+                        }
+                    }
+                }
+
+                // Occlusion overlay in the corner of the image
+                if (scene_renderer.occlusion_culling)
+                {
+                    const OcclusionCuller& occlusion = scene_renderer.occlusion;
+                    char overlay[160];
+                    if (!scene_renderer.depth_test)
+                        snprintf(overlay, sizeof(overlay), "Occlusion culling needs the depth test");
+                    else if (!occlusion.ready())
+                        snprintf(overlay, sizeof(overlay), "Occlusion culling: waiting for Hi-Z");
+                    else
+                        snprintf(overlay, sizeof(overlay), "Occluded: %d of %d | %.2f ms | Hi-Z %dx%d, %d levels, %d frames old",
+                                 render_stats.occluded, scene.size() - render_stats.culled, render_stats.occlusion_ms,
+                                 occlusion.levels[0].width, occlusion.levels[0].height, (int)occlusion.levels.size(), occlusion.frames_old);
+                    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+                    ImVec2 text_pos = ImVec2(canvas_pos.x + 8.0f, canvas_pos.y + 8.0f);
+                    ImVec2 text_size = ImGui::CalcTextSize(overlay);
+                    draw_list->AddRectFilled(ImVec2(text_pos.x - 4.0f, text_pos.y - 2.0f),
+                                             ImVec2(text_pos.x + text_size.x + 4.0f, text_pos.y + text_size.y + 2.0f), IM_COL32(0, 0, 0, 160));
+                    draw_list->AddText(text_pos, IM_COL32(255, 200, 80, 255), overlay);
+                }
+
                 // Store viewport information for later OpenGL rendering (outside ImGui pass)
                 viewport_canvas_pos = canvas_pos;
                 viewport_canvas_size = canvas_size;
@@ -679,6 +1398,7 @@ int main(int, char**)
     // Open any deferred popups at the root ID stack
     if (open_about_popup) { ImGui::OpenPopup("About AeroSLR"); open_about_popup = false; }
     if (open_rename_popup) { ImGui::OpenPopup("Rename Triangle"); open_rename_popup = false; }
+    if (open_import_popup) { ImGui::OpenPopup("Import Mesh"); open_import_popup = false; import_error.clear(); }
         
         // ABOUT WINDOW
         if (ImGui::BeginPopupModal("About AeroSLR", NULL, ImGuiWindowFlags_AlwaysAutoResize))
@@ -714,9 +1434,9 @@ int main(int, char**)
             
             if (ImGui::Button("OK") || ImGui::IsKeyPressed(ImGuiKey_Enter))
             {
-                if (rename_target >= 0 && rename_target < (int)triangle_names.size())
+                if (rename_target >= 0 && rename_target < scene.size())
                 {
-                    triangle_names[rename_target] = std::string(rename_buf);
+                    scene.names[rename_target] = std::string(rename_buf);
                 }
                 rename_target = -1;
                 ImGui::CloseCurrentPopup();
@@ -730,99 +1450,149 @@ int main(int, char**)
             ImGui::EndPopup();
         }
 
-        // PREPARE RENDERING - Set up framebuffer before any rendering
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        
-        // Clear the entire framebuffer first
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // RENDER IMGUI FIRST to create the UI layout
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        // RENDER OPENGL TRIANGLES AFTER IMGUI (in a specific scissor area)
-        if (show_viewport_window && viewport_canvas_size.x > 0 && viewport_canvas_size.y > 0)
+        // IMPORT MESH WINDOW
+        if (ImGui::BeginPopupModal("Import Mesh", NULL, ImGuiWindowFlags_AlwaysAutoResize))
         {
-            ImVec2 canvas_pos = viewport_canvas_pos;
-            ImVec2 canvas_size = viewport_canvas_size;
-
-            // Convert ImGui screen-space (top-left origin) to OpenGL framebuffer coords (bottom-left origin)
-            float scale_x = (float)display_w / ImGui::GetIO().DisplaySize.x;
-            float scale_y = (float)display_h / ImGui::GetIO().DisplaySize.y;
-
-            const ImVec2 main_vp_pos = ImGui::GetMainViewport()->Pos;
-            int opengl_viewport_x = (int)((canvas_pos.x - main_vp_pos.x) * scale_x);
-            int opengl_viewport_y = (int)((display_h - ((canvas_pos.y - main_vp_pos.y) + canvas_size.y) * scale_y));
-            int opengl_viewport_w = (int)(canvas_size.x * scale_x);
-            int opengl_viewport_h = (int)(canvas_size.y * scale_y);
-            
-            // Ensure viewport dimensions are positive and reasonable
-            if (opengl_viewport_w > 0 && opengl_viewport_h > 0 && 
-                opengl_viewport_x >= 0 && opengl_viewport_y >= 0 &&
-                opengl_viewport_x < display_w && opengl_viewport_y < display_h)
-            {
-                // Set viewport and scissor test to limit rendering to our canvas area
-                glViewport(opengl_viewport_x, opengl_viewport_y, opengl_viewport_w, opengl_viewport_h);
-                glEnable(GL_SCISSOR_TEST);
-                glScissor(opengl_viewport_x, opengl_viewport_y, opengl_viewport_w, opengl_viewport_h);
-                
-                // Clear only our canvas area with a dark background
-                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-                glClear(GL_COLOR_BUFFER_BIT);
-                
-                glDisable(GL_DEPTH_TEST);
-                glDisable(GL_CULL_FACE);
-                
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.0f, 0.0f, 0.3f));
-
-                glm::mat4 view = glm::mat4(1.0f);
-                view = glm::translate(view, glm::vec3(0.0f, 0.0f, -2.0f));
+            ImGui::Text("OBJ file path:");
+            ImGui::Separator();
 
-                glm::mat4 projection;
-                float aspect = (float)opengl_viewport_w / (float)opengl_viewport_h;
-                projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+            if (ImGui::IsWindowAppearing())
+                ImGui::SetKeyboardFocusHere();
 
-                // Upload matrices to the shader (ensure program is bound)
-                glUseProgram(shaderProgram);
-                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-                glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            ImGui::InputText("##ImportPath", import_path_buf, sizeof(import_path_buf));
+            {
+                // Applies to meshes uploaded from now on
+                const char* formats[] = { "Full (32 B/vertex)", "Compact (16 B/vertex)", "Compact, unorm16 UVs (16 B/vertex)" };
+                VertexFormat& format = scene_renderer.vertex_format;
+                int selected = format.position == VERTEX_POSITION_FLOAT ? 0 : (format.uv == VERTEX_UV_UNORM16 ? 2 : 1);
+                if (ImGui::Combo("Vertex format", &selected, formats, IM_ARRAYSIZE(formats)))
+                {
+                    format = selected == 0 ? VertexFormat::full() : VertexFormat::compact();
+                    if (selected == 2)
+                        format.uv = VERTEX_UV_UNORM16;
+                }
+            }
+            if (!import_error.empty())
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", import_error.c_str());
+            ImGui::Separator();
 
-                for (int i = 0; i < triangle_ids.size(); i++)
+            if (ImGui::Button("Import") || ImGui::IsKeyPressed(ImGuiKey_Enter))
+            {
+                MeshData data;
+                MeshOptimizeReport report;
+                if (import_obj_mesh(import_path_buf, data, import_error, &report))
                 {
-                    glBindVertexArray(VAO);
-                    if (viewport_wireframe)
-                    {
-                        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                    }
-                    else 
-                    {
-                        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                    }
-                    glDrawArrays(GL_TRIANGLES, 0, 6);
-                    glBindVertexArray(0);
+                    printf("Imported %s: %zu vertices, %zu triangles, %zu LODs | ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%d clusters, %.1f ms)\n",
+                           import_path_buf, data.vertices.size(), data.indices.size() / 3, data.lods.size(),
+                           report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, report.clusters, report.ms);
+                    int mesh_id = scene_renderer.add_mesh(data);
+                    scene.add_object("Mesh", mesh_id);
+                    ImGui::CloseCurrentPopup();
                 }
-                
-                // Disable scissor test and restore full viewport
-                glDisable(GL_SCISSOR_TEST);
-                glViewport(0, 0, display_w, display_h);
             }
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel") || ImGui::IsKeyPressed(ImGuiKey_Escape))
+                ImGui::CloseCurrentPopup();
+            ImGui::EndPopup();
+        }
+
+        // PREPARE RENDERING
+        int display_w, display_h;
+        glfwGetFramebufferSize(window, &display_w, &display_h);
+        {
+            PROFILE_ZONE("ImGui::Render");
+            ImGui::Render();
+        }
+
+        // RENDER THE SCENE into the viewport's offscreen target; the draw list built above
+        // already references its colour texture, so it just has to be filled before ImGui draws
+        gl_state().begin_frame();
+        gpu_profiler().begin_frame();
+        // Pick up this frame's edits before the BVH is used for culling
+        {
+            PROFILE_ZONE("BVH Sync");
+            scene_bvh.sync(scene, scene_renderer.meshes);
+        }
+        if (show_viewport_window && viewport_canvas_size.x > 0 && viewport_canvas_size.y > 0 && scene_target.width > 0)
+        {
+            PROFILE_ZONE("Scene Render");
+            dynamic_resolution.begin_gpu_timer();
+            gpu_profiler().begin_pass("Scene");
+            scene_target.bind();
+            gl_state().set_scissor_test(false);
+            gl_state().depth_mask(true);
+            // The heat view accumulates additively, so it needs a black background
+            float background = scene_renderer.overdraw_view ? 0.0f : 0.1f;
+            glClearColor(background, background, background, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Depth and blend state is set per pass by the scene renderer
+            gl_state().set_cull_face(false);
+
+            scene_renderer.instancing = viewport_instancing;
+            scene_renderer.texture_batching = viewport_texture_batching;
+            scene_renderer.wireframe = viewport_wireframe;
+            if (animate_lights)
+                scene_renderer.light_transform = glm::rotate(glm::mat4(1.0f), (float)glfwGetTime() * 0.2f, glm::vec3(0.0f, 0.0f, 1.0f));
+            scene_renderer.render(scene, scene_view, spin, scene_target);
+            gpu_profiler().end_pass();
+            gpu_profiler().begin_pass("Hi-Z Capture");
+            scene_renderer.capture_occluders(scene_target);
+            gpu_profiler().end_pass();
+
+            if (viewport_upscaled)
+            {
+                gpu_profiler().begin_pass("Upscale");
+                viewport_target.bind();
+                dynamic_resolution.upscale(scene_target);
+                gpu_profiler().end_pass();
+            }
+            dynamic_resolution.end_gpu_timer();
+            gl_state().bind_framebuffer(GL_FRAMEBUFFER, 0);
         }
+        gl_state_stats = gl_state().stats();
 
-        glfwSwapBuffers(window);
+        // RENDER IMGUI on top of the cleared window, the viewport is just an image in it
+        gl_state().viewport(0, 0, display_w, display_h);
+        gl_state().set_scissor_test(false);
+        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
+        gpu_profiler().begin_pass("ImGui");
+        glClear(GL_COLOR_BUFFER_BIT);
+        {
+            PROFILE_ZONE("ImGui Draw");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        gpu_profiler().end_pass();
+        gpu_profiler().end_frame();
+        // The ImGui backend changes GL state behind the cache's back
+        gl_state().invalidate();
+
+        {
+            PROFILE_ZONE("Swap Buffers");
+            glfwSwapBuffers(window);
+        }
+        if (startup_ms < 0.0)
+        {
+            startup_ms = glfwGetTime() * 1000.0;
+            const ShaderManager::Stats& shader_stats = shader_manager.stats();
+            printf("Startup: %.1f ms to first frame, shaders %.1f ms (%d programs, %d from binary cache, %d compiled)\n",
+                   startup_ms, shader_stats.load_ms, shader_stats.programs, shader_stats.binary_cache_hits, shader_stats.compiled);
+        }
+        cpu_profiler().end_frame();
     }
 #ifdef __EMSCRIPTEN__
     EMSCRIPTEN_MAINLOOP_END;
 #endif
 
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &vertexBufferID);
-    glDeleteProgram(shaderProgram);
+    gpu_profiler().shutdown();
+    dynamic_resolution.shutdown();
+    shutdown_fullscreen_pass();
+    scene_target.shutdown();
+    viewport_target.shutdown();
+    scene_renderer.shutdown();
+    shader_manager.shutdown();
+    job_system().shutdown();
     
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,249 @@
+#include "mesh.h"
+#include "gl_state.h"
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <unordered_map>
+
+namespace
+{
+    // Hash/compare vertices by their exact bytes: welding only merges true duplicates
+    struct VertexBytesHash
+    {
+        size_t operator()(const Vertex& v) const
+        {
+            // FNV-1a over the raw vertex
+            const unsigned char* bytes = (const unsigned char*)&v;
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    struct VertexBytesEqual
+    {
+        bool operator()(const Vertex& a, const Vertex& b) const
+        {
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+}
+
+void weld_vertices(MeshData& mesh)
+{
+    // Normalise -0.0f to 0.0f so that it welds with +0.0f
+    for (Vertex& v : mesh.vertices)
+    {
+        float* f = &v.position.x;
+        for (size_t i = 0; i < sizeof(Vertex) / sizeof(float); i++)
+            if (f[i] == 0.0f)
+                f[i] = 0.0f;
+    }
+
+    if (mesh.indices.empty())
+    {
+        mesh.indices.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+            mesh.indices[i] = (uint32_t)i;
+    }
+
+    std::unordered_map<Vertex, uint32_t, VertexBytesHash, VertexBytesEqual> lookup;
+    lookup.reserve(mesh.vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(mesh.vertices.size());
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        auto inserted = lookup.emplace(mesh.vertices[i], (uint32_t)welded.size());
+        if (inserted.second)
+            welded.push_back(mesh.vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+
+    for (uint32_t& index : mesh.indices)
+        index = remap[index];
+    mesh.vertices.swap(welded);
+}
+
+MeshData make_quad_mesh()
+{
+    // The original viewport test shape: two triangles covering a unit square, built as
+    // six unindexed corners and welded down to four vertices
+    const glm::vec2 corners[] = {
+        glm::vec2(+0.5f, +0.5f),    // Top right
+        glm::vec2(-0.5f, -0.5f),    // Bottom left
+        glm::vec2(+0.5f, -0.5f),    // Bottom right
+
+        glm::vec2(-0.5f, +0.5f),    // Top left
+        glm::vec2(-0.5f, -0.5f),    // Bottom left
+        glm::vec2(+0.5f, +0.5f)     // Top right
+    };
+
+    MeshData mesh;
+    mesh.name = "Quad";
+    for (const glm::vec2& c : corners)
+    {
+        Vertex v;
+        v.position = glm::vec3(c, 0.0f);
+        v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        v.uv = c + glm::vec2(0.5f);
+        mesh.vertices.push_back(v);
+    }
+    weld_vertices(mesh);
+    return mesh;
+}
+
+MeshData make_sphere_mesh(int segments, int rings)
+{
+    // Latitude/longitude grid; the seam column and the poles keep their own UVs, so they stay
+    // split after welding (and locked during simplification)
+    const float pi = 3.14159265358979f;
+    MeshData mesh;
+    mesh.name = "Sphere";
+    for (int r = 0; r <= rings; r++)
+    {
+        float v = (float)r / rings;
+        float theta = v * pi;
+        for (int s = 0; s <= segments; s++)
+        {
+            float u = (float)s / segments;
+            float phi = u * 2.0f * pi;
+            Vertex vertex;
+            vertex.normal = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            vertex.position = vertex.normal * 0.5f;
+            vertex.uv = glm::vec2(u, 1.0f - v);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    const uint32_t row = (uint32_t)segments + 1;
+    for (int r = 0; r < rings; r++)
+    {
+        for (int s = 0; s < segments; s++)
+        {
+            uint32_t a = r * row + s;
+            uint32_t b = a + row;
+            // The first and last rings meet at a pole, where one triangle of each quad is degenerate
+            if (r != 0)
+                mesh.indices.insert(mesh.indices.end(), { a, a + 1, b });
+            if (r != rings - 1)
+                mesh.indices.insert(mesh.indices.end(), { a + 1, b + 1, b });
+        }
+    }
+    weld_vertices(mesh);
+    generate_lod_chain(mesh);
+    optimize_mesh(mesh);
+    return mesh;
+}
+
+void Mesh::upload(const MeshData& data, const VertexFormat& vertex_format)
+{
+    name = data.name;
+    format = vertex_format;
+    vertex_count = (int)data.vertices.size();
+    index_count = (int)data.indices.size();
+    index_type = vertex_count <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    // Sphere around the box centre; not minimal, but cheap and tight enough for culling
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (!data.vertices.empty())
+        lo = hi = data.vertices[0].position;
+    for (const Vertex& v : data.vertices)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    bounds_centre = (lo + hi) * 0.5f;
+    bounds_radius = 0.0f;
+    for (const Vertex& v : data.vertices)
+        bounds_radius = glm::max(bounds_radius, glm::length(v.position - bounds_centre));
+
+    source_cache = data.source_cache;
+    cache = analyze_vertex_cache(data.indices, data.vertices.size());
+
+    positions.resize(data.vertices.size());
+    for (size_t i = 0; i < data.vertices.size(); i++)
+        positions[i] = data.vertices[i].position;
+    indices = data.indices;
+
+    glGenVertexArrays(1, &vao);
+    gl_state().bind_vertex_array(vao);
+
+    dequantization = vertex_dequantization(data.vertices, format);
+    std::vector<unsigned char> packed;
+    pack_vertices(data.vertices, format, dequantization, packed);
+    vertex_bytes = packed.size();
+    glGenBuffers(1, &vertex_buffer);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+
+    // Full mesh first, then each LOD's indices behind it
+    std::vector<uint32_t> all_indices(data.indices);
+    lods.clear();
+    Lod full;
+    full.index_count = index_count;
+    lods.push_back(full);
+    for (const MeshLod& source : data.lods)
+    {
+        if ((int)lods.size() >= max_lods)
+            break;
+        Lod lod;
+        lod.first_index = (int)all_indices.size();
+        lod.index_count = (int)source.indices.size();
+        lod.error = source.error;
+        all_indices.insert(all_indices.end(), source.indices.begin(), source.indices.end());
+        lods.push_back(lod);
+    }
+
+    // The element buffer binding is part of the VAO state, so bind it while the VAO is bound
+    glGenBuffers(1, &index_buffer);
+    gl_state().bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    if (index_type == GL_UNSIGNED_SHORT)
+    {
+        std::vector<uint16_t> indices16(all_indices.begin(), all_indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices16.size() * sizeof(uint16_t), indices16.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, all_indices.size() * sizeof(uint32_t), all_indices.data(), GL_STATIC_DRAW);
+    }
+
+    set_vertex_attributes(format);
+
+    gl_state().bind_vertex_array(0);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::shutdown()
+{
+    gl_state().forget_vertex_array(vao);
+    gl_state().forget_buffer(vertex_buffer);
+    gl_state().forget_buffer(index_buffer);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    vao = vertex_buffer = index_buffer = 0;
+}
+
+void Mesh::bind() const
+{
+    gl_state().bind_vertex_array(vao);
+    set_vertex_dequantization(dequantization);
+}
+
+void Mesh::draw(int lod) const
+{
+    const Lod& range = lods[lod];
+    size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    glDrawElements(GL_TRIANGLES, range.index_count, index_type, (void*)(range.first_index * index_size));
+}
+
+void Mesh::draw_instanced(int instance_count, int lod) const
+{
+    const Lod& range = lods[lod];
+    size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    glDrawElementsInstanced(GL_TRIANGLES, range.index_count, index_type, (void*)(range.first_index * index_size), instance_count);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex_format.h"
+
+// Vertex attribute locations shared by every mesh VAO and the scene shaders.
+// Per-instance attributes (see instance_renderer.h) start at MESH_ATTRIB_INSTANCE; the
+// dequantization constants (see vertex_format.h) have no arrays and follow them.
+enum
+{
+    MESH_ATTRIB_POSITION = 0,
+    MESH_ATTRIB_NORMAL = 1,
+    MESH_ATTRIB_UV = 2,
+    MESH_ATTRIB_INSTANCE = 4,
+    MESH_ATTRIB_DEQUANT_POSITION_OFFSET = 10,   // w = 1 for octahedral normals
+    MESH_ATTRIB_DEQUANT_POSITION_SCALE = 11,
+    MESH_ATTRIB_DEQUANT_UV = 12                 // xy = offset, zw = scale
+};
+
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+// A coarser version of a mesh: another index list over the same vertices (see mesh_simplify.h)
+struct MeshLod
+{
+    std::vector<uint32_t> indices;
+    float error = 0.0f;     // Largest deviation from the full mesh, in mesh units (conservative)
+};
+
+// Post-transform vertex cache behaviour of an index order (see mesh_optimize.h)
+struct VertexCacheStats
+{
+    float acmr = 0.0f;      // Vertices transformed per triangle: 3 is worst, ~0.5-0.7 is good for large meshes
+    float atvr = 0.0f;      // Vertices transformed per vertex referenced: 1 is best
+};
+
+// CPU-side indexed triangle list, produced by primitives and importers before upload
+struct MeshData
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;      // Optional, increasingly coarse
+    VertexCacheStats source_cache;  // Index order as loaded, if optimize_mesh() ran
+};
+
+// Merge bit-identical vertices and rewrite the index buffer to match.
+// Meshes can be built as unindexed triangle soup (indices may be empty) and welded afterwards.
+void weld_vertices(MeshData& mesh);
+
+// Built-in primitives, already welded
+MeshData make_quad_mesh();
+// UV sphere of radius 0.5, with its LOD chain, optimized
+MeshData make_sphere_mesh(int segments = 32, int rings = 16);
+
+// GPU mesh: VAO + vertex buffer + element buffer.
+// Vertices are stored in the VertexFormat given to upload(); call bind() rather than binding
+// the VAO directly so quantized formats get their ranges.
+// Indices are stored as 16-bit when every vertex fits, 32-bit otherwise. The LOD index lists
+// follow the full mesh's in the same element buffer, all over the one vertex buffer.
+class Mesh
+{
+public:
+    static const int max_lods = 4;      // Including the full mesh
+
+    struct Lod
+    {
+        int first_index = 0;
+        int index_count = 0;
+        float error = 0.0f;             // In mesh units, 0 for the full mesh
+    };
+
+    void upload(const MeshData& data, const VertexFormat& format = VertexFormat::full());
+    void shutdown();
+
+    // Bind the VAO and set the dequantization constants
+    void bind() const;
+
+    void draw(int lod = 0) const;
+    void draw_instanced(int instance_count, int lod = 0) const;
+
+    std::string name;
+    GLuint vao = 0;
+    GLuint vertex_buffer = 0;
+    GLuint index_buffer = 0;
+    GLenum index_type = GL_UNSIGNED_SHORT;
+    int vertex_count = 0;
+    int index_count = 0;
+    VertexFormat format;
+    VertexDequantization dequantization;
+    size_t vertex_bytes = 0;            // GPU memory of the vertex buffer
+    std::vector<Lod> lods;              // lods[0] is the full mesh
+    VertexCacheStats source_cache;      // Before optimization (zero if the mesh was not optimized)
+    VertexCacheStats cache;             // Of the uploaded full-detail index order
+    // Local-space bounding sphere, for culling
+    glm::vec3 bounds_centre = glm::vec3(0.0f);
+    float bounds_radius = 0.0f;
+    // CPU copy of the triangles, for picking
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
@@ -0,0 +1,136 @@
+#include "mesh_import.h"
+#include "mesh_simplify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// Resolve a 1-based (or negative, relative-to-end) OBJ index into a 0-based one, -1 if absent/invalid
+static int resolve_obj_index(const char* token, int count)
+{
+    if (token == nullptr || *token == '\0')
+        return -1;
+    int index = atoi(token);
+    if (index > 0)
+        index -= 1;
+    else if (index < 0)
+        index += count;
+    else
+        return -1;
+    return (index >= 0 && index < count) ? index : -1;
+}
+
+bool import_obj_mesh(const char* path, MeshData& out, std::string& error, MeshOptimizeReport* report)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = std::string("Could not open ") + path;
+        return false;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+
+    out = MeshData();
+    // The name follows the last separator of either kind (pointers into the same string compare safely)
+    const char* slash = strrchr(path, '/');
+    const char* backslash = strrchr(path, '\\');
+    out.name = std::max({ path, slash ? slash + 1 : path, backslash ? backslash + 1 : path });
+
+    std::string line;
+    std::vector<Vertex> face;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string tag;
+        stream >> tag;
+        if (tag == "v")
+        {
+            glm::vec3 p(0.0f);
+            stream >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        }
+        else if (tag == "vn")
+        {
+            glm::vec3 n(0.0f);
+            stream >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        }
+        else if (tag == "vt")
+        {
+            glm::vec2 t(0.0f);
+            stream >> t.x >> t.y;
+            uvs.push_back(t);
+        }
+        else if (tag == "f")
+        {
+            // Each corner is "p", "p/t", "p//n" or "p/t/n"
+            face.clear();
+            bool has_normals = true;
+            std::string corner;
+            while (stream >> corner)
+            {
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%s", corner.c_str());
+                char* slash1 = strchr(buf, '/');
+                char* slash2 = slash1 ? strchr(slash1 + 1, '/') : nullptr;
+                if (slash1) *slash1 = '\0';
+                if (slash2) *slash2 = '\0';
+
+                int p = resolve_obj_index(buf, (int)positions.size());
+                if (p < 0)
+                {
+                    error = "Invalid face index in " + out.name + ": " + line;
+                    return false;
+                }
+                int t = slash1 ? resolve_obj_index(slash1 + 1, (int)uvs.size()) : -1;
+                int n = slash2 ? resolve_obj_index(slash2 + 1, (int)normals.size()) : -1;
+
+                Vertex v;
+                v.position = positions[p];
+                v.uv = t >= 0 ? uvs[t] : glm::vec2(0.0f);
+                v.normal = n >= 0 ? normals[n] : glm::vec3(0.0f);
+                has_normals = has_normals && n >= 0;
+                face.push_back(v);
+            }
+            if (face.size() < 3)
+                continue;
+
+            // Faces without normals get a flat face normal
+            if (!has_normals)
+            {
+                glm::vec3 face_normal = glm::cross(face[1].position - face[0].position, face[2].position - face[0].position);
+                float length = glm::length(face_normal);
+                face_normal = length > 0.0f ? face_normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+                for (Vertex& v : face)
+                    v.normal = face_normal;
+            }
+
+            // Fan triangulation into an unindexed soup; welding below builds the index buffer
+            for (size_t i = 1; i + 1 < face.size(); i++)
+            {
+                out.vertices.push_back(face[0]);
+                out.vertices.push_back(face[i]);
+                out.vertices.push_back(face[i + 1]);
+            }
+        }
+    }
+
+    if (out.vertices.empty())
+    {
+        error = out.name + " contains no faces";
+        return false;
+    }
+
+    weld_vertices(out);
+    generate_lod_chain(out);
+    MeshOptimizeReport optimized = optimize_mesh(out);
+    if (report)
+        *report = optimized;
+    return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include "mesh.h"
+#include "mesh_optimize.h"
+
+// Load a Wavefront OBJ file (v/vt/vn/f, polygons are fan-triangulated).
+// The result is welded, so corners shared between faces become one indexed vertex, carries
+// a generated LOD chain and is reordered for the vertex cache, overdraw and vertex fetch
+// (report, if given, receives the before/after cache figures).
+// Returns false and fills error on failure.
+bool import_obj_mesh(const char* path, MeshData& out, std::string& error, MeshOptimizeReport* report = nullptr);
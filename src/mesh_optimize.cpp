@@ -0,0 +1,229 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <chrono>
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, int cache_size)
+{
+    VertexCacheStats stats;
+    if (indices.size() < 3)
+        return stats;
+
+    // FIFO: a vertex is in the cache if it was pushed within the last cache_size misses
+    std::vector<uint32_t> pushed_at(vertex_count, 0);
+    std::vector<unsigned char> referenced(vertex_count, 0);
+    uint32_t misses = 0;
+    size_t distinct = 0;
+    for (uint32_t v : indices)
+    {
+        if (!referenced[v])
+        {
+            referenced[v] = 1;
+            distinct++;
+        }
+        if (pushed_at[v] == 0 || misses + 1 - pushed_at[v] > (uint32_t)cache_size)
+        {
+            misses++;
+            pushed_at[v] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (float)(indices.size() / 3);
+    stats.atvr = (float)misses / (float)distinct;
+    return stats;
+}
+
+int optimize_vertex_cache(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, bool sort_for_overdraw)
+{
+    const size_t triangle_count = indices.size() / 3;
+    const uint32_t vertex_count = (uint32_t)vertices.size();
+    if (triangle_count == 0)
+        return 0;
+
+    // Vertex -> triangle adjacency (CSR) and live triangle counts
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (uint32_t v : indices)
+        live[v]++;
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangle_count; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+    }
+
+    // Tipsify
+    const int cache_size = vertex_cache_size;
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<unsigned char> emitted(triangle_count, 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cluster_starts;     // First triangle of each cluster, in output order
+    uint32_t timestamp = cache_size + 1;
+    uint32_t cursor = 0;
+    int fan = (int)indices[0];
+    cluster_starts.push_back(0);
+    while (fan >= 0)
+    {
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            uint32_t t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cache_time[v] > (uint32_t)cache_size)
+                    cache_time[v] = timestamp++;
+            }
+        }
+
+        // Next fan: the candidate still in cache after its remaining triangles are emitted
+        // that entered the cache earliest; otherwise fall back to the dead-end stack
+        int next = -1;
+        int best_priority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (timestamp - cache_time[v] + 2 * live[v] <= (uint32_t)cache_size)
+                priority = (int)(timestamp - cache_time[v]);
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = (int)v;
+            }
+        }
+        if (next < 0)
+        {
+            while (!dead_end.empty() && next < 0)
+            {
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                    next = (int)v;
+            }
+            while (next < 0 && cursor < vertex_count)
+            {
+                if (live[cursor] > 0)
+                    next = (int)cursor;
+                cursor++;
+            }
+            // A jump breaks cache locality anyway, so it is a free place to start a new cluster
+            if (next >= 0 && output.size() / 3 != cluster_starts.back())
+                cluster_starts.push_back((uint32_t)(output.size() / 3));
+        }
+        fan = next;
+    }
+
+    if (!sort_for_overdraw || cluster_starts.size() < 2)
+    {
+        indices.swap(output);
+        return (int)cluster_starts.size();
+    }
+
+    // Occlusion potential: clusters facing away from the mesh centre tend to cover the rest
+    glm::vec3 mesh_centre(0.0f);
+    float mesh_area = 0.0f;
+    struct Cluster
+    {
+        uint32_t first, count;
+        float potential;
+    };
+    std::vector<Cluster> clusters(cluster_starts.size());
+    std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        uint32_t first = cluster_starts[c];
+        uint32_t last = c + 1 < clusters.size() ? cluster_starts[c + 1] : (uint32_t)(output.size() / 3);
+        clusters[c].first = first;
+        clusters[c].count = last - first;
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = first; t < last; t++)
+        {
+            const glm::vec3& a = vertices[output[t * 3]].position;
+            const glm::vec3& b = vertices[output[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[output[t * 3 + 2]].position;
+            glm::vec3 n = glm::cross(b - a, d - a);     // Length is twice the area
+            float triangle_area = glm::length(n);
+            centroid += (a + b + d) * (triangle_area / 3.0f);
+            normal += n;
+            area += triangle_area;
+        }
+        mesh_centre += centroid;
+        mesh_area += area;
+        centroids[c] = area > 0.0f ? centroid / area : vertices[output[first * 3]].position;
+        float normal_length = glm::length(normal);
+        normals[c] = normal_length > 0.0f ? normal / normal_length : glm::vec3(0.0f);
+    }
+    if (mesh_area > 0.0f)
+        mesh_centre /= mesh_area;
+    for (size_t c = 0; c < clusters.size(); c++)
+        clusters[c].potential = glm::dot(centroids[c] - mesh_centre, normals[c]);
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.potential > b.potential; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(output.size());
+    for (const Cluster& cluster : clusters)
+        sorted.insert(sorted.end(), output.begin() + cluster.first * 3, output.begin() + (cluster.first + cluster.count) * 3);
+
+    // Reordering clusters costs misses at every seam between them; keep it only if that is small
+    float cache_acmr = analyze_vertex_cache(output, vertex_count).acmr;
+    float sorted_acmr = analyze_vertex_cache(sorted, vertex_count).acmr;
+    indices.swap(sorted_acmr <= cache_acmr * overdraw_acmr_threshold ? sorted : output);
+    return (int)clusters.size();
+}
+
+void optimize_vertex_fetch(MeshData& mesh)
+{
+    const uint32_t unused = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+    std::vector<Vertex> fetch_ordered;
+    fetch_ordered.reserve(mesh.vertices.size());
+    auto renumber = [&](std::vector<uint32_t>& indices)
+    {
+        for (uint32_t& index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (uint32_t)fetch_ordered.size();
+                fetch_ordered.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+    };
+    // LODs reference a subset of the full mesh's vertices, so they add nothing new
+    renumber(mesh.indices);
+    for (MeshLod& lod : mesh.lods)
+        renumber(lod.indices);
+    mesh.vertices.swap(fetch_ordered);
+}
+
+MeshOptimizeReport optimize_mesh(MeshData& mesh)
+{
+    auto start = std::chrono::steady_clock::now();
+    MeshOptimizeReport report;
+    report.before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+    mesh.source_cache = report.before;
+
+    report.clusters = optimize_vertex_cache(mesh.indices, mesh.vertices);
+    for (MeshLod& lod : mesh.lods)
+        optimize_vertex_cache(lod.indices, mesh.vertices);
+    optimize_vertex_fetch(mesh);
+
+    report.after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+    report.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "mesh.h"
+
+// Index and vertex reordering for imported meshes, run once when they are loaded:
+//
+//  1. Vertex cache: Tipsify (Sander, Nehab & Barczak 2007) fans around each vertex while its
+//     neighbours are likely still in the post-transform cache, and jumps to a recently used
+//     vertex with triangles left when a fan dead-ends.
+//  2. Overdraw: the jumps split the order into clusters that are each cache-coherent, which are
+//     then sorted by how much they are likely to occlude the rest of the mesh (facing away from
+//     its centre first), so early depth rejection skips more of what follows. The new order is
+//     only kept if the cache miss ratio stays within overdraw_acmr_threshold of step 1's.
+//  3. Vertex fetch: vertices are renumbered in order of first use, so the vertex buffer is read
+//     close to sequentially; unreferenced vertices are dropped.
+//
+// Efficiency is measured on a FIFO cache of cache_size entries: ACMR is vertices transformed per
+// triangle, ATVR is vertices transformed per distinct vertex referenced (1 is perfect).
+
+static const int vertex_cache_size = 16;
+static const float overdraw_acmr_threshold = 1.05f;
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, int cache_size = vertex_cache_size);
+
+// Steps 1-2 on one index list in place; returns the number of overdraw clusters
+int optimize_vertex_cache(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, bool sort_for_overdraw = true);
+// Step 3 across mesh.indices and every LOD
+void optimize_vertex_fetch(MeshData& mesh);
+
+struct MeshOptimizeReport
+{
+    VertexCacheStats before, after;     // Full-detail index list
+    int clusters = 0;
+    double ms = 0.0;
+};
+
+// All three steps on the full mesh and each LOD; also records mesh.source_cache
+MeshOptimizeReport optimize_mesh(MeshData& mesh);
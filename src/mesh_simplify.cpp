@@ -0,0 +1,369 @@
+#include "mesh_simplify.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+    // Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (10 coefficients)
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        void add_plane(double a, double b, double c, double d)
+        {
+            a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+            b2 += b * b; bc += b * c; bd += b * d;
+            c2 += c * c; cd += c * d;
+            d2 += d * d;
+        }
+
+        void add(const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double error(const glm::vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                     + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                     + c2 * z * z + 2.0 * cd * z
+                     + d2;
+            return e > 0.0 ? e : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        float cost;
+        uint32_t from, to;
+        uint32_t stamp;     // Version of from's quadric the cost was computed with
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t bits[3];
+            memcpy(bits, &p.x, sizeof(bits));
+            return ((size_t)bits[0] * 73856093u) ^ ((size_t)bits[1] * 19349663u) ^ ((size_t)bits[2] * 83492791u);
+        }
+    };
+
+    uint64_t edge_key(uint32_t a, uint32_t b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+}
+
+void simplify_mesh(const MeshData& mesh, const float* ratios, int ratio_count, float max_error, std::vector<MeshLod>& out)
+{
+    out.clear();
+    const uint32_t vertex_count = (uint32_t)mesh.vertices.size();
+    const uint32_t triangle_count = (uint32_t)(mesh.indices.size() / 3);
+    if (triangle_count == 0 || ratio_count <= 0)
+        return;
+
+    // Topology works on positions: vertices split only by normal/UV share one canonical vertex
+    std::vector<uint32_t> canonical(vertex_count);
+    std::vector<std::vector<uint32_t>> originals(vertex_count);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> lookup;
+        lookup.reserve(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; i++)
+        {
+            uint32_t c = lookup.emplace(mesh.vertices[i].position, i).first->second;
+            canonical[i] = c;
+            originals[c].push_back(i);
+        }
+    }
+    auto position = [&](uint32_t c) -> const glm::vec3& { return mesh.vertices[c].position; };
+
+    // Corners hold original vertex indices, so the output keeps each corner's attributes
+    std::vector<uint32_t> corners(mesh.indices.begin(), mesh.indices.begin() + triangle_count * 3);
+    std::vector<unsigned char> removed(triangle_count, 0);
+    std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+    std::vector<Quadric> quadrics(vertex_count);
+    std::unordered_map<uint64_t, int> edge_use;
+    edge_use.reserve(triangle_count * 3);
+    uint32_t live = 0;
+    for (uint32_t t = 0; t < triangle_count; t++)
+    {
+        uint32_t c0 = canonical[corners[t * 3]], c1 = canonical[corners[t * 3 + 1]], c2 = canonical[corners[t * 3 + 2]];
+        if (c0 == c1 || c1 == c2 || c0 == c2)
+        {
+            removed[t] = 1;
+            continue;
+        }
+        live++;
+        vertex_triangles[c0].push_back(t);
+        vertex_triangles[c1].push_back(t);
+        vertex_triangles[c2].push_back(t);
+        edge_use[edge_key(c0, c1)]++;
+        edge_use[edge_key(c1, c2)]++;
+        edge_use[edge_key(c2, c0)]++;
+
+        glm::vec3 normal = glm::cross(position(c1) - position(c0), position(c2) - position(c0));
+        float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normal /= length;
+            double d = -(double)glm::dot(normal, position(c0));
+            quadrics[c0].add_plane(normal.x, normal.y, normal.z, d);
+            quadrics[c1].add_plane(normal.x, normal.y, normal.z, d);
+            quadrics[c2].add_plane(normal.x, normal.y, normal.z, d);
+        }
+    }
+
+    // Lock seams, open borders and non-manifold edges
+    std::vector<unsigned char> locked(vertex_count, 0);
+    for (uint32_t c = 0; c < vertex_count; c++)
+        locked[c] = originals[c].size() > 1;
+    for (const auto& edge : edge_use)
+    {
+        if (edge.second != 2)
+        {
+            locked[(uint32_t)(edge.first >> 32)] = 1;
+            locked[(uint32_t)edge.first] = 1;
+        }
+    }
+
+    std::vector<unsigned char> collapsed(vertex_count, 0);
+    std::vector<uint32_t> stamps(vertex_count, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    auto push_collapses = [&](uint32_t from)
+    {
+        if (locked[from] || collapsed[from])
+            return;
+        for (uint32_t t : vertex_triangles[from])
+        {
+            if (removed[t])
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t to = canonical[corners[t * 3 + k]];
+                if (to != from)
+                    heap.push({ (float)quadrics[from].error(position(to)), from, to, stamps[from] });
+            }
+        }
+    };
+    for (uint32_t c = 0; c < vertex_count; c++)
+        if (canonical[c] == c)
+            push_collapses(c);
+
+    // Attribute-compatible vertex of a (possibly seam) target for a corner moving onto it
+    auto closest_original = [&](uint32_t to, uint32_t corner)
+    {
+        const std::vector<uint32_t>& candidates = originals[to];
+        if (candidates.size() == 1)
+            return candidates[0];
+        const Vertex& from = mesh.vertices[corner];
+        uint32_t best = candidates[0];
+        float best_distance = 1e30f;
+        for (uint32_t candidate : candidates)
+        {
+            const Vertex& v = mesh.vertices[candidate];
+            glm::vec3 dn = v.normal - from.normal;
+            glm::vec2 duv = v.uv - from.uv;
+            float distance = glm::dot(dn, dn) + glm::dot(duv, duv);
+            if (distance < best_distance)
+            {
+                best_distance = distance;
+                best = candidate;
+            }
+        }
+        return best;
+    };
+
+    auto snapshot = [&](float error)
+    {
+        MeshLod lod;
+        lod.error = error;
+        lod.indices.reserve(live * 3);
+        for (uint32_t t = 0; t < triangle_count; t++)
+            if (!removed[t])
+                lod.indices.insert(lod.indices.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+        out.push_back(std::move(lod));
+    };
+
+    std::vector<uint32_t> link_from, link_to;
+    double worst_error = 0.0;
+    int next_ratio = 0;
+    while (next_ratio < ratio_count)
+    {
+        if (live <= (uint32_t)(ratios[next_ratio] * triangle_count) || heap.empty())
+        {
+            snapshot((float)sqrt(worst_error));
+            next_ratio++;
+            continue;
+        }
+
+        Collapse collapse = heap.top();
+        if (collapse.cost > max_error * max_error)
+        {
+            // Everything left costs too much; the remaining levels get the current state
+            while (!heap.empty())
+                heap.pop();
+            continue;
+        }
+        heap.pop();
+        const uint32_t from = collapse.from, to = collapse.to;
+        if (collapsed[from] || collapsed[to] || collapse.stamp != stamps[from])
+            continue;
+
+        // The pair must still share a triangle, and no surviving triangle may flip
+        bool adjacent = false, flips = false;
+        for (uint32_t t : vertex_triangles[from])
+        {
+            if (removed[t])
+                continue;
+            glm::vec3 p[3], moved[3];
+            bool has_to = false;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t c = canonical[corners[t * 3 + k]];
+                has_to |= c == to;
+                p[k] = position(c);
+                moved[k] = c == from ? position(to) : p[k];
+            }
+            if (has_to)
+            {
+                adjacent = true;
+                continue;
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            float after_length = glm::length(after);
+            if (after_length <= 1e-12f || glm::dot(before, after) < 0.2f * glm::length(before) * after_length)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if (!adjacent || flips)
+            continue;
+
+        // Link condition: the only neighbours the two may share are the apexes of the triangles
+        // on the edge, otherwise the collapse pinches the surface into a non-manifold fold
+        link_from.clear();
+        link_to.clear();
+        int shared_triangles = 0;
+        for (uint32_t t : vertex_triangles[from])
+        {
+            if (removed[t])
+                continue;
+            bool has_to = false;
+            for (int k = 0; k < 3; k++)
+                has_to |= canonical[corners[t * 3 + k]] == to;
+            shared_triangles += has_to;
+            for (int k = 0; k < 3; k++)
+                link_from.push_back(canonical[corners[t * 3 + k]]);
+        }
+        for (uint32_t t : vertex_triangles[to])
+            if (!removed[t])
+                for (int k = 0; k < 3; k++)
+                    link_to.push_back(canonical[corners[t * 3 + k]]);
+        std::sort(link_from.begin(), link_from.end());
+        link_from.erase(std::unique(link_from.begin(), link_from.end()), link_from.end());
+        std::sort(link_to.begin(), link_to.end());
+        link_to.erase(std::unique(link_to.begin(), link_to.end()), link_to.end());
+        int shared_neighbours = 0;
+        for (size_t a = 0, b = 0; a < link_from.size() && b < link_to.size(); )
+        {
+            if (link_from[a] < link_to[b])
+                a++;
+            else if (link_from[a] > link_to[b])
+                b++;
+            else
+            {
+                shared_neighbours += link_from[a] != from && link_from[a] != to;
+                a++;
+                b++;
+            }
+        }
+        if (shared_neighbours != shared_triangles)
+            continue;
+
+        // Move from's corners onto to; triangles spanning the edge disappear
+        for (uint32_t t : vertex_triangles[from])
+        {
+            if (removed[t])
+                continue;
+            bool has_to = false;
+            for (int k = 0; k < 3; k++)
+                has_to |= canonical[corners[t * 3 + k]] == to;
+            if (has_to)
+            {
+                removed[t] = 1;
+                live--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (canonical[corners[t * 3 + k]] == from)
+                    corners[t * 3 + k] = closest_original(to, corners[t * 3 + k]);
+            vertex_triangles[to].push_back(t);
+        }
+        vertex_triangles[from].clear();
+        vertex_triangles[from].shrink_to_fit();
+        collapsed[from] = 1;
+        quadrics[to].add(quadrics[from]);
+        stamps[to]++;
+        worst_error = std::max(worst_error, (double)collapse.cost);
+
+        // to's quadric changed, so its own collapses are re-costed; neighbours' costs onto to
+        // are unchanged (their quadrics and to's position are), but they may be new edges
+        std::vector<uint32_t>& around = vertex_triangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return removed[t] != 0; }), around.end());
+        push_collapses(to);
+        for (uint32_t t : around)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t c = canonical[corners[t * 3 + k]];
+                if (c != to && !locked[c])
+                    heap.push({ (float)quadrics[c].error(position(to)), c, to, stamps[c] });
+            }
+        }
+    }
+}
+
+void generate_lod_chain(MeshData& mesh)
+{
+    static const float ratios[] = { 0.5f, 0.25f, 0.125f };
+    // Beyond ~5% of the mesh's extent a level no longer resembles it at any useful distance
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (!mesh.vertices.empty())
+        lo = hi = mesh.vertices[0].position;
+    for (const Vertex& v : mesh.vertices)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    float max_error = glm::length(hi - lo) * 0.05f;
+
+    std::vector<MeshLod> lods;
+    simplify_mesh(mesh, ratios, (int)(sizeof(ratios) / sizeof(ratios[0])), max_error, lods);
+
+    // Keep a level only if it is clearly cheaper than the one before it
+    mesh.lods.clear();
+    size_t previous = mesh.indices.size();
+    for (MeshLod& lod : lods)
+    {
+        if (lod.indices.empty() || lod.indices.size() > previous * 3 / 4)
+            continue;
+        previous = lod.indices.size();
+        mesh.lods.push_back(std::move(lod));
+        if ((int)mesh.lods.size() + 1 >= Mesh::max_lods)
+            break;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge collapse.
+//
+// Every collapse moves a vertex onto one of its neighbours, so the simplified triangles only
+// reference vertices that were already in the mesh and each LOD is just another index list over
+// the same vertex buffer. Vertices on open borders, on non-manifold edges and on attribute seams
+// (a position shared by several vertices with different normals/UVs) are locked, which keeps
+// silhouettes and UV layouts intact at the cost of limiting how far such meshes can reduce.
+// Collapses that would flip a triangle are rejected.
+//
+// simplify_mesh() runs one collapse sequence and snapshots it as the triangle count passes
+// each ratio (descending, relative to the input), so a whole chain costs one simplification.
+// A snapshot's error is the square root of the largest quadric error collapsed so far, a
+// conservative distance in mesh units. Collapsing stops before the error would pass max_error;
+// ratios that cannot be reached yield what was achieved.
+void simplify_mesh(const MeshData& mesh, const float* ratios, int ratio_count, float max_error, std::vector<MeshLod>& out);
+
+// Fill mesh.lods with 50%, 25% and 12.5% levels, dropping levels that barely reduce. Levels
+// stop at an error of 5% of the mesh's bounding box diagonal.
+void generate_lod_chain(MeshData& mesh);
@@ -0,0 +1,233 @@
+#include "occlusion_culling.h"
+#include "fullscreen_pass.h"
+#include "gl_state.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+bool OcclusionCuller::init(ShaderManager& shaders)
+{
+    program = shaders.load_program("fullscreen.vert", "hiz_downsample.frag");
+    if (program)
+    {
+        // The depth is always read from unit 0
+        gl_state().use_program(program);
+        glUniform1i(glGetUniformLocation(program, "uDepth"), 0);
+        source_size_location = glGetUniformLocation(program, "uSourceSize");
+        footprint_location = glGetUniformLocation(program, "uFootprint");
+    }
+    glGenFramebuffers(1, &framebuffer);
+    for (Readback& readback : readbacks)
+        glGenBuffers(1, &readback.buffer);
+    return program != 0;
+}
+
+void OcclusionCuller::shutdown()
+{
+    for (Readback& readback : readbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        gl_state().forget_buffer(readback.buffer);
+        glDeleteBuffers(1, &readback.buffer);
+        readback = Readback();
+    }
+    gl_state().forget_texture(texture);
+    gl_state().forget_framebuffer(framebuffer);
+    glDeleteTextures(1, &texture);
+    glDeleteFramebuffers(1, &framebuffer);
+    texture = framebuffer = 0;
+    texture_width = texture_height = 0;
+    program = 0;    // Owned by the ShaderManager
+    levels.clear();
+}
+
+void OcclusionCuller::reset()
+{
+    levels.clear();
+}
+
+void OcclusionCuller::capture(const RenderTarget& source, const glm::mat4& capture_view_projection)
+{
+    if (!program || source.width <= 0 || source.height <= 0)
+        return;
+
+    // Skip the capture rather than stall if the GPU still owns the next buffer
+    Readback& readback = readbacks[next_readback];
+    if (readback.fence)
+        return;
+
+    const int scale = (source.width + max_width - 1) / max_width;
+    const int w = (source.width + scale - 1) / scale;
+    const int h = (source.height + scale - 1) / scale;
+    if (w != texture_width || h != texture_height)
+    {
+        gl_state().forget_texture(texture);
+        glDeleteTextures(1, &texture);
+        glGenTextures(1, &texture);
+        gl_state().bind_texture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        texture_width = w;
+        texture_height = h;
+    }
+
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl_state().viewport(0, 0, w, h);
+    gl_state().use_program(program);
+    gl_state().set_depth_test(false);
+    gl_state().set_blend(false);
+    gl_state().set_cull_face(false);
+    gl_state().polygon_mode(GL_FILL);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, source.depth_texture);
+    glUniform2i(source_size_location, source.width, source.height);
+    glUniform1i(footprint_location, scale);
+    draw_fullscreen_triangle();
+
+    // Asynchronous: glReadPixels into a pack buffer returns at once, the fence says when it landed
+    gl_state().bind_buffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const size_t bytes = (size_t)w * h * sizeof(float);
+    if (readback.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_READ);
+        readback.capacity = bytes;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w, h, GL_RED, GL_FLOAT, nullptr);
+    gl_state().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    readback.width = w;
+    readback.height = h;
+    readback.source_width = source.width;
+    readback.source_height = source.height;
+    readback.footprint = scale;
+    readback.view_projection = capture_view_projection;
+    readback.serial = ++capture_serial;
+    next_readback = (next_readback + 1) % readback_count;
+}
+
+void OcclusionCuller::update()
+{
+    // Readbacks complete in order, so the newest signalled one is the one to use
+    Readback* newest = nullptr;
+    for (int i = 0; i < readback_count; i++)
+    {
+        Readback& readback = readbacks[(next_readback + i) % readback_count];
+        if (!readback.fence)
+            continue;
+        if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        newest = &readback;
+    }
+    if (newest && newest->serial > pyramid_serial)
+    {
+        auto start = std::chrono::steady_clock::now();
+        levels.resize(1);
+        Level& base = levels[0];
+        base.width = newest->width;
+        base.height = newest->height;
+        base.depth.resize((size_t)base.width * base.height);
+        gl_state().bind_buffer(GL_PIXEL_PACK_BUFFER, newest->buffer);
+        const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)(base.depth.size() * sizeof(float)), GL_MAP_READ_BIT);
+        if (data)
+        {
+            memcpy(base.depth.data(), data, base.depth.size() * sizeof(float));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        gl_state().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!data)
+        {
+            levels.clear();
+            return;
+        }
+
+        // Each coarser level keeps the farthest of the (up to) 2x2 texels beneath it
+        while (levels.back().width > 1 || levels.back().height > 1)
+        {
+            const Level& fine = levels.back();
+            Level coarse;
+            coarse.width = (fine.width + 1) / 2;
+            coarse.height = (fine.height + 1) / 2;
+            coarse.depth.resize((size_t)coarse.width * coarse.height);
+            for (int y = 0; y < coarse.height; y++)
+            {
+                const float* row0 = &fine.depth[(size_t)(2 * y) * fine.width];
+                const float* row1 = &fine.depth[(size_t)std::min(2 * y + 1, fine.height - 1) * fine.width];
+                for (int x = 0; x < coarse.width; x++)
+                {
+                    int x0 = 2 * x, x1 = std::min(2 * x + 1, fine.width - 1);
+                    coarse.depth[(size_t)y * coarse.width + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+                }
+            }
+            levels.push_back(std::move(coarse));
+        }
+
+        view_projection = newest->view_projection;
+        source_width = newest->source_width;
+        source_height = newest->source_height;
+        footprint = newest->footprint;
+        pyramid_serial = newest->serial;
+        build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    frames_old = (int)(capture_serial - pyramid_serial);
+}
+
+bool OcclusionCuller::is_occluded(const glm::vec3& lo, const glm::vec3& hi) const
+{
+    if (levels.empty())
+        return false;
+
+    // Screen rectangle and nearest depth of the box's corners
+    glm::vec2 ndc_min(1e30f), ndc_max(-1e30f);
+    float nearest = 1e30f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p((corner & 1) ? hi.x : lo.x, (corner & 2) ? hi.y : lo.y, (corner & 4) ? hi.z : lo.z);
+        glm::vec4 clip = view_projection * glm::vec4(p, 1.0f);
+        if (clip.w <= 1e-5f || clip.z < -clip.w)
+            return false;   // Crosses the near plane / behind the camera
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, glm::vec2(ndc));
+        ndc_max = glm::max(ndc_max, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    // Wholly or partly outside the captured view: there is no depth for the part outside, and a
+    // box entering the screen must not be tested against the edge texels alone
+    if (ndc_min.x < -1.0f || ndc_min.y < -1.0f || ndc_max.x > 1.0f || ndc_max.y > 1.0f || nearest > 1.0f)
+        return false;
+
+    // Base level texels covered
+    const Level& base = levels[0];
+    auto to_texel = [&](float ndc, int size, int texels)
+    {
+        float pixel = (ndc * 0.5f + 0.5f) * (float)size;
+        return glm::clamp((int)pixel / footprint, 0, texels - 1);
+    };
+    int x0 = to_texel(ndc_min.x, source_width, base.width);
+    int x1 = to_texel(ndc_max.x, source_width, base.width);
+    int y0 = to_texel(ndc_min.y, source_height, base.height);
+    int y1 = to_texel(ndc_max.y, source_height, base.height);
+
+    // Go up until the rectangle spans at most 2x2 texels
+    int level = 0;
+    while ((x1 - x0 > 1 || y1 - y0 > 1) && level + 1 < (int)levels.size())
+    {
+        x0 >>= 1; x1 >>= 1;
+        y0 >>= 1; y1 >>= 1;
+        level++;
+    }
+
+    const Level& hiz = levels[level];
+    float farthest = 0.0f;
+    for (int y = y0; y <= std::min(y1, hiz.height - 1); y++)
+        for (int x = x0; x <= std::min(x1, hiz.width - 1); x++)
+            farthest = std::max(farthest, hiz.depth[(size_t)y * hiz.width + x]);
+    return nearest > farthest;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <glad/glad.h>
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "render_target.h"
+#include "shader_manager.h"
+
+// Occlusion culling against a hierarchical depth buffer (Hi-Z) built from an earlier frame.
+//
+// capture() max-reduces the rendered depth into a small R32F texture (at most max_width texels
+// across) and starts reading it back through a ring of pixel pack buffers; update() picks up the
+// newest readback whose fence has signalled and builds the rest of the pyramid on the CPU, each
+// level holding the farthest depth of the 2x2 texels below it. Nothing waits on the GPU, so the
+// depth used is a few frames old and is tested with the view-projection it was rendered with.
+// A box is occluded when its nearest depth is behind the farthest depth over the (at most 2x2)
+// texels it covers at the level where it spans one or two texels.
+//
+// Because the depth lags, an object that is uncovered by a moving occluder can appear a few
+// frames late; geometry crossing the near plane or even partly outside the captured view is never
+// rejected.
+class OcclusionCuller
+{
+public:
+    static const int max_width = 256;
+    static const int readback_count = 3;
+
+    bool init(ShaderManager& shaders);
+    void shutdown();
+
+    // Reduce the rendered region of source's depth texture and queue its readback;
+    // view_projection is the camera it was rendered with. Changes the bound framebuffer.
+    void capture(const RenderTarget& source, const glm::mat4& view_projection);
+    // Take the newest finished readback, if any, and rebuild the pyramid from it
+    void update();
+    // Forget the pyramid (e.g. after the depth stops being written)
+    void reset();
+
+    bool ready() const { return !levels.empty(); }
+    // True if the world-space box is certainly hidden behind the captured depth
+    bool is_occluded(const glm::vec3& lo, const glm::vec3& hi) const;
+
+    struct Level
+    {
+        int width = 0, height = 0;
+        std::vector<float> depth;       // Row-major, bottom row first
+    };
+    std::vector<Level> levels;
+    glm::mat4 view_projection = glm::mat4(1.0f);    // Camera the pyramid was captured with
+    int source_width = 0, source_height = 0;        // Rendered size the pyramid covers
+    int footprint = 1;                              // Source pixels per base texel, per axis
+    int frames_old = 0;                             // Captures made since the pyramid's one
+    double build_ms = 0.0;                          // CPU time of the last readback and pyramid build
+
+private:
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0, height = 0;
+        int source_width = 0, source_height = 0;
+        int footprint = 1;
+        glm::mat4 view_projection = glm::mat4(1.0f);
+        unsigned serial = 0;
+    };
+
+    GLuint program = 0;
+    GLint source_size_location = -1;
+    GLint footprint_location = -1;
+    GLuint framebuffer = 0;
+    GLuint texture = 0;
+    int texture_width = 0, texture_height = 0;
+    Readback readbacks[readback_count];
+    int next_readback = 0;
+    unsigned capture_serial = 0;
+    unsigned pyramid_serial = 0;
+};
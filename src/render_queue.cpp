@@ -0,0 +1,148 @@
+#include "render_queue.h"
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <chrono>
+#include <utility>
+#include <string.h>
+
+static const int depth_bits = 24;
+static const uint32_t depth_max = (1u << depth_bits) - 1;
+
+static const uint64_t depth_first_bit = 1ull << 60;
+
+uint64_t make_sort_key(RenderPass pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth01, bool front_to_back)
+{
+    depth01 = depth01 < 0.0f ? 0.0f : (depth01 > 1.0f ? 1.0f : depth01);
+    uint64_t depth = (uint64_t)(depth01 * (float)depth_max);
+    uint64_t state = ((uint64_t)(shader & 0xFF) << 28) | ((uint64_t)(material & 0xFFF) << 16) | (uint64_t)(mesh & 0xFFFF);
+    uint64_t key = (uint64_t)pass << 61;
+    if (pass == RENDER_PASS_TRANSPARENT)
+        key |= depth_first_bit | ((depth_max - depth) << 36) | state;
+    else if (front_to_back)
+        key |= depth_first_bit | (depth << 36) | state;
+    else
+        key |= (state << depth_bits) | depth;
+    return key;
+}
+
+uint64_t sort_key_batch_state(uint64_t key)
+{
+    uint64_t pass = key >> 61;
+    uint64_t state = (key & depth_first_bit) ? (key & 0xFFFFFFFFFull) : ((key >> depth_bits) & 0xFFFFFFFFFull);
+    return (pass << 36) | state;
+}
+
+uint32_t sort_key_mesh(uint64_t key)
+{
+    if (key & depth_first_bit)
+        return (uint32_t)(key & 0xFFFF);
+    return (uint32_t)((key >> depth_bits) & 0xFFFF);
+}
+
+uint32_t sort_key_material(uint64_t key)
+{
+    if (key & depth_first_bit)
+        return (uint32_t)((key >> 16) & 0xFFF);
+    return (uint32_t)((key >> (depth_bits + 16)) & 0xFFF);
+}
+
+// Below this many packets the single-threaded sort wins over the cost of waking workers
+static const size_t parallel_sort_threshold = 65536;
+
+void RenderQueue::sort()
+{
+    PROFILE_ZONE("Sort Queue");
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = packets.size();
+    if (count > 1)
+    {
+        // Find which key bytes actually differ; the rest would be no-op passes
+        uint64_t all_or = 0, all_and = ~0ull;
+        for (const DrawPacket& packet : packets)
+        {
+            all_or |= packet.key;
+            all_and &= packet.key;
+        }
+        uint64_t varying = all_or ^ all_and;
+        int digits[8];
+        int digit_count = 0;
+        for (int b = 0; b < 8; b++)
+            if ((varying >> (b * 8)) & 0xFF)
+                digits[digit_count++] = b;
+
+        scratch.resize(count);
+        DrawPacket* src = packets.data();
+        DrawPacket* dst = scratch.data();
+        JobSystem& jobs = job_system();
+        if (count < parallel_sort_threshold || jobs.thread_count() == 1)
+        {
+            // Build the histograms of every varying byte in one sweep (on the stack, so queues can
+            // sort concurrently)
+            uint32_t histograms[8][256];
+            memset(histograms, 0, sizeof(histograms));
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t key = src[i].key;
+                for (int d = 0; d < digit_count; d++)
+                    histograms[d][(key >> (digits[d] * 8)) & 0xFF]++;
+            }
+            for (int d = 0; d < digit_count; d++)
+            {
+                uint32_t offsets[256];
+                uint32_t sum = 0;
+                for (int i = 0; i < 256; i++)
+                {
+                    offsets[i] = sum;
+                    sum += histograms[d][i];
+                }
+                const int shift = digits[d] * 8;
+                for (size_t i = 0; i < count; i++)
+                    dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+                std::swap(src, dst);
+            }
+        }
+        else
+        {
+            // Each task owns a fixed contiguous chunk; bucket offsets are laid out bucket-major,
+            // task-minor so the scatter stays stable across chunks
+            const int tasks = jobs.thread_count();
+            const size_t chunk = (count + tasks - 1) / tasks;
+            chunk_histograms.resize((size_t)tasks * 256);
+            for (int d = 0; d < digit_count; d++)
+            {
+                const int shift = digits[d] * 8;
+                jobs.run_tasks(tasks, [&](int t)
+                {
+                    uint32_t* histogram = &chunk_histograms[(size_t)t * 256];
+                    memset(histogram, 0, 256 * sizeof(uint32_t));
+                    size_t begin = t * chunk, end = begin + chunk < count ? begin + chunk : count;
+                    for (size_t i = begin; i < end; i++)
+                        histogram[(src[i].key >> shift) & 0xFF]++;
+                });
+                uint32_t sum = 0;
+                for (int bucket = 0; bucket < 256; bucket++)
+                {
+                    for (int t = 0; t < tasks; t++)
+                    {
+                        uint32_t& slot = chunk_histograms[(size_t)t * 256 + bucket];
+                        uint32_t bucket_count = slot;
+                        slot = sum;
+                        sum += bucket_count;
+                    }
+                }
+                jobs.run_tasks(tasks, [&](int t)
+                {
+                    uint32_t* offsets = &chunk_histograms[(size_t)t * 256];
+                    size_t begin = t * chunk, end = begin + chunk < count ? begin + chunk : count;
+                    for (size_t i = begin; i < end; i++)
+                        dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+                });
+                std::swap(src, dst);
+            }
+        }
+        if (src != packets.data())
+            packets.swap(scratch);
+    }
+    sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
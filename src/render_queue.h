@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Render passes, in submission order (the pass is the most significant part of a sort key)
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_TRANSPARENT = 1
+};
+
+// A draw packet is a 64-bit sort key plus the index of the object it draws.
+//
+// Opaque key:               pass:3 | 0 | shader:8 | material:12 | mesh:16 | depth:24
+// Opaque front-to-back key: pass:3 | 1 | depth:24 | shader:8 | material:12 | mesh:16
+// Transparent key:          pass:3 | 1 | ~depth:24 | shader:8 | material:12 | mesh:16
+//
+// Opaque draws group by state first and go front-to-back within a state, unless strict
+// front-to-back order is requested (best early depth rejection, fewest merged batches);
+// transparent draws go strictly back-to-front (inverted depth) and only batch when neighbours
+// share state. Bit 60 records which layout a key uses.
+struct DrawPacket
+{
+    uint64_t key;
+    uint32_t payload;
+};
+
+// depth01 is the normalised view distance (0 = near plane, 1 = far plane). front_to_back only
+// affects opaque keys.
+uint64_t make_sort_key(RenderPass pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth01, bool front_to_back = false);
+
+inline RenderPass sort_key_pass(uint64_t key) { return (RenderPass)(key >> 61); }
+// Pass + shader + material + mesh with the depth removed; consecutive packets with equal
+// batch state can be drawn with one instanced call
+uint64_t sort_key_batch_state(uint64_t key);
+uint32_t sort_key_mesh(uint64_t key);
+uint32_t sort_key_material(uint64_t key);
+
+class RenderQueue
+{
+public:
+    void clear() { packets.clear(); }
+    void reserve(size_t count) { packets.reserve(count); }
+    void push(uint64_t key, uint32_t payload) { packets.push_back({ key, payload }); }
+
+    // Stable LSD radix sort on the keys, 8 bits per pass. Bytes that are equal across every key are
+    // skipped, and large queues split each pass across the job system's threads.
+    void sort();
+
+    std::vector<DrawPacket> packets;
+    double sort_ms = 0.0;       // Time taken by the last sort()
+
+private:
+    std::vector<DrawPacket> scratch;
+    std::vector<uint32_t> chunk_histograms;    // 256 buckets per sort task
+};
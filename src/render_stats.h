@@ -0,0 +1,21 @@
+#pragma once
+
+// Per-frame counters for the viewport renderer, reset at the start of every frame
+struct RenderStats
+{
+    int draw_calls = 0;
+    int instances = 0;
+    int material_binds = 0;     // Texture bindings between draws
+    long long triangles = 0;    // Submitted, at the LODs drawn (the pre-pass counts too)
+    int lod_objects[4] = {};    // Visible objects drawn at each LOD (see Mesh::max_lods)
+    double scene_cpu_ms = 0.0;  // CPU time spent building and submitting the scene
+    double sort_ms = 0.0;       // Part of scene_cpu_ms spent sorting the render queue
+    double cull_ms = 0.0;       // Part of scene_cpu_ms spent frustum culling
+    int culled = 0;             // Objects rejected by the frustum before reaching the queue
+    double occlusion_ms = 0.0;  // Part of scene_cpu_ms spent on Hi-Z tests
+    int occluded = 0;           // Frustum-visible objects rejected by the Hi-Z test
+    double light_ms = 0.0;      // Part of scene_cpu_ms spent binning and uploading lights
+    double shadow_ms = 0.0;     // Part of scene_cpu_ms spent picking shadow views and casters
+
+    void reset() { *this = RenderStats(); }
+};
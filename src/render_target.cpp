@@ -0,0 +1,114 @@
+#include "render_target.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+
+// Pool sizes are rounded up to this granularity, plus a quarter for growth
+static const int size_granularity = 64;
+
+static int pooled_size(int size, int max_size)
+{
+    int padded = size + size / 4;
+    padded = (padded + size_granularity - 1) / size_granularity * size_granularity;
+    return padded < max_size ? padded : max_size;
+}
+
+bool RenderTarget::init(GLenum format)
+{
+    colour_format = format;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    glGenFramebuffers(1, &framebuffer);
+    return framebuffer != 0;
+}
+
+void RenderTarget::shutdown()
+{
+    gl_state().forget_texture(colour_texture);
+    gl_state().forget_texture(depth_texture);
+    gl_state().forget_framebuffer(framebuffer);
+    glDeleteTextures(1, &colour_texture);
+    glDeleteTextures(1, &depth_texture);
+    glDeleteFramebuffers(1, &framebuffer);
+    colour_texture = depth_texture = framebuffer = 0;
+    width = height = alloc_width = alloc_height = 0;
+}
+
+bool RenderTarget::allocate(int w, int h)
+{
+    gl_state().forget_texture(colour_texture);
+    gl_state().forget_texture(depth_texture);
+    glDeleteTextures(1, &colour_texture);
+    glDeleteTextures(1, &depth_texture);
+
+    glGenTextures(1, &colour_texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, colour_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, colour_format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &depth_texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, depth_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Render target %dx%d incomplete (0x%x)\n", w, h, status);
+        return false;
+    }
+
+    alloc_width = w;
+    alloc_height = h;
+    reallocations++;
+    return true;
+}
+
+bool RenderTarget::resize(int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return false;
+    width = w = w < max_texture_size ? w : max_texture_size;
+    height = h = h < max_texture_size ? h : max_texture_size;
+
+    bool fits = w <= alloc_width && h <= alloc_height;
+    bool much_smaller = fits && (long long)w * h * 4 < (long long)alloc_width * alloc_height;
+    small_frames = much_smaller ? small_frames + 1 : 0;
+    if (fits && small_frames < shrink_delay)
+        return false;
+
+    int new_width = pooled_size(w, max_texture_size);
+    int new_height = pooled_size(h, max_texture_size);
+    if (fits)
+    {
+        // Shrinking: size to the request rather than keeping the larger of the two
+        small_frames = 0;
+    }
+    else
+    {
+        // Growing: never shrink the other axis at the same time
+        new_width = new_width > alloc_width ? new_width : alloc_width;
+        new_height = new_height > alloc_height ? new_height : alloc_height;
+    }
+    if (!allocate(new_width, new_height))
+    {
+        width = height = alloc_width = alloc_height = 0;
+        return false;
+    }
+    return true;
+}
+
+void RenderTarget::bind()
+{
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl_state().viewport(0, 0, width, height);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <glad/glad.h>
+
+// Offscreen colour + depth framebuffer for a viewport.
+//
+// The textures are pooled: they are allocated with headroom and any size that fits is rendered
+// into the lower-left corner of them, so dragging a dock splitter does not reallocate every
+// frame. They only grow when the requested size no longer fits, and only shrink once the
+// request has stayed well below the allocation for shrink_delay frames. Depth is a texture
+// rather than a renderbuffer so later passes can sample it.
+class RenderTarget
+{
+public:
+    static const int shrink_delay = 60;     // Frames below a quarter of the pooled area before shrinking
+
+    bool init(GLenum colour_format = GL_RGBA8);
+    void shutdown();
+
+    // Set the size to render at. Call before the colour texture is handed to ImGui for the
+    // frame, since a reallocation replaces it. Returns true if the textures were reallocated.
+    bool resize(int width, int height);
+
+    // Bind the framebuffer and set the viewport to the current size
+    void bind();
+
+    // Far corner of the rendered region in texture coordinates
+    float u_max() const { return alloc_width > 0 ? (float)width / alloc_width : 0.0f; }
+    float v_max() const { return alloc_height > 0 ? (float)height / alloc_height : 0.0f; }
+
+    GLuint framebuffer = 0;
+    GLuint colour_texture = 0;
+    GLuint depth_texture = 0;
+    GLenum colour_format = GL_RGBA8;
+    int width = 0, height = 0;              // Size being rendered
+    int alloc_width = 0, alloc_height = 0;  // Size of the textures
+    int reallocations = 0;                  // Since init, for the stats overlay
+
+private:
+    bool allocate(int width, int height);
+
+    int small_frames = 0;
+    GLint max_texture_size = 4096;
+};
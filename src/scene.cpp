@@ -0,0 +1,197 @@
+#include "scene.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+static const glm::vec4 default_object_colour = glm::vec4(0.639f, 0.816f, 0.988f, 1.0f);
+
+int Scene::add_object(const char* type_name, int mesh_id)
+{
+    char default_name[32];
+    snprintf(default_name, sizeof(default_name), "%s %d", type_name, next_id);
+    ids.push_back(next_id);
+    names.push_back(std::string(default_name));
+    positions.push_back(glm::vec3(0.0f));
+    rotations.push_back(glm::vec3(0.0f));
+    scales.push_back(glm::vec3(1.0f));
+    colours.push_back(default_object_colour);
+    mesh_ids.push_back(mesh_id);
+    texture_ids.push_back(-1);
+    selected.push_back(0);
+    is_static.push_back(0);
+    next_id++;
+    return size() - 1;
+}
+
+int Scene::duplicate_object(int index)
+{
+    int copy = add_object("", mesh_ids[index]);
+    names[copy] = names[index] + " copy";
+    positions[copy] = positions[index];
+    rotations[copy] = rotations[index];
+    scales[copy] = scales[index];
+    colours[copy] = colours[index];
+    texture_ids[copy] = texture_ids[index];
+    set_static(copy, is_static[index] != 0);
+    return copy;
+}
+
+void Scene::remove_object(int index)
+{
+    ids.erase(ids.begin() + index);
+    names.erase(names.begin() + index);
+    positions.erase(positions.begin() + index);
+    rotations.erase(rotations.begin() + index);
+    scales.erase(scales.begin() + index);
+    colours.erase(colours.begin() + index);
+    mesh_ids.erase(mesh_ids.begin() + index);
+    texture_ids.erase(texture_ids.begin() + index);
+    selected.erase(selected.begin() + index);
+    static_version += is_static[index];
+    is_static.erase(is_static.begin() + index);
+    layout_version++;
+}
+
+void Scene::clear()
+{
+    ids.clear();
+    names.clear();
+    positions.clear();
+    rotations.clear();
+    scales.clear();
+    colours.clear();
+    mesh_ids.clear();
+    texture_ids.clear();
+    selected.clear();
+    is_static.clear();
+    moved.clear();
+    layout_version++;
+    static_version++;
+}
+
+void Scene::mark_moved(int index)
+{
+    moved.push_back(index);
+    static_version += is_static[index];
+}
+
+void Scene::set_static(int index, bool value)
+{
+    if ((is_static[index] != 0) == value)
+        return;
+    is_static[index] = value ? 1 : 0;
+    static_version++;
+}
+
+void Scene::clear_selection()
+{
+    for (unsigned char& s : selected)
+        s = 0;
+}
+
+glm::mat4 Scene::object_transform(int index) const
+{
+    const glm::vec3& r = rotations[index];
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), positions[index]);
+    if (r.x != 0.0f) m = glm::rotate(m, glm::radians(r.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    if (r.y != 0.0f) m = glm::rotate(m, glm::radians(r.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    if (r.z != 0.0f) m = glm::rotate(m, glm::radians(r.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(m, scales[index]);
+}
+
+glm::mat4 Scene::animated_transform(int index, const glm::mat4& animation) const
+{
+    return is_static[index] ? object_transform(index) : object_transform(index) * animation;
+}
+
+void scene_add_stress_grid(Scene& scene, int count, const char* type_name, int mesh_id)
+{
+    // Lay the grid out so that it fits inside the default camera view
+    int side = (int)ceilf(sqrtf((float)count));
+    float spacing = 1.5f / (float)side;
+    for (int i = 0; i < count; i++)
+    {
+        int x = i % side;
+        int y = i / side;
+        int index = scene.add_object(type_name, mesh_id);
+        scene.positions[index] = glm::vec3((x + 0.5f) * spacing - 0.75f, (y + 0.5f) * spacing - 0.75f, 0.0f);
+        scene.scales[index] = glm::vec3(spacing * 0.8f);
+        // Vary the colour across the grid so individual instances are distinguishable
+        scene.colours[index] = glm::vec4((float)x / side, (float)y / side, 0.9f, 1.0f);
+    }
+}
+
+void scene_add_light_field(Scene& scene, int count, unsigned seed)
+{
+    // Fixed ranges rather than ones scaled by count, so the shading cost grows with the light count
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; i++)
+    {
+        Light light;
+        light.position = glm::vec3(unit(random) * 1.7f - 0.85f, unit(random) * 1.7f - 0.85f, 0.02f + unit(random) * 0.1f);
+        light.range = 0.04f + unit(random) * 0.06f;
+        // Saturated hues, so overlapping lights stay tellable apart
+        float hue = unit(random) * 6.0f;
+        light.colour = glm::clamp(glm::vec3(fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)), 0.0f, 1.0f);
+        light.intensity = 0.6f;
+        if (i % 4 == 3)
+        {
+            // Every fourth light is a spot pointing down at the grid
+            light.type = LIGHT_SPOT;
+            light.range *= 1.5f;
+            light.direction = glm::normalize(glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, -2.0f));
+            light.intensity = 1.2f;
+        }
+        scene.lights.push_back(light);
+    }
+}
+
+void scene_add_shadow_test(Scene& scene, int count, int sphere_mesh)
+{
+    // A static ground and sphere grid, drawn into the shadow caches once
+    int ground = scene.add_object("Ground");
+    scene.positions[ground] = glm::vec3(0.0f, 0.0f, -0.15f);
+    scene.scales[ground] = glm::vec3(2.5f);
+    scene.colours[ground] = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+    scene_add_stress_grid(scene, count, "Sphere", sphere_mesh);
+    for (int i = ground; i < scene.size(); i++)
+        scene.set_static(i, true);
+
+    // A ring of spinning quads above it: the only casters redrawn every frame
+    for (int k = 0; k < 8; k++)
+    {
+        float angle = (float)k * 0.785398f;
+        int index = scene.add_object("Triangle");
+        scene.positions[index] = glm::vec3(cosf(angle) * 0.5f, sinf(angle) * 0.5f, 0.3f);
+        scene.scales[index] = glm::vec3(0.2f);
+        scene.colours[index] = glm::vec4(1.0f, 0.5f, 0.2f, 1.0f);
+    }
+
+    // Two shadowed spots looking in from above, a shadowed point light in the middle and the sun
+    scene.lights.clear();
+    for (int k = 0; k < 2; k++)
+    {
+        Light spot;
+        spot.type = LIGHT_SPOT;
+        spot.position = glm::vec3(k == 0 ? -0.6f : 0.6f, 0.6f, 0.8f);
+        spot.direction = glm::normalize(glm::vec3(0.0f, 0.0f, -0.15f) - spot.position);
+        spot.colour = k == 0 ? glm::vec3(1.0f, 0.6f, 0.4f) : glm::vec3(0.4f, 0.6f, 1.0f);
+        spot.intensity = 1.5f;
+        spot.range = 2.0f;
+        spot.inner_angle = 25.0f;
+        spot.outer_angle = 35.0f;
+        spot.shadows = true;
+        scene.lights.push_back(spot);
+    }
+    Light point;
+    point.position = glm::vec3(0.0f, 0.0f, 0.12f);
+    point.colour = glm::vec3(1.0f, 0.9f, 0.6f);
+    point.intensity = 1.5f;
+    point.range = 0.6f;
+    point.shadows = true;
+    scene.lights.push_back(point);
+    scene.sun.enabled = true;
+}
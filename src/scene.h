@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+enum LightType
+{
+    LIGHT_POINT,
+    LIGHT_SPOT
+};
+
+// Punctual light. Its influence ends smoothly at range, which is also the bound the renderer
+// bins it with (see light_clusters.h); spot lights only shine within outer_angle of direction.
+struct Light
+{
+    LightType type = LIGHT_POINT;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 colour = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float range = 1.0f;
+    float inner_angle = 20.0f;  // Spot cone half-angles in degrees, full strength inside inner
+    float outer_angle = 30.0f;
+    bool shadows = false;       // Gets a tile (spot) or six (point) in the shadow atlas
+};
+
+// Directional light with cascaded shadows
+struct SunLight
+{
+    bool enabled = false;
+    bool shadows = true;
+    glm::vec3 direction = glm::normalize(glm::vec3(-0.4f, -0.5f, -1.0f));  // Direction the light travels
+    glm::vec3 colour = glm::vec3(1.0f, 0.95f, 0.85f);
+    float intensity = 1.0f;
+};
+
+// Scene objects are stored as parallel vectors: every vector has one entry per object,
+// and the same index refers to the same object in all of them.
+struct Scene
+{
+    std::vector<int> ids;
+    std::vector<std::string> names;     // Persistent names (so InputText has stable storage)
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> rotations;   // Euler angles in degrees
+    std::vector<glm::vec3> scales;
+    std::vector<glm::vec4> colours;
+    std::vector<int> mesh_ids;          // Index into the renderer's mesh list
+    std::vector<int> texture_ids;       // Streamed texture (see texture_streaming.h), -1 for none
+    std::vector<unsigned char> selected;
+    std::vector<unsigned char> is_static;   // Not animated, and cached in the shadow maps
+    int next_id = 0;
+
+    // Lights are not objects and are not part of the parallel vectors above
+    std::vector<Light> lights;
+    SunLight sun;
+
+    // Change tracking for spatial structures (see scene_bvh.h). Appending objects keeps existing
+    // indices valid; removing or clearing bumps layout_version because indices shift.
+    std::vector<int> moved;             // Objects whose transform or mesh changed since the last sync
+    unsigned layout_version = 0;
+    // Bumped whenever the set of static objects or one of their transforms/meshes changes;
+    // cached static shadows are redrawn when it moves
+    unsigned static_version = 0;
+
+    int size() const { return (int)ids.size(); }
+
+    // Append a default object named "<type_name> <id>" and return its index
+    int add_object(const char* type_name, int mesh_id = 0);
+    // Append a copy of the object at index, with a new id and named "<name> copy", and return its index
+    int duplicate_object(int index);
+    void remove_object(int index);
+    // Remove every object (lights are kept)
+    void clear();
+
+    // Call after editing an object's position, rotation, scale or mesh
+    void mark_moved(int index);
+    void set_static(int index, bool value);
+    void clear_selection();
+
+    // World transform of one object (translation * rotation * scale)
+    glm::mat4 object_transform(int index) const;
+    // As drawn: animation applied in the object's local space, except for static objects
+    glm::mat4 animated_transform(int index, const glm::mat4& animation) const;
+};
+
+// Fill the scene with a square grid of small objects, used to stress test the renderer
+void scene_add_stress_grid(Scene& scene, int count, const char* type_name, int mesh_id = 0);
+// Scatter count small point and spot lights just above the stress grid, for the lighting benchmark
+void scene_add_light_field(Scene& scene, int count, unsigned seed = 1);
+// Shadow benchmark: a static ground and grid of count spheres, a few spinning quads, shadowed
+// lights and the sun (replaces the scene's lights)
+void scene_add_shadow_test(Scene& scene, int count, int sphere_mesh);
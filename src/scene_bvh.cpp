@@ -0,0 +1,143 @@
+#include "scene_bvh.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+
+static void object_bounds(const Scene& scene, const std::vector<Mesh>& meshes, int index, glm::vec3& lo, glm::vec3& hi)
+{
+    const Mesh& mesh = meshes[scene.mesh_ids[index]];
+    glm::mat4 transform = scene.object_transform(index);
+    glm::vec3 origin = glm::vec3(transform[3]);
+    float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    float radius = (glm::length(mesh.bounds_centre) + mesh.bounds_radius) * scale;
+    lo = origin - glm::vec3(radius);
+    hi = origin + glm::vec3(radius);
+}
+
+void SceneBvh::rebuild(const Scene& scene, const std::vector<Mesh>& meshes)
+{
+    auto start = std::chrono::steady_clock::now();
+    const int count = scene.size();
+    std::vector<glm::vec3> lo(count), hi(count);
+    job_system().parallel_for(count, 16384, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            object_bounds(scene, meshes, i, lo[i], hi[i]);
+    });
+    bvh.build(lo, hi);
+
+    stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.rebuilds++;
+    stats.refits = 0;
+    stats.inserts = 0;
+    edits_since_check = 0;
+    layout_version = scene.layout_version;
+}
+
+void SceneBvh::sync(Scene& scene, const std::vector<Mesh>& meshes)
+{
+    const int count = scene.size();
+    const int known = bvh.item_count();
+    if (scene.layout_version != layout_version || count < known)
+    {
+        rebuild(scene, meshes);
+        scene.moved.clear();
+        return;
+    }
+    if (count > known)
+    {
+        // A handful of new objects go in one by one; a bulk add is cheaper as a fresh build
+        if (count - known > std::max(1024, known / 4))
+        {
+            rebuild(scene, meshes);
+            scene.moved.clear();
+            return;
+        }
+        for (int i = known; i < count; i++)
+        {
+            glm::vec3 lo, hi;
+            object_bounds(scene, meshes, i, lo, hi);
+            bvh.insert(lo, hi);
+        }
+        stats.inserts += count - known;
+        edits_since_check += count - known;
+    }
+
+    for (int i : scene.moved)
+    {
+        if (i < 0 || i >= count)
+            continue;
+        glm::vec3 lo, hi;
+        object_bounds(scene, meshes, i, lo, hi);
+        bvh.update(i, lo, hi);
+        stats.refits++;
+        edits_since_check++;
+    }
+    scene.moved.clear();
+
+    // Measuring the tree is O(nodes), so only do it after a batch of edits
+    if (edits_since_check > std::max(64, count / 32))
+    {
+        edits_since_check = 0;
+        if (bvh.sah_cost() > bvh.build_cost * rebuild_threshold)
+            rebuild(scene, meshes);
+    }
+}
+
+// Möller-Trumbore; t along the ray or -1
+static float ray_triangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 e1 = b - a;
+    glm::vec3 e2 = c - a;
+    glm::vec3 p = glm::cross(direction, e2);
+    float det = glm::dot(e1, p);
+    if (fabsf(det) < 1e-12f)
+        return -1.0f;
+    float inv_det = 1.0f / det;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(direction, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+    float t = glm::dot(e2, q) * inv_det;
+    return t >= 0.0f ? t : -1.0f;
+}
+
+int SceneBvh::pick(const Scene& scene, const std::vector<Mesh>& meshes, const glm::mat4& animation,
+                   const glm::vec3& origin, const glm::vec3& direction, float& hit_t) const
+{
+    return bvh.raycast(origin, direction, 1e30f, [&](int item, float best_t)
+    {
+        // Test in object space; an affine transform keeps the ray parameter, so t carries over
+        glm::mat4 to_local = glm::inverse(scene.animated_transform(item, animation));
+        glm::vec3 local_origin = glm::vec3(to_local * glm::vec4(origin, 1.0f));
+        glm::vec3 local_direction = glm::vec3(to_local * glm::vec4(direction, 0.0f));
+        const Mesh& mesh = meshes[scene.mesh_ids[item]];
+        float nearest = -1.0f;
+        for (size_t k = 0; k + 2 < mesh.indices.size(); k += 3)
+        {
+            float t = ray_triangle(local_origin, local_direction, mesh.positions[mesh.indices[k]],
+                                   mesh.positions[mesh.indices[k + 1]], mesh.positions[mesh.indices[k + 2]]);
+            if (t >= 0.0f && t < best_t && (nearest < 0.0f || t < nearest))
+                nearest = t;
+        }
+        return nearest;
+    }, hit_t);
+}
+
+Frustum sub_frustum(const glm::mat4& view_projection, const glm::vec2& ndc_min, const glm::vec2& ndc_max)
+{
+    // Stretch the rectangle over the whole of clip space, then take that frustum's planes
+    glm::vec2 size = glm::max(ndc_max - ndc_min, glm::vec2(1e-6f));
+    glm::vec2 centre = (ndc_min + ndc_max) * 0.5f;
+    glm::mat4 zoom(1.0f);
+    zoom[0][0] = 2.0f / size.x;
+    zoom[1][1] = 2.0f / size.y;
+    zoom[3][0] = -centre.x * 2.0f / size.x;
+    zoom[3][1] = -centre.y * 2.0f / size.y;
+    return extract_frustum(zoom * view_projection);
+}
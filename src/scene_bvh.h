@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "mesh.h"
+#include "scene.h"
+
+// Keeps a Bvh over a Scene's objects in step with edits, and answers the editor's spatial
+// queries (viewport culling, click picking, marquee selection).
+//
+// An object's box bounds the sphere its mesh sweeps under any rotation about the object origin,
+// so the viewport's spin animation never needs a refit; only real edits (Scene::mark_moved)
+// do. Appended objects are inserted incrementally, removals rebuild (indices shift), and a
+// rebuild also happens once refits and inserts push the SAH cost past rebuild_threshold times
+// the cost straight after the last build.
+class SceneBvh
+{
+public:
+    struct Stats
+    {
+        double build_ms = 0.0;      // Last full build
+        int rebuilds = 0;
+        int refits = 0;             // Since the last build
+        int inserts = 0;            // Since the last build
+    };
+
+    void sync(Scene& scene, const std::vector<Mesh>& meshes);
+
+    // Nearest object whose triangles the ray hits, with each object drawn as
+    // Scene::animated_transform(animation); -1 if none. hit_t is in units of direction.
+    int pick(const Scene& scene, const std::vector<Mesh>& meshes, const glm::mat4& animation,
+             const glm::vec3& origin, const glm::vec3& direction, float& hit_t) const;
+
+    // Objects whose bounds intersect the frustum (e.g. a marquee's sub-frustum)
+    void select(const Frustum& frustum, std::vector<uint32_t>& out) const { bvh.query_frustum(frustum, out); }
+
+    Bvh bvh;
+    Stats stats;
+    float rebuild_threshold = 1.3f;
+
+private:
+    void rebuild(const Scene& scene, const std::vector<Mesh>& meshes);
+
+    unsigned layout_version = ~0u;
+    int edits_since_check = 0;
+};
+
+// Frustum of the part of view_projection's clip space covered by an NDC rectangle
+Frustum sub_frustum(const glm::mat4& view_projection, const glm::vec2& ndc_min, const glm::vec2& ndc_max);
@@ -0,0 +1,599 @@
+#include "scene_renderer.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "fullscreen_pass.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+
+#include <stdio.h>
+#include <chrono>
+
+bool SceneRenderer::init(ShaderManager& shaders)
+{
+    // The placeholder is built up front so there is always something to draw with; the real
+    // program compiles in the background and replaces it once it has linked
+    shader_manager = &shaders;
+    GLuint placeholder = shaders.load_program("scene.vert", "placeholder.frag");
+    if (!placeholder)
+        return false;
+    shaders.set_placeholder(placeholder);
+    scene_shader = shaders.request_program("scene.vert", "scene.frag");
+    depth_shader = shaders.request_program("scene.vert", "depth_only.frag");
+    overdraw_shader = shaders.request_program("scene.vert", "overdraw.frag");
+    gbuffer_shader = shaders.request_program("scene.vert", "scene.frag", { "GBUFFER" });
+    lighting_shader = shaders.request_program("fullscreen.vert", "deferred_lighting.frag");
+
+    frame_uniforms.init();
+    instance_buffer.init();
+    samples_query.init(GL_SAMPLES_PASSED);
+    lights.init();
+    gbuffer.init();
+    textures.init();
+    if (!shadows.init())
+    {
+        fprintf(stderr, "Shadow maps failed to initialise, shadows are disabled\n");
+        shadows.enabled = false;
+    }
+    if (!occlusion.init(shaders))
+        fprintf(stderr, "Hi-Z shader failed to build, occlusion culling will not reject anything\n");
+    return true;
+}
+
+void SceneRenderer::shutdown()
+{
+    for (Mesh& mesh : meshes)
+        mesh.shutdown();
+    meshes.clear();
+    instance_buffer.shutdown();
+    frame_uniforms.shutdown();
+    samples_query.shutdown();
+    occlusion.shutdown();
+    lights.shutdown();
+    gbuffer.shutdown();
+    shadows.shutdown();
+    textures.shutdown();
+    shader_manager = nullptr;   // Programs are owned by the ShaderManager
+    block_bound_programs.clear();
+}
+
+int SceneRenderer::add_mesh(const MeshData& data)
+{
+    Mesh mesh;
+    mesh.upload(data, vertex_format);
+    instance_buffer.attach(mesh.vao, MESH_ATTRIB_INSTANCE);
+    meshes.push_back(mesh);
+    return (int)meshes.size() - 1;
+}
+
+void SceneRenderer::apply_pass_state(RenderPass pass)
+{
+    // Opaque fragments after a pre-pass only shade where they won the depth test already
+    bool after_prepass = pass == RENDER_PASS_OPAQUE && prepass_active;
+    gl_state().set_depth_test(depth_test);
+    gl_state().depth_func(after_prepass ? GL_EQUAL : GL_LESS);
+    gl_state().depth_mask(pass == RENDER_PASS_OPAQUE && !after_prepass);
+
+    if (overdraw_view)
+    {
+        gl_state().set_blend(true);
+        gl_state().blend_func(GL_ONE, GL_ONE);
+    }
+    else if (pass == RENDER_PASS_TRANSPARENT)
+    {
+        gl_state().set_blend(true);
+        gl_state().blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+    {
+        gl_state().set_blend(false);
+    }
+}
+
+void SceneRenderer::use_program(ShaderHandle handle)
+{
+    GLuint program = shader_manager->program(handle);
+    gl_state().use_program(program);
+    bool bound = false;
+    for (GLuint p : block_bound_programs)
+        bound |= p == program;
+    if (!bound)
+    {
+        FrameUniformBuffer::bind_block(program);
+        LightClusters::bind_samplers(program);
+        ShadowMaps::bind_program(program);
+        TextureStreamer::bind_samplers(program);
+        block_bound_programs.push_back(program);
+        if (handle == lighting_shader)
+        {
+            // The G-buffer inputs (uAlbedo here is not the material unit bind_samplers gave it)
+            glUniform1i(glGetUniformLocation(program, "uAlbedo"), 0);
+            glUniform1i(glGetUniformLocation(program, "uNormal"), 1);
+            glUniform1i(glGetUniformLocation(program, "uDepth"), 2);
+            inverse_projection_location = glGetUniformLocation(program, "uInverseProjection");
+        }
+    }
+}
+
+void SceneRenderer::render(const Scene& scene, const SceneView& view, const glm::mat4& animation, const RenderTarget& target)
+{
+    auto start = std::chrono::steady_clock::now();
+    stats.reset();
+
+    const int object_count = scene.size();
+    const Frustum frustum = extract_frustum(view.projection * view.view);
+    world_transforms.resize(object_count);
+    CullMode mode = cull_mode;
+    if (mode == CULL_BVH && (!bvh || bvh->item_count() != object_count))
+        mode = CULL_SPHERES;
+
+    if (mode == CULL_BVH)
+    {
+        // The tree's boxes already cover any spin about the object origin, so query first and
+        // only build transforms for what survives
+        PROFILE_ZONE("Cull");
+        auto cull_start = std::chrono::steady_clock::now();
+        bvh->query_frustum(frustum, visible);
+        stats.cull_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cull_start).count();
+        job_system().parallel_for((int)visible.size(), 16384, [&](int begin, int end)
+        {
+            for (int k = begin; k < end; k++)
+            {
+                uint32_t i = visible[k];
+                world_transforms[i] = scene.animated_transform(i, animation);
+            }
+        });
+    }
+    else
+    {
+        PROFILE_ZONE("Cull");
+        // World transforms and bounding spheres, split across the workers for big scenes
+        bounds.resize(object_count);
+        job_system().parallel_for(object_count, 16384, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                glm::mat4& world = world_transforms[i] = scene.animated_transform(i, animation);
+                const Mesh& mesh = meshes[scene.mesh_ids[i]];
+                glm::vec3 centre = glm::vec3(world * glm::vec4(mesh.bounds_centre, 1.0f));
+                float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                bounds.set(i, centre, mesh.bounds_radius * scale);
+            }
+        });
+
+        // Only objects whose spheres touch the view frustum go into the queue
+        if (mode == CULL_SPHERES)
+        {
+            culler.cull(frustum, bounds, visible);
+            stats.cull_ms = culler.cull_ms;
+        }
+        else
+        {
+            visible.resize(object_count);
+            for (int i = 0; i < object_count; i++)
+                visible[i] = (uint32_t)i;
+        }
+    }
+    stats.culled = object_count - (int)visible.size();
+
+    // Occlusion: test what survived the frustum against the Hi-Z of an earlier frame
+    if (occlusion_culling && depth_test)
+    {
+        PROFILE_ZONE("Occlusion Cull");
+        auto occlusion_start = std::chrono::steady_clock::now();
+        occlusion.update();
+        if (occlusion.ready())
+        {
+            occluded.resize(visible.size());
+            job_system().parallel_for((int)visible.size(), 4096, [&](int begin, int end)
+            {
+                for (int k = begin; k < end; k++)
+                {
+                    uint32_t i = visible[k];
+                    const glm::mat4& world = world_transforms[i];
+                    const Mesh& mesh = meshes[scene.mesh_ids[i]];
+                    glm::vec3 centre = glm::vec3(world * glm::vec4(mesh.bounds_centre, 1.0f));
+                    float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                    glm::vec3 extent = glm::vec3(mesh.bounds_radius * scale);
+                    occluded[k] = occlusion.is_occluded(centre - extent, centre + extent);
+                }
+            });
+            size_t kept = 0;
+            for (size_t k = 0; k < visible.size(); k++)
+            {
+                visible[kept] = visible[k];
+                kept += !occluded[k];
+            }
+            stats.occluded = (int)(visible.size() - kept);
+            visible.resize(kept);
+        }
+        stats.occlusion_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - occlusion_start).count();
+    }
+    else if (occlusion.ready())
+    {
+        // The depth stops being written (or used), so the pyramid goes stale
+        occlusion.reset();
+    }
+    const int count = (int)visible.size();
+
+    // Per-object LODs persist between frames for the hysteresis; indices shift on removal
+    if ((int)object_lods.size() != object_count || lod_layout_version != scene.layout_version)
+    {
+        object_lods.assign(object_count, 0);
+        lod_layout_version = scene.layout_version;
+    }
+    // Pixels per world unit at view depth 1
+    const float pixels_per_unit = view.projection[1][1] * 0.5f * (float)view.height;
+
+    // Build the queue: one packet per visible object, keyed by pass/shader/material/mesh LOD/view
+    // depth. The key's mesh field holds mesh * Mesh::max_lods + lod, so each LOD batches separately;
+    // the material is the object's texture, or its pool page (0 for none). The same screen size that
+    // picks the LOD tells the texture streamer how much of each texture is needed.
+    queue.clear();
+    queue.reserve(count);
+    textures.begin_frame();
+    const float depth_range = view.far_plane - view.near_plane;
+    for (uint32_t i : visible)
+    {
+        const glm::mat4& world = world_transforms[i];
+        float view_depth = -(view.view * world[3]).z;
+        const Mesh& mesh = meshes[scene.mesh_ids[i]];
+        const int texture = scene.texture_ids[i];
+        int lod = 0;
+        if ((lod_enabled && mesh.lods.size() > 1) || texture >= 0)
+        {
+            float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+            float pixels = scale * pixels_per_unit / glm::max(view_depth, view.near_plane);
+            if (lod_enabled && mesh.lods.size() > 1)
+            {
+                lod = select_lod(mesh, pixels, object_lods[i]);
+                object_lods[i] = (unsigned char)lod;
+            }
+            if (texture >= 0)
+                textures.request(texture, pixels);
+        }
+        stats.lod_objects[lod]++;
+
+        RenderPass pass = scene.colours[i].a < 1.0f ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+        float depth01 = (view_depth - view.near_plane) / depth_range;
+        uint32_t mesh_lod = (uint32_t)(scene.mesh_ids[i] * Mesh::max_lods + lod);
+        queue.push(make_sort_key(pass, 0, textures.material(texture, texture_batching), mesh_lod, depth01, front_to_back), i);
+    }
+    queue.sort();
+    stats.sort_ms = queue.sort_ms;
+
+    // Stream texture levels for this frame's demand; finished uploads are used straight away
+    textures.update();
+
+    // Shadow views and their casters; the lights need to know which atlas tiles they got
+    shadows.prepare(scene, meshes, bvh, object_lods, view, animation, light_transform,
+                    shader_manager->is_ready(depth_shader));
+    stats.shadow_ms = shadows.stats.prepare_ms;
+
+    // Bin the lights for this view; the shading pass reads the lists per fragment
+    lights.update(scene.lights, light_transform, view, &shadows.light_tiles);
+    stats.light_ms = lights.stats.assign_ms + lights.stats.upload_ms;
+
+    // Camera state is uploaded once per view and shared by every program through the UBO
+    FrameUniforms uniforms;
+    uniforms.view = view.view;
+    uniforms.projection = view.projection;
+    uniforms.view_projection = view.projection * view.view;
+    last_view_projection = uniforms.view_projection;
+    uniforms.camera_position = glm::inverse(view.view)[3];
+    uniforms.viewport_size = glm::vec4((float)view.width, (float)view.height, 1.0f / (float)view.width, 1.0f / (float)view.height);
+    uniforms.time = glm::vec4(view.time, 0.0f, 0.0f, 0.0f);
+    lights.uniforms(uniforms.cluster_grid, uniforms.cluster_depth);
+    uniforms.lighting = glm::vec4(scene.lights.empty() && !scene.sun.enabled ? 1.0f : ambient, light_heat_view ? 1.0f : 0.0f, 0.0f, 0.0f);
+    uniforms.sun_direction = glm::vec4(0.0f);
+    uniforms.sun_colour = glm::vec4(0.0f);
+    if (scene.sun.enabled)
+    {
+        uniforms.sun_direction = glm::vec4(glm::normalize(glm::vec3(view.view * glm::vec4(scene.sun.direction, 0.0f))), shadows.uniforms.params.x > 0.0f ? 1.0f : 0.0f);
+        uniforms.sun_colour = glm::vec4(scene.sun.colour * scene.sun.intensity, 1.0f);
+    }
+    frame_uniforms.begin_frame(1 + (int)shadows.passes.size());
+
+    // Instances are written in queue order, so every run of equal state is contiguous; the
+    // shadow casters follow
+    const std::vector<DrawPacket>& packets = queue.packets;
+    InstanceData* instances = instance_buffer.map(count + shadows.instance_count());
+    for (int k = 0; k < count; k++)
+    {
+        uint32_t i = packets[k].payload;
+        glm::vec4 texture_rect;
+        float texture_layer;
+        textures.instance_slot(scene.texture_ids[i], texture_rect, texture_layer);
+        pack_instance(instances[k], world_transforms[i], scene.selected[i] ? highlight_colour : scene.colours[i], texture_rect, texture_layer);
+    }
+    shadows.write_instances(instances + count, scene, animation);
+    instance_buffer.unmap();
+
+    // Shadow passes go first, into their own framebuffers; the view's block is pushed after them
+    if (!shadows.passes.empty())
+    {
+        gpu_profiler().begin_pass("Shadows");
+        render_shadows(uniforms, count);
+        gpu_profiler().end_pass();
+        gl_state().bind_framebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        gl_state().viewport(0, 0, view.width, view.height);
+    }
+    frame_uniforms.push(uniforms);
+
+    // Opaque packets sort ahead of transparent ones
+    int opaque_count = 0;
+    while (opaque_count < count && sort_key_pass(packets[opaque_count].key) == RENDER_PASS_OPAQUE)
+        opaque_count++;
+
+    // The deferred path needs the depth buffer to rebuild positions; the heat view is forward only
+    deferred_active = path == RENDER_PATH_DEFERRED && depth_test && !overdraw_view &&
+                      shader_manager->is_ready(gbuffer_shader) && shader_manager->is_ready(lighting_shader) &&
+                      gbuffer.attach(target);
+    if (deferred_active)
+        gbuffer.bind(target);
+
+    gl_state().polygon_mode(wireframe ? GL_LINE : GL_FILL);
+
+    // Depth-only pass over the opaque packets, so the shading pass below runs each covered
+    // pixel's fragment shader once instead of once per overlapping surface
+    // prepass_active only turns on once the pre-pass has drawn, so the pre-pass's own batches keep
+    // GL_LESS with depth writes and the later opaque passes test GL_EQUAL against its depth
+    prepass_active = false;
+    const bool prepass = depth_prepass && depth_test && opaque_count > 0 && shader_manager->is_ready(depth_shader);
+    if (prepass)
+    {
+        gpu_profiler().begin_pass("Depth Pre-pass");
+        gl_state().set_depth_test(true);
+        gl_state().depth_func(GL_LESS);
+        gl_state().depth_mask(true);
+        gl_state().set_blend(false);
+        gl_state().colour_mask(false);
+        use_program(depth_shader);
+        submit(0, opaque_count);
+        gl_state().colour_mask(true);
+        gpu_profiler().end_pass();
+        prepass_active = true;
+    }
+
+    // Shading pass; samples passed here over the pixel count is the overdraw ratio. On the
+    // deferred path that is the G-buffer pass, and the transparent packets are not counted.
+    lights.bind();
+    shadows.bind();
+    samples_query.begin();
+    if (deferred_active)
+    {
+        gpu_profiler().begin_pass("G-Buffer");
+        use_program(gbuffer_shader);
+        submit(0, opaque_count);
+        samples_query.end();
+        gpu_profiler().end_pass();
+
+        // Light every pixel the G-buffer covers once, into the target's colour
+        gpu_profiler().begin_pass("Lighting");
+        gbuffer.bind_lighting(target);
+        gl_state().polygon_mode(GL_FILL);
+        gl_state().set_depth_test(false);
+        gl_state().depth_mask(false);
+        gl_state().set_blend(false);
+        use_program(lighting_shader);
+        gl_state().bind_texture(0, GL_TEXTURE_2D, gbuffer.albedo_texture);
+        gl_state().bind_texture(1, GL_TEXTURE_2D, gbuffer.normal_texture);
+        gl_state().bind_texture(2, GL_TEXTURE_2D, target.depth_texture);
+        glm::mat4 inverse_projection = glm::inverse(view.projection);
+        glUniformMatrix4fv(inverse_projection_location, 1, GL_FALSE, &inverse_projection[0][0]);
+        draw_fullscreen_triangle();
+        gl_state().bind_texture(2, GL_TEXTURE_2D, 0);   // The depth is attached again below
+        gpu_profiler().end_pass();
+
+        // Transparent objects blend over the lit result, tested against the G-buffer's depth
+        gl_state().bind_framebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        if (opaque_count < count)
+        {
+            gpu_profiler().begin_pass("Transparent");
+            gl_state().polygon_mode(wireframe ? GL_LINE : GL_FILL);
+            use_program(scene_shader);
+            submit(opaque_count, count);
+            gpu_profiler().end_pass();
+        }
+    }
+    else
+    {
+        gpu_profiler().begin_pass("Shading");
+        use_program(overdraw_view ? overdraw_shader : scene_shader);
+        submit(0, count);
+        samples_query.end();
+        gpu_profiler().end_pass();
+    }
+
+    GLuint64 samples = 0;
+    if (samples_query.poll(samples))
+    {
+        const double pixels = (double)view.width * view.height;
+        shaded_samples = (double)samples;
+        overdraw = (float)(shaded_samples / pixels);
+        // Every opaque packet drawn in the pre-pass must also pass GL_EQUAL in the shading pass
+        prepass_lost_opaque = prepass && samples == 0;
+        framebuffer_bytes = shaded_samples * (deferred_active ? GBuffer::bytes_per_pixel + 4 : 4 + 4);
+        if (deferred_active)
+            framebuffer_bytes += pixels * (GBuffer::bytes_per_pixel + 4 + 4);
+    }
+
+    gl_state().bind_vertex_array(0);
+    gl_state().set_blend(false);
+    gl_state().depth_mask(true);
+    gl_state().depth_func(GL_LESS);
+    instance_buffer.end_frame();
+    frame_uniforms.end_frame();
+
+    stats.scene_cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SceneRenderer::render_shadows(FrameUniforms uniforms, int first_instance)
+{
+    // Depth only, biased by slope so lit surfaces do not shadow themselves
+    use_program(depth_shader);
+    gl_state().polygon_mode(GL_FILL);
+    gl_state().set_depth_test(true);
+    gl_state().depth_func(GL_LESS);
+    gl_state().depth_mask(true);
+    gl_state().set_blend(false);
+    gl_state().colour_mask(false);
+    gl_state().set_scissor_test(false);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(shadows.offset_factor, shadows.offset_units);
+
+    const Mesh* bound_mesh = nullptr;
+    for (const ShadowMaps::Pass& pass : shadows.passes)
+    {
+        // A dynamic layer starts as a copy of its cached static layer
+        if (pass.copy_from)
+        {
+            gl_state().bind_framebuffer(GL_READ_FRAMEBUFFER, pass.copy_from);
+            gl_state().bind_framebuffer(GL_DRAW_FRAMEBUFFER, pass.framebuffer);
+            glBlitFramebuffer(pass.copy_x, pass.copy_y, pass.copy_x + pass.size, pass.copy_y + pass.size,
+                              pass.x, pass.y, pass.x + pass.size, pass.y + pass.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        gl_state().bind_framebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        gl_state().viewport(pass.x, pass.y, pass.size, pass.size);
+        if (pass.clear)
+        {
+            // Atlas tiles share a framebuffer, so only this one's rectangle is cleared
+            gl_state().set_scissor_test(true);
+            gl_state().scissor(pass.x, pass.y, pass.size, pass.size);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            gl_state().set_scissor_test(false);
+        }
+        if (pass.depth_clamp)
+            glEnable(GL_DEPTH_CLAMP);
+        else
+            glDisable(GL_DEPTH_CLAMP);
+        uniforms.view_projection = pass.view_projection;
+        frame_uniforms.push(uniforms);
+
+        // Runs of equal mesh/LOD are one instanced draw each
+        const int end = pass.first_caster + pass.caster_count;
+        for (int first = pass.first_caster; first < end; )
+        {
+            uint32_t mesh_lod = shadows.caster_keys[first];
+            int last = first + 1;
+            while (last < end && shadows.caster_keys[last] == mesh_lod)
+                last++;
+            const Mesh& mesh = meshes[mesh_lod / Mesh::max_lods];
+            const int lod = glm::min((int)(mesh_lod % Mesh::max_lods), (int)mesh.lods.size() - 1);
+            if (&mesh != bound_mesh)
+            {
+                mesh.bind();
+                bound_mesh = &mesh;
+            }
+            instance_buffer.set_first_instance(MESH_ATTRIB_INSTANCE, first_instance + first);
+            mesh.draw_instanced(last - first, lod);
+            stats.draw_calls++;
+            stats.instances += last - first;
+            stats.triangles += (long long)(last - first) * (mesh.lods[lod].index_count / 3);
+            first = last;
+        }
+    }
+
+    glDisable(GL_DEPTH_CLAMP);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    gl_state().colour_mask(true);
+}
+
+void SceneRenderer::capture_occluders(const RenderTarget& target)
+{
+    if (occlusion_culling && depth_test)
+        occlusion.capture(target, last_view_projection);
+}
+
+int SceneRenderer::select_lod(const Mesh& mesh, float pixels_per_mesh_unit, int current) const
+{
+    // Coarsest level whose error stays under lod_pixel_error on screen. Switching to a coarser
+    // level than the current one needs the error to be a margin below the limit, so an object
+    // hovering around a threshold does not flip between levels every frame.
+    int lod = 0;
+    for (int l = 1; l < (int)mesh.lods.size(); l++)
+    {
+        float limit = l > current ? lod_pixel_error * (1.0f - lod_hysteresis) : lod_pixel_error;
+        if (mesh.lods[l].error * pixels_per_mesh_unit > limit)
+            break;
+        lod = l;
+    }
+    return lod;
+}
+
+void SceneRenderer::submit(int begin, int end)
+{
+    PROFILE_ZONE("Submit Draws");
+    if (instancing)
+        submit_instanced(begin, end);
+    else
+        submit_per_object(begin, end);
+}
+
+void SceneRenderer::submit_instanced(int begin, int end)
+{
+    const std::vector<DrawPacket>& packets = queue.packets;
+    const Mesh* bound_mesh = nullptr;
+    uint32_t bound_material = ~0u;
+    for (int first = begin; first < end; )
+    {
+        uint64_t state = sort_key_batch_state(packets[first].key);
+        int last = first + 1;
+        while (last < end && sort_key_batch_state(packets[last].key) == state)
+            last++;
+
+        uint32_t mesh_lod = sort_key_mesh(packets[first].key);
+        const Mesh& mesh = meshes[mesh_lod / Mesh::max_lods];
+        const int lod = (int)(mesh_lod % Mesh::max_lods);
+        apply_pass_state(sort_key_pass(packets[first].key));
+        uint32_t material = sort_key_material(packets[first].key);
+        if (material != bound_material)
+        {
+            textures.bind_material(material);
+            bound_material = material;
+            stats.material_binds++;
+        }
+        if (&mesh != bound_mesh)
+        {
+            mesh.bind();
+            bound_mesh = &mesh;
+        }
+        instance_buffer.set_first_instance(MESH_ATTRIB_INSTANCE, first);
+        mesh.draw_instanced(last - first, lod);
+        stats.draw_calls++;
+        stats.instances += last - first;
+        stats.triangles += (long long)(last - first) * (mesh.lods[lod].index_count / 3);
+        first = last;
+    }
+}
+
+void SceneRenderer::submit_per_object(int begin, int end)
+{
+    // Same program and instance data, but one draw call per packet (kept for comparison)
+    const std::vector<DrawPacket>& packets = queue.packets;
+    const Mesh* bound_mesh = nullptr;
+    uint32_t bound_material = ~0u;
+    for (int k = begin; k < end; k++)
+    {
+        uint32_t mesh_lod = sort_key_mesh(packets[k].key);
+        const Mesh& mesh = meshes[mesh_lod / Mesh::max_lods];
+        const int lod = (int)(mesh_lod % Mesh::max_lods);
+        apply_pass_state(sort_key_pass(packets[k].key));
+        uint32_t material = sort_key_material(packets[k].key);
+        if (material != bound_material)
+        {
+            textures.bind_material(material);
+            bound_material = material;
+            stats.material_binds++;
+        }
+        if (&mesh != bound_mesh)
+        {
+            mesh.bind();
+            bound_mesh = &mesh;
+        }
+        instance_buffer.set_first_instance(MESH_ATTRIB_INSTANCE, k);
+        mesh.draw_instanced(1, lod);
+        stats.draw_calls++;
+        stats.instances++;
+        stats.triangles += mesh.lods[lod].index_count / 3;
+    }
+}
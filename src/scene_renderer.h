@@ -0,0 +1,154 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "mesh.h"
+#include "instance_renderer.h"
+#include "render_queue.h"
+#include "render_stats.h"
+#include "frame_uniforms.h"
+#include "shader_manager.h"
+#include "gpu_query.h"
+#include "frustum_culling.h"
+#include "bvh.h"
+#include "occlusion_culling.h"
+#include "light_clusters.h"
+#include "shadow_maps.h"
+#include "texture_streaming.h"
+#include "render_target.h"
+#include "gbuffer.h"
+
+// Camera and target description for one viewport render
+struct SceneView
+{
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    float near_plane = 0.1f;
+    float far_plane = 100.0f;
+    int width = 1;      // Render target size in pixels
+    int height = 1;
+    float time = 0.0f;  // Seconds, for animated shaders
+};
+
+// How SceneRenderer rejects objects outside the view
+enum CullMode
+{
+    CULL_NONE,
+    CULL_SPHERES,       // SIMD test of every object's bounding sphere
+    CULL_BVH            // Walk SceneRenderer::bvh; only visible objects get transforms computed
+};
+
+// How opaque objects are shaded
+enum RenderPath
+{
+    RENDER_PATH_FORWARD,        // Light every fragment as it is drawn
+    RENDER_PATH_DEFERRED        // Write a G-buffer, then light each covered pixel once in a fullscreen pass
+};
+
+// Draws a Scene: frustum-culls the objects, optionally drops those occluded in the Hi-Z of an
+// earlier frame, picks each object's mesh LOD from its screen size, builds one sort-keyed packet
+// per visible object, radix-sorts the queue and submits it in order, merging runs of packets
+// with the same state into instanced draws. The scene's lights are binned into view clusters
+// on the way, and the shading pass lights each fragment from its cluster's list and the sun,
+// shadowed by the shadow maps drawn first. Each object's screen size also drives which mip
+// levels of its texture are streamed in.
+class SceneRenderer
+{
+public:
+    // Requests scene.vert/scene.frag from the shader manager, false if the placeholder fails to build
+    bool init(ShaderManager& shaders);
+    void shutdown();
+
+    // Upload a mesh in vertex_format and return the index scene objects use to refer to it
+    int add_mesh(const MeshData& data);
+
+    // Draw into target, which the caller has bound and cleared. animation is applied in each
+    // object's local space on top of its scene transform.
+    void render(const Scene& scene, const SceneView& view, const glm::mat4& animation, const RenderTarget& target);
+    // Feed the depth just rendered into target to the occlusion culler; call after render()
+    void capture_occluders(const RenderTarget& target);
+
+    std::vector<Mesh> meshes;
+    VertexFormat vertex_format = VertexFormat::compact();  // For meshes added from now on
+    RenderQueue queue;
+    InstanceBuffer instance_buffer;
+    RenderStats stats;
+
+    bool instancing = true;     // Batch packets into instanced draws instead of one draw per object
+    bool wireframe = false;
+    bool depth_test = true;
+    bool depth_prepass = false; // Lay down opaque depth first, then shade with GL_EQUAL
+    bool front_to_back = false; // Strict nearest-first opaque order instead of state-first
+    bool overdraw_view = false; // Additive heat view of shaded fragments (always forward)
+    // Deferred draws opaque objects into gbuffer and lights them in one pass; transparent
+    // objects are still drawn forward on top
+    RenderPath path = RENDER_PATH_FORWARD;
+    GBuffer gbuffer;
+    CullMode cull_mode = CULL_SPHERES;
+    // Scene object bounds for CULL_BVH (see SceneBvh); falls back to spheres while it is out of step
+    const Bvh* bvh = nullptr;
+    // Reject frustum-visible objects hidden behind an earlier frame's depth (needs depth_test)
+    bool occlusion_culling = false;
+    OcclusionCuller occlusion;
+    // Pick each object's mesh LOD from the on-screen size of its simplification error
+    bool lod_enabled = true;
+    float lod_pixel_error = 1.0f;   // Largest error allowed on screen, in pixels
+    float lod_hysteresis = 0.25f;   // Fraction below the limit needed before going coarser
+    // Clustered forward lighting of Scene::lights
+    LightClusters lights;
+    glm::mat4 light_transform = glm::mat4(1.0f);   // Applied to every light before binning
+    float ambient = 0.15f;          // Headlight strength when the scene has lights or a sun (1 without)
+    bool light_heat_view = false;   // Colour fragments by the number of lights in their cluster
+    // Sun cascades and spot/point light shadows, with static casters cached
+    ShadowMaps shadows;
+    // Object textures (Scene::texture_ids), streamed by the screen size of the objects using them
+    TextureStreamer textures;
+    // Objects using different textures of one pool page share a material and batch together
+    // (off: one material per texture, kept for comparison)
+    bool texture_batching = true;
+    glm::vec4 highlight_colour = glm::vec4(1.0f, 0.6f, 0.1f, 1.0f);    // Drawn for selected objects
+
+    // Overdraw of the shading pass (excluding the pre-pass), from a GL_SAMPLES_PASSED query a
+    // few frames old: fragments that passed the depth test per target pixel
+    double shaded_samples = 0.0;
+    float overdraw = 0.0f;
+    // Colour, G-buffer and depth bytes written and read per frame, estimated from shaded_samples:
+    // every sample writes its colour (or G-buffer) and depth, and the lighting pass reads the
+    // G-buffer and depth and writes colour once per pixel. Ignores depth-test reads and caches.
+    double framebuffer_bytes = 0.0;
+    bool deferred_active = false;   // The last frame took the deferred path
+    bool prepass_lost_opaque = false;   // Opaque packets went through the pre-pass but none shaded
+
+private:
+    void apply_pass_state(RenderPass pass);
+    void use_program(ShaderHandle handle);
+    int select_lod(const Mesh& mesh, float pixels_per_mesh_unit, int current) const;
+    // Draw queue.packets[begin, end)
+    void submit(int begin, int end);
+    void submit_instanced(int begin, int end);
+    void submit_per_object(int begin, int end);
+    // Draw this frame's shadow passes; their instances start at first_instance
+    void render_shadows(FrameUniforms uniforms, int first_instance);
+
+    ShaderManager* shader_manager = nullptr;
+    ShaderHandle scene_shader = INVALID_SHADER;
+    ShaderHandle depth_shader = INVALID_SHADER;
+    ShaderHandle overdraw_shader = INVALID_SHADER;
+    ShaderHandle gbuffer_shader = INVALID_SHADER;
+    ShaderHandle lighting_shader = INVALID_SHADER;
+    std::vector<GLuint> block_bound_programs;   // Programs already given the FrameUniforms binding
+    GLint inverse_projection_location = -1;     // Of the lighting program bound last
+    bool prepass_active = false;    // The opaque depth is already laid down; set after the pre-pass draws
+    QueryRing samples_query;
+    FrameUniformBuffer frame_uniforms;
+
+    std::vector<glm::mat4> world_transforms;
+    BoundingSpheres bounds;
+    FrustumCuller culler;
+    std::vector<uint32_t> visible;
+    std::vector<unsigned char> occluded;    // Per entry of visible, filled by the occlusion test
+    glm::mat4 last_view_projection = glm::mat4(1.0f);
+    std::vector<unsigned char> object_lods;     // LOD each object used last frame
+    unsigned lod_layout_version = ~0u;
+};
@@ -0,0 +1,412 @@
+#include "shader_manager.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// On-disk program binary header; any mismatch means the entry is stale and gets rebuilt
+struct ProgramBinaryHeader
+{
+    char magic[8];          // "AEROPBIN"
+    uint32_t version;
+    uint32_t format;        // GLenum from glGetProgramBinary
+    uint64_t key;           // Source hash
+    uint64_t driver_hash;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile (same enum), not in the glad profile
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static const char binary_magic[8] = { 'A', 'E', 'R', 'O', 'P', 'B', 'I', 'N' };
+static const uint32_t binary_version = 1;
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+static uint64_t hash_string(const std::string& s, uint64_t seed)
+{
+    // Hash the terminator too, so "ab"+"c" and "a"+"bc" differ
+    return hash_bytes(s.c_str(), s.size() + 1, seed);
+}
+
+static bool check_shader(GLuint shader, const char* name)
+{
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok == GL_TRUE)
+        return true;
+    char log[2048];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    fprintf(stderr, "Shader compile error in %s:\n%s\n", name, log);
+    return false;
+}
+
+static bool check_program(GLuint program, const char* name)
+{
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok == GL_TRUE)
+        return true;
+    char log[2048];
+    glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+    fprintf(stderr, "Shader link error in %s:\n%s\n", name, log);
+    return false;
+}
+
+void ShaderManager::init(const char* shader_directory, const char* cache_directory, GLADloadproc get_proc)
+{
+    shader_dir = shader_directory;
+    cache_dir = cache_directory;
+
+    // Binaries are only valid for the exact driver that produced them
+    std::string driver;
+    const char* strings[] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+    for (const char* s : strings)
+    {
+        driver += s ? s : "";
+        driver += '|';
+    }
+    driver_hash = hash_string(driver, 14695981039346656037ull);
+
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1 || gl_has_extension("GL_ARB_get_program_binary"))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binaries_supported = formats > 0 && glProgramBinary && glGetProgramBinary && glProgramParameteri;
+    if (binaries_supported)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(cache_dir, error);
+        if (error)
+        {
+            fprintf(stderr, "Shader cache: cannot create %s (%s), binary cache disabled\n", cache_dir.c_str(), error.message().c_str());
+            binaries_supported = false;
+        }
+    }
+
+    // Let the driver pick its compiler thread count; without the extension compiles still
+    // overlap with rendering on most drivers, we just cannot ask whether they have finished
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_compiler_threads = nullptr;
+    if (gl_has_extension("GL_KHR_parallel_shader_compile"))
+        max_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)get_proc("glMaxShaderCompilerThreadsKHR");
+    else if (gl_has_extension("GL_ARB_parallel_shader_compile"))
+        max_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)get_proc("glMaxShaderCompilerThreadsARB");
+    parallel_compile = max_compiler_threads != nullptr;
+    if (parallel_compile)
+        max_compiler_threads(0xFFFFFFFFu);
+}
+
+void ShaderManager::shutdown()
+{
+    for (ProgramEntry& entry : entries)
+    {
+        gl_state().forget_program(entry.program);
+        glDeleteProgram(entry.program);
+        glDeleteShader(entry.vertex_shader);
+        glDeleteShader(entry.fragment_shader);
+    }
+    entries.clear();
+    handles.clear();
+    pending.clear();
+    placeholder = 0;
+}
+
+bool ShaderManager::read_source(const std::string& file, std::string& out, int depth)
+{
+    if (depth > 8)
+    {
+        fprintf(stderr, "Shader include depth exceeded at %s\n", file.c_str());
+        return false;
+    }
+    std::ifstream stream(shader_dir + "/" + file);
+    if (!stream)
+    {
+        fprintf(stderr, "Could not open shader %s/%s\n", shader_dir.c_str(), file.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        // #include "file" is expanded in place
+        size_t first = line.find_first_not_of(" \t");
+        if (first != std::string::npos && line.compare(first, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', first);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                fprintf(stderr, "Malformed #include in %s: %s\n", file.c_str(), line.c_str());
+                return false;
+            }
+            if (!read_source(line.substr(open + 1, close - open - 1), out, depth + 1))
+                return false;
+            continue;
+        }
+        out += line;
+        out += '\n';
+    }
+    return true;
+}
+
+std::string ShaderManager::preprocess(const std::string& source, const std::vector<std::string>& defines)
+{
+    // Defines go straight after #version, which must stay the first statement
+    size_t insert_at = 0;
+    if (source.compare(0, 8, "#version") == 0)
+    {
+        insert_at = source.find('\n');
+        insert_at = insert_at == std::string::npos ? source.size() : insert_at + 1;
+    }
+    std::string block;
+    for (const std::string& define : defines)
+    {
+        std::string d = define;
+        size_t equals = d.find('=');
+        if (equals != std::string::npos)
+            d[equals] = ' ';
+        block += "#define " + d + "\n";
+    }
+    return source.substr(0, insert_at) + block + source.substr(insert_at);
+}
+
+std::string ShaderManager::cache_path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return cache_dir + "/" + name;
+}
+
+GLuint ShaderManager::load_cached_binary(uint64_t key)
+{
+    std::ifstream file(cache_path(key), std::ios::binary);
+    if (!file)
+        return 0;
+    ProgramBinaryHeader header;
+    if (!file.read((char*)&header, sizeof(header)) ||
+        memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0 ||
+        header.version != binary_version || header.key != key || header.driver_hash != driver_hash)
+        return 0;
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE)
+    {
+        // Drivers may reject binaries for reasons the driver string does not capture; just rebuild
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ShaderManager::store_cached_binary(uint64_t key, GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    ProgramBinaryHeader header = {};
+    memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = binary_version;
+    header.format = format;
+    header.key = key;
+    header.driver_hash = driver_hash;
+    header.length = (uint32_t)length;
+
+    // Write to a temporary file first so a crash never leaves a truncated entry behind
+    std::string path = cache_path(key);
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), binary.size());
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+}
+
+ShaderHandle ShaderManager::request_program(const char* vertex_file, const char* fragment_file, const std::vector<std::string>& defines)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vertex_source, fragment_source;
+    if (!read_source(vertex_file, vertex_source, 0) || !read_source(fragment_file, fragment_source, 0))
+    {
+        load_stats.failed++;
+        return INVALID_SHADER;
+    }
+    vertex_source = preprocess(vertex_source, defines);
+    fragment_source = preprocess(fragment_source, defines);
+    uint64_t key = hash_string(fragment_source, hash_string(vertex_source, 14695981039346656037ull));
+
+    auto existing = handles.find(key);
+    if (existing != handles.end())
+        return existing->second;
+
+    ShaderHandle handle = (ShaderHandle)entries.size();
+    entries.emplace_back();
+    ProgramEntry& entry = entries.back();
+    entry.key = key;
+    entry.name = std::string(vertex_file) + " + " + fragment_file;
+    handles[key] = handle;
+
+    if (binaries_supported)
+        entry.program = load_cached_binary(key);
+    if (entry.program)
+    {
+        entry.status = PROGRAM_READY;
+        load_stats.binary_cache_hits++;
+        load_stats.programs++;
+    }
+    else
+    {
+        // Submit everything now and check for errors later; the link waits on the compiles
+        // inside the driver, so nothing here blocks on the compiler
+        const char* vertex_ptr = vertex_source.c_str();
+        const char* fragment_ptr = fragment_source.c_str();
+
+        entry.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(entry.vertex_shader, 1, &vertex_ptr, NULL);
+        glCompileShader(entry.vertex_shader);
+
+        entry.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(entry.fragment_shader, 1, &fragment_ptr, NULL);
+        glCompileShader(entry.fragment_shader);
+
+        entry.program = glCreateProgram();
+        glAttachShader(entry.program, entry.vertex_shader);
+        glAttachShader(entry.program, entry.fragment_shader);
+        if (binaries_supported)
+            glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(entry.program);
+
+        pending.push_back(handle);
+        load_stats.pending = (int)pending.size();
+    }
+
+    load_stats.load_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return handle;
+}
+
+void ShaderManager::finalise(ProgramEntry& entry)
+{
+    bool compiled = check_shader(entry.vertex_shader, entry.name.c_str()) & check_shader(entry.fragment_shader, entry.name.c_str());
+    glDetachShader(entry.program, entry.vertex_shader);
+    glDetachShader(entry.program, entry.fragment_shader);
+    glDeleteShader(entry.vertex_shader);
+    glDeleteShader(entry.fragment_shader);
+    entry.vertex_shader = 0;
+    entry.fragment_shader = 0;
+
+    if (compiled && check_program(entry.program, entry.name.c_str()))
+    {
+        entry.status = PROGRAM_READY;
+        load_stats.compiled++;
+        load_stats.programs++;
+        if (binaries_supported)
+            store_cached_binary(entry.key, entry.program);
+    }
+    else
+    {
+        glDeleteProgram(entry.program);
+        entry.program = 0;
+        entry.status = PROGRAM_FAILED;
+        load_stats.failed++;
+    }
+}
+
+void ShaderManager::update()
+{
+    if (pending.empty())
+        return;
+    auto start = std::chrono::steady_clock::now();
+
+    int finalised = 0;
+    for (size_t i = 0; i < pending.size(); )
+    {
+        ProgramEntry& entry = entries[pending[i]];
+        bool done;
+        if (parallel_compile)
+        {
+            GLint status = GL_FALSE;
+            glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &status);
+            done = status == GL_TRUE;
+        }
+        else
+        {
+            // Status queries block until the link finishes, so take the stall one program at a time
+            done = finalised == 0;
+        }
+        if (!done)
+        {
+            i++;
+            continue;
+        }
+        finalise(entry);
+        finalised++;
+        pending[i] = pending.back();
+        pending.pop_back();
+    }
+    load_stats.pending = (int)pending.size();
+
+    load_stats.load_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+GLuint ShaderManager::load_program(const char* vertex_file, const char* fragment_file, const std::vector<std::string>& defines)
+{
+    ShaderHandle handle = request_program(vertex_file, fragment_file, defines);
+    if (handle == INVALID_SHADER)
+        return 0;
+    ProgramEntry& entry = entries[handle];
+    if (entry.status == PROGRAM_PENDING)
+    {
+        auto start = std::chrono::steady_clock::now();
+        finalise(entry);
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            if (pending[i] == handle)
+            {
+                pending[i] = pending.back();
+                pending.pop_back();
+                break;
+            }
+        }
+        load_stats.pending = (int)pending.size();
+        load_stats.load_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return entry.program;
+}
+
+GLuint ShaderManager::program(ShaderHandle handle) const
+{
+    if (handle < 0 || handle >= (ShaderHandle)entries.size() || entries[handle].status != PROGRAM_READY)
+        return placeholder;
+    return entries[handle].program;
+}
+
+bool ShaderManager::is_ready(ShaderHandle handle) const
+{
+    return handle >= 0 && handle < (ShaderHandle)entries.size() && entries[handle].status == PROGRAM_READY;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Index of a requested program, stable for the lifetime of the manager
+typedef int ShaderHandle;
+static const ShaderHandle INVALID_SHADER = -1;
+
+// Loads GLSL programs from the shader directory and caches their linked binaries on disk.
+//
+// Shader files may #include "other.glsl" (resolved against the shader directory), and each
+// program can be built with a list of defines, so one pair of files yields many permutations.
+// Programs are keyed by a 64-bit hash of the fully preprocessed sources; on later launches
+// the binary stored under that key is reloaded with glProgramBinary, and shaders are only
+// compiled when the sources, defines or driver (vendor/renderer/version string) changed.
+//
+// Compiles are asynchronous: request_program() submits the compile and link straight away and
+// returns a handle, update() polls once per frame, and program() hands out the placeholder
+// until the real program has linked. With KHR/ARB_parallel_shader_compile the driver compiles
+// on its own threads and update() only finalises programs whose GL_COMPLETION_STATUS is set;
+// without it the status query blocks, so update() finalises at most one program per frame.
+class ShaderManager
+{
+public:
+    struct Stats
+    {
+        int programs = 0;
+        int binary_cache_hits = 0;
+        int compiled = 0;
+        int failed = 0;
+        int pending = 0;
+        double load_ms = 0.0;   // CPU time spent submitting and finalising programs
+    };
+
+    // get_proc loads the parallel compile entry points, which glad is not generated with
+    void init(const char* shader_dir, const char* cache_dir, GLADloadproc get_proc);
+    void shutdown();
+
+    // Submit a program build and return its handle. Requests for the same files and defines
+    // share one handle. INVALID_SHADER if the files cannot be read.
+    ShaderHandle request_program(const char* vertex_file, const char* fragment_file, const std::vector<std::string>& defines = {});
+
+    // Poll outstanding compiles, call once per frame
+    void update();
+
+    // Build a program and wait for it; for the placeholder and anything needed before the first frame
+    GLuint load_program(const char* vertex_file, const char* fragment_file, const std::vector<std::string>& defines = {});
+
+    // The linked program, or the placeholder while it is still compiling or if it failed
+    GLuint program(ShaderHandle handle) const;
+    bool is_ready(ShaderHandle handle) const;
+
+    // Drawn in place of programs that are not ready yet, see set_placeholder()
+    void set_placeholder(GLuint program) { placeholder = program; }
+
+    const Stats& stats() const { return load_stats; }
+    bool binary_cache_enabled() const { return binaries_supported; }
+    bool parallel_compile_enabled() const { return parallel_compile; }
+
+private:
+    enum ProgramStatus { PROGRAM_PENDING, PROGRAM_READY, PROGRAM_FAILED };
+
+    struct ProgramEntry
+    {
+        uint64_t key = 0;
+        std::string name;
+        GLuint program = 0;
+        GLuint vertex_shader = 0;       // Only held while pending
+        GLuint fragment_shader = 0;
+        ProgramStatus status = PROGRAM_PENDING;
+    };
+
+    bool read_source(const std::string& file, std::string& out, int depth);
+    std::string preprocess(const std::string& source, const std::vector<std::string>& defines);
+    GLuint load_cached_binary(uint64_t key);
+    void store_cached_binary(uint64_t key, GLuint program);
+    std::string cache_path(uint64_t key) const;
+    void finalise(ProgramEntry& entry);
+
+    std::string shader_dir;
+    std::string cache_dir;
+    uint64_t driver_hash = 0;
+    bool binaries_supported = false;
+    bool parallel_compile = false;
+    GLuint placeholder = 0;
+    std::vector<ProgramEntry> entries;                      // Indexed by ShaderHandle
+    std::unordered_map<uint64_t, ShaderHandle> handles;     // Keyed by the preprocessed source hash
+    std::vector<ShaderHandle> pending;
+    Stats load_stats;
+};
+
+// 64-bit FNV-1a, also used to key other on-disk caches
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
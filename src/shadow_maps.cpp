@@ -0,0 +1,500 @@
+#include "shadow_maps.h"
+#include "scene_renderer.h"
+#include "frame_uniforms.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+static const int tiles_per_row = ShadowMaps::atlas_size / ShadowMaps::tile_size;
+static_assert(tiles_per_row * tiles_per_row == ShadowUniforms::max_tiles, "atlas and tile sizes must give max_tiles tiles");
+
+static bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& centre, float radius)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (glm::dot(glm::vec3(frustum.planes[p]), centre) + frustum.planes[p].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+static GLuint create_depth_texture(GLenum target, int size, int layers)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    gl_state().bind_texture(0, target, texture);
+    if (target == GL_TEXTURE_2D_ARRAY)
+        glTexImage3D(target, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    else
+        glTexImage2D(target, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    // Linear filtering with a compare mode gives 2x2 PCF per lookup in hardware
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    gl_state().bind_texture(0, target, 0);
+    return texture;
+}
+
+static bool create_depth_framebuffer(GLuint& framebuffer, GLuint texture, int layer)
+{
+    glGenFramebuffers(1, &framebuffer);
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (layer >= 0)
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+bool ShadowMaps::init()
+{
+    bool complete = true;
+    for (int s = 0; s < 2; s++)
+    {
+        cascade_textures[s] = create_depth_texture(GL_TEXTURE_2D_ARRAY, s == 0 ? cascade_static_size : cascade_size, cascade_count);
+        atlas_textures[s] = create_depth_texture(GL_TEXTURE_2D, atlas_size, 1);
+        for (int c = 0; c < cascade_count; c++)
+            complete &= create_depth_framebuffer(cascade_framebuffers[s][c], cascade_textures[s], c);
+        complete &= create_depth_framebuffer(atlas_framebuffers[s], atlas_textures[s], -1);
+    }
+    gl_state().bind_framebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+        fprintf(stderr, "Shadow map framebuffers are incomplete\n");
+
+    glGenBuffers(1, &uniform_buffer);
+    gl_state().bind_buffer(GL_UNIFORM_BUFFER, uniform_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), nullptr, GL_DYNAMIC_DRAW);
+    gl_state().bind_buffer(GL_UNIFORM_BUFFER, 0);
+
+    uniforms = ShadowUniforms();
+    tile_owner.assign(ShadowUniforms::max_tiles, -1);
+    light_tiles.clear();
+    invalidate();
+    return complete;
+}
+
+void ShadowMaps::shutdown()
+{
+    for (int s = 0; s < 2; s++)
+    {
+        for (int c = 0; c < cascade_count; c++)
+            gl_state().forget_framebuffer(cascade_framebuffers[s][c]);
+        gl_state().forget_framebuffer(atlas_framebuffers[s]);
+        gl_state().forget_texture(cascade_textures[s]);
+        gl_state().forget_texture(atlas_textures[s]);
+        glDeleteFramebuffers(cascade_count, cascade_framebuffers[s]);
+        glDeleteFramebuffers(1, &atlas_framebuffers[s]);
+    }
+    glDeleteTextures(2, cascade_textures);
+    glDeleteTextures(2, atlas_textures);
+    gl_state().forget_buffer(uniform_buffer);
+    glDeleteBuffers(1, &uniform_buffer);
+    uniform_buffer = 0;
+    for (int s = 0; s < 2; s++)
+    {
+        cascade_textures[s] = atlas_textures[s] = atlas_framebuffers[s] = 0;
+        for (int c = 0; c < cascade_count; c++)
+            cascade_framebuffers[s][c] = 0;
+    }
+    passes.clear();
+    casters.clear();
+    caster_keys.clear();
+}
+
+void ShadowMaps::invalidate()
+{
+    for (CachedView& cache : cascade_cache)
+        cache = CachedView();
+    for (CachedView& cache : tile_cache)
+        cache = CachedView();
+}
+
+size_t ShadowMaps::bytes() const
+{
+    return ((size_t)cascade_static_size * cascade_static_size * cascade_count + (size_t)cascade_size * cascade_size * cascade_count +
+            2 * (size_t)atlas_size * atlas_size) * 4;
+}
+
+bool ShadowMaps::allocate_tiles(int light, int count)
+{
+    // First run of count free tiles; point lights need theirs consecutive (face = tile - first)
+    for (int first = 0; first + count <= ShadowUniforms::max_tiles; first++)
+    {
+        int run = 0;
+        while (run < count && tile_owner[first + run] < 0)
+            run++;
+        if (run < count)
+        {
+            first += run;
+            continue;
+        }
+        for (int t = first; t < first + count; t++)
+            tile_owner[t] = light;
+        light_tiles[light] = first;
+        return true;
+    }
+    return false;
+}
+
+void ShadowMaps::add_casters(const std::vector<uint32_t>& objects, const Scene& scene, const std::vector<unsigned char>& object_lods, Pass& pass)
+{
+    // Sort by mesh/LOD so each run of equal keys is one instanced draw
+    sort_scratch.resize(objects.size());
+    for (size_t k = 0; k < objects.size(); k++)
+    {
+        uint32_t i = objects[k];
+        uint32_t lod = i < object_lods.size() ? object_lods[i] : 0;
+        uint64_t key = (uint64_t)(scene.mesh_ids[i] * Mesh::max_lods + lod);
+        sort_scratch[k] = key << 32 | i;
+    }
+    std::sort(sort_scratch.begin(), sort_scratch.end());
+
+    pass.first_caster = (int)casters.size();
+    pass.caster_count = (int)objects.size();
+    for (uint64_t entry : sort_scratch)
+    {
+        casters.push_back((uint32_t)entry);
+        caster_keys.push_back((uint32_t)(entry >> 32));
+    }
+}
+
+// With depth clamping, casters between the light and the near plane still land at depth 0
+static Frustum caster_frustum(const ShadowMaps::Pass& pass)
+{
+    Frustum frustum = extract_frustum(pass.view_projection);
+    if (pass.depth_clamp)
+        frustum.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return frustum;
+}
+
+void ShadowMaps::add_view(CachedView& cache, bool static_current, const Pass& static_layer, Pass pass,
+                          const Scene& scene, const std::vector<Mesh>& meshes, const Bvh* bvh, const std::vector<unsigned char>& object_lods)
+{
+    // Static layer: only when the caller found the cached one stale
+    if (!static_current || !cache.valid)
+    {
+        const Frustum frustum = caster_frustum(static_layer);
+        const int object_count = scene.size();
+        scratch.clear();
+        if (bvh && bvh->item_count() == object_count)
+        {
+            bvh->query_frustum(frustum, scratch);
+            size_t kept = 0;
+            for (uint32_t i : scratch)
+            {
+                scratch[kept] = i;
+                kept += scene.is_static[i] != 0;
+            }
+            scratch.resize(kept);
+        }
+        else
+        {
+            for (int i = 0; i < object_count; i++)
+            {
+                if (!scene.is_static[i])
+                    continue;
+                glm::mat4 world = scene.object_transform(i);
+                const Mesh& mesh = meshes[scene.mesh_ids[i]];
+                float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                if (sphere_in_frustum(frustum, glm::vec3(world * glm::vec4(mesh.bounds_centre, 1.0f)), mesh.bounds_radius * scale))
+                    scratch.push_back((uint32_t)i);
+            }
+        }
+
+        Pass static_pass = static_layer;
+        static_pass.clear = true;
+        add_casters(scratch, scene, object_lods, static_pass);
+        passes.push_back(static_pass);
+        stats.static_passes++;
+        stats.static_casters += static_pass.caster_count;
+        cache.view_projection = static_layer.view_projection;
+        cache.static_version = scene.static_version;
+        cache.valid = true;
+        cache.clean = false;
+    }
+
+    // Sampled layer: the static depth plus whatever dynamic casters touch the view
+    const Frustum frustum = caster_frustum(pass);
+    scratch.clear();
+    for (size_t k = 0; k < dynamic_objects.size(); k++)
+    {
+        const glm::vec4& sphere = dynamic_spheres[k];
+        if (sphere_in_frustum(frustum, glm::vec3(sphere), sphere.w))
+            scratch.push_back(dynamic_objects[k]);
+    }
+    if (scratch.empty() && cache.clean && cache.copy_x == pass.copy_x && cache.copy_y == pass.copy_y)
+        return;
+    pass.copy_from = static_layer.framebuffer;
+    add_casters(scratch, scene, object_lods, pass);
+    passes.push_back(pass);
+    stats.dynamic_passes++;
+    stats.dynamic_casters += pass.caster_count;
+    cache.clean = scratch.empty();
+    cache.copy_x = pass.copy_x;
+    cache.copy_y = pass.copy_y;
+}
+
+void ShadowMaps::prepare(const Scene& scene, const std::vector<Mesh>& meshes, const Bvh* bvh, const std::vector<unsigned char>& object_lods,
+                         const SceneView& view, const glm::mat4& animation, const glm::mat4& light_transform, bool draw)
+{
+    PROFILE_ZONE("Prepare Shadows");
+    auto start = std::chrono::steady_clock::now();
+    stats = Stats();
+    passes.clear();
+    casters.clear();
+    caster_keys.clear();
+
+    // Tile assignments persist per light index; lights past the end release theirs
+    const int light_count = (int)scene.lights.size();
+    for (int t = 0; t < ShadowUniforms::max_tiles; t++)
+    {
+        if (tile_owner[t] >= light_count)
+            tile_owner[t] = -1;
+    }
+    light_tiles.resize(light_count, -1);
+    uniforms.params = glm::vec4(0.0f, (float)tiles_per_row, 1.0f / (float)tiles_per_row, 1.0f / (float)atlas_size);
+
+    if (!draw || !enabled)
+    {
+        // Nothing gets drawn, so nothing may be sampled; the caches stay valid for their views
+        std::fill(tile_owner.begin(), tile_owner.end(), -1);
+        std::fill(light_tiles.begin(), light_tiles.end(), -1);
+    }
+    else
+    {
+        // Dynamic casters only change with the layout or the static set; their bounds every frame
+        const int object_count = scene.size();
+        if (dynamic_layout_version != scene.layout_version || dynamic_static_version != scene.static_version || dynamic_object_count != object_count)
+        {
+            dynamic_objects.clear();
+            for (int i = 0; i < object_count; i++)
+            {
+                if (!scene.is_static[i])
+                    dynamic_objects.push_back((uint32_t)i);
+            }
+            dynamic_layout_version = scene.layout_version;
+            dynamic_static_version = scene.static_version;
+            dynamic_object_count = object_count;
+        }
+        dynamic_spheres.resize(dynamic_objects.size());
+        job_system().parallel_for((int)dynamic_objects.size(), 16384, [&](int begin, int end)
+        {
+            for (int k = begin; k < end; k++)
+            {
+                uint32_t i = dynamic_objects[k];
+                glm::mat4 world = scene.animated_transform(i, animation);
+                const Mesh& mesh = meshes[scene.mesh_ids[i]];
+                float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                dynamic_spheres[k] = glm::vec4(glm::vec3(world * glm::vec4(mesh.bounds_centre, 1.0f)), mesh.bounds_radius * scale);
+            }
+        });
+
+        const glm::mat4 inverse_view = glm::inverse(view.view);
+        const glm::mat4 to_texture = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+        // Sun cascades: split the view depth range, bound each slice with a sphere and fit an
+        // orthographic light view around it
+        if (scene.sun.enabled && scene.sun.shadows)
+        {
+            const glm::vec3 direction = glm::normalize(scene.sun.direction);
+            const glm::vec3 up = fabsf(direction.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), direction, up);
+            const float near_depth = view.near_plane;
+            const float far_depth = glm::max(glm::min(shadow_distance, view.far_plane), near_depth * 2.0f);
+
+            // View-space corner rays at depth 1
+            const glm::mat4 inverse_projection = glm::inverse(view.projection);
+            glm::vec3 rays[4];
+            for (int r = 0; r < 4; r++)
+            {
+                glm::vec4 p = inverse_projection * glm::vec4((r & 1) ? 1.0f : -1.0f, (r & 2) ? 1.0f : -1.0f, -1.0f, 1.0f);
+                glm::vec3 v = glm::vec3(p) / p.w;
+                rays[r] = v / -v.z;
+            }
+
+            float split_near = near_depth;
+            for (int c = 0; c < cascade_count; c++)
+            {
+                float t = (float)(c + 1) / (float)cascade_count;
+                float split = split_lambda * near_depth * powf(far_depth / near_depth, t) + (1.0f - split_lambda) * (near_depth + (far_depth - near_depth) * t);
+
+                glm::vec3 centre(0.0f);
+                for (int r = 0; r < 4; r++)
+                    centre += rays[r] * (split_near + split);
+                centre /= 8.0f;
+                float radius = 0.0f;
+                for (int r = 0; r < 4; r++)
+                    radius = glm::max(radius, glm::max(glm::length(rays[r] * split_near - centre), glm::length(rays[r] * split - centre)));
+                // Quantise the radius up and snap the centre to whole texels in light space, so the
+                // matrix is unchanged while the camera is still and moves in texel steps otherwise
+                radius = exp2f(ceilf(log2f(glm::max(radius, 1e-3f)) * 8.0f) / 8.0f);
+                const float texel = 2.0f * radius / (float)cascade_size;
+                glm::vec3 snapped = glm::vec3(light_view * inverse_view * glm::vec4(centre, 1.0f));
+                snapped = glm::floor(snapped / texel) * texel;
+
+                // The static layer stays valid for the same sun and radius while this cascade's
+                // window (and depth range) lies inside the padded region drawn around its origin
+                CachedView& cache = cascade_cache[c];
+                const float padding = cascade_padding * texel;
+                const glm::vec3 offset = snapped - cache.origin;
+                const bool static_current = cache.valid && cache.static_version == scene.static_version &&
+                                            cache.light_direction == direction && cache.radius == radius &&
+                                            fabsf(offset.x) <= padding && fabsf(offset.y) <= padding && fabsf(offset.z) <= padding;
+                if (!static_current)
+                {
+                    cache.origin = snapped;
+                    cache.light_direction = direction;
+                    cache.radius = radius;
+                }
+                const glm::vec3 origin = cache.origin;
+                const float near_plane = -origin.z - radius - padding, far_plane = -origin.z + radius + padding;
+
+                Pass static_layer;
+                static_layer.framebuffer = cascade_framebuffers[0][c];
+                static_layer.size = cascade_static_size;
+                static_layer.depth_clamp = true;
+                static_layer.view_projection = glm::ortho(origin.x - radius - padding, origin.x + radius + padding,
+                                                          origin.y - radius - padding, origin.y + radius + padding, near_plane, far_plane) * light_view;
+                // Both layers share the padded depth range, so copied depths stay valid
+                Pass pass;
+                pass.framebuffer = cascade_framebuffers[1][c];
+                pass.size = cascade_size;
+                pass.depth_clamp = true;
+                pass.view_projection = glm::ortho(snapped.x - radius, snapped.x + radius, snapped.y - radius, snapped.y + radius,
+                                                  near_plane, far_plane) * light_view;
+                pass.copy_x = cascade_padding + (int)roundf((snapped.x - origin.x) / texel);
+                pass.copy_y = cascade_padding + (int)roundf((snapped.y - origin.y) / texel);
+
+                uniforms.cascade_matrices[c] = to_texture * pass.view_projection * inverse_view;
+                uniforms.cascade_splits[c] = split;
+                uniforms.cascade_texels[c] = texel;
+                add_view(cache, static_current, static_layer, pass, scene, meshes, bvh, object_lods);
+                split_near = split;
+            }
+            uniforms.params.x = (float)cascade_count;
+        }
+
+        // Atlas: release the tiles of lights that stopped casting or left the view, then give
+        // tiles to the ones that lack them
+        const Frustum view_frustum = extract_frustum(view.projection * view.view);
+        for (int l = 0; l < light_count; l++)
+        {
+            const Light& light = scene.lights[l];
+            glm::vec3 position = glm::vec3(light_transform * glm::vec4(light.position, 1.0f));
+            int want = light.shadows && sphere_in_frustum(view_frustum, position, light.range) ? (light.type == LIGHT_SPOT ? 1 : 6) : 0;
+            int first = light_tiles[l];
+            int held = 0;
+            while (first >= 0 && first + held < ShadowUniforms::max_tiles && tile_owner[first + held] == l)
+                held++;
+            if (held != want && first >= 0)
+            {
+                for (int t = first; t < first + held; t++)
+                    tile_owner[t] = -1;
+                light_tiles[l] = -1;
+            }
+            stats.shadowed_lights += want > 0;
+        }
+        for (int l = 0; l < light_count; l++)
+        {
+            const Light& light = scene.lights[l];
+            if (light_tiles[l] >= 0 || !light.shadows)
+                continue;
+            glm::vec3 position = glm::vec3(light_transform * glm::vec4(light.position, 1.0f));
+            if (sphere_in_frustum(view_frustum, position, light.range) && !allocate_tiles(l, light.type == LIGHT_SPOT ? 1 : 6))
+                stats.dropped_lights++;
+        }
+
+        static const glm::vec3 face_directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        static const glm::vec3 face_ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+        for (int l = 0; l < light_count; l++)
+        {
+            const int first = light_tiles[l];
+            if (first < 0)
+                continue;
+            const Light& light = scene.lights[l];
+            glm::vec3 position = glm::vec3(light_transform * glm::vec4(light.position, 1.0f));
+            float near_plane = light.range * 0.02f;
+            int faces = light.type == LIGHT_SPOT ? 1 : 6;
+            for (int f = 0; f < faces; f++)
+            {
+                glm::mat4 view_projection;
+                if (light.type == LIGHT_SPOT)
+                {
+                    glm::vec3 direction = glm::normalize(glm::vec3(light_transform * glm::vec4(light.direction, 0.0f)));
+                    glm::vec3 up = fabsf(direction.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    float fov = glm::radians(glm::min(2.0f * glm::clamp(light.outer_angle, 1.0f, 89.0f) + 2.0f, 170.0f));
+                    view_projection = glm::perspective(fov, 1.0f, near_plane, light.range) * glm::lookAt(position, position + direction, up);
+                }
+                else
+                {
+                    view_projection = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, light.range) *
+                                      glm::lookAt(position, position + face_directions[f], face_ups[f]);
+                }
+
+                const int tile = first + f;
+                const int x = (tile % tiles_per_row) * tile_size, y = (tile / tiles_per_row) * tile_size;
+                glm::mat4 to_tile = glm::translate(glm::mat4(1.0f), glm::vec3((float)x / atlas_size, (float)y / atlas_size, 0.0f)) *
+                                    glm::scale(glm::mat4(1.0f), glm::vec3((float)tile_size / atlas_size, (float)tile_size / atlas_size, 1.0f));
+                uniforms.tile_matrices[tile] = to_tile * to_texture * view_projection * inverse_view;
+                CachedView& cache = tile_cache[tile];
+                Pass pass;
+                pass.framebuffer = atlas_framebuffers[1];
+                pass.x = pass.copy_x = x;
+                pass.y = pass.copy_y = y;
+                pass.size = tile_size;
+                pass.view_projection = view_projection;
+                Pass static_layer = pass;
+                static_layer.framebuffer = atlas_framebuffers[0];
+                add_view(cache, cache.view_projection == view_projection && cache.static_version == scene.static_version,
+                         static_layer, pass, scene, meshes, bvh, object_lods);
+            }
+        }
+    }
+
+    gl_state().bind_buffer(GL_UNIFORM_BUFFER, uniform_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowUniforms), &uniforms);
+    gl_state().bind_buffer(GL_UNIFORM_BUFFER, 0);
+    stats.prepare_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ShadowMaps::write_instances(InstanceData* out, const Scene& scene, const glm::mat4& animation) const
+{
+    const glm::vec4 white(1.0f);
+    job_system().parallel_for((int)casters.size(), 16384, [&](int begin, int end)
+    {
+        for (int k = begin; k < end; k++)
+            pack_instance(out[k], scene.animated_transform(casters[k], animation), white);
+    });
+}
+
+void ShadowMaps::bind() const
+{
+    gl_state().bind_texture(TEXTURE_UNIT_SHADOW_CASCADES, GL_TEXTURE_2D_ARRAY, cascade_textures[1]);
+    gl_state().bind_texture(TEXTURE_UNIT_SHADOW_ATLAS, GL_TEXTURE_2D, atlas_textures[1]);
+    gl_state().bind_buffer_range(GL_UNIFORM_BUFFER, UNIFORM_BINDING_SHADOWS, uniform_buffer, 0, sizeof(ShadowUniforms));
+}
+
+void ShadowMaps::bind_program(GLuint program)
+{
+    GLuint block = glGetUniformBlockIndex(program, "ShadowUniforms");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, UNIFORM_BINDING_SHADOWS);
+    GLint location = glGetUniformLocation(program, "uShadowCascades");
+    if (location >= 0)
+        glUniform1i(location, TEXTURE_UNIT_SHADOW_CASCADES);
+    location = glGetUniformLocation(program, "uShadowAtlas");
+    if (location >= 0)
+        glUniform1i(location, TEXTURE_UNIT_SHADOW_ATLAS);
+}
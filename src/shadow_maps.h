@@ -0,0 +1,159 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "mesh.h"
+#include "bvh.h"
+#include "instance_renderer.h"
+
+struct SceneView;
+
+// Texture units the shadow maps are bound to while the scene is shaded
+enum
+{
+    TEXTURE_UNIT_SHADOW_CASCADES = 11,
+    TEXTURE_UNIT_SHADOW_ATLAS = 12
+};
+
+// Shadow lookup data, laid out to match the std140 "ShadowUniforms" block in
+// shaders/clustered_lighting.glsl (bound at UNIFORM_BINDING_SHADOWS). Matrices take view-space
+// positions straight to shadow texture space: xy in [0, 1] (inside the tile for the atlas), z = depth.
+struct ShadowUniforms
+{
+    static const int max_tiles = 64;
+
+    glm::mat4 cascade_matrices[4];
+    glm::vec4 cascade_splits;       // Far view depth of each cascade
+    glm::vec4 cascade_texels;       // View-space size of one texel of each cascade, for the normal offset
+    glm::vec4 params;               // x = cascades in use (0: no sun shadows), y = tiles per atlas row, z = 1 / y, w = atlas texel size
+    glm::mat4 tile_matrices[max_tiles];
+};
+
+// Cascaded shadows for the sun plus a spot/point light atlas, with cached static casters.
+//
+// Every shadow view has two depth layers: a cached one holding only static objects
+// (Scene::is_static) and the sampled one. The static layer is redrawn only when the light or
+// Scene::static_version changes; otherwise a frame copies it into the sampled layer and draws
+// just the dynamic casters touching that view on top. A view with no dynamic casters whose
+// sampled layer already matches its static layer is not touched at all, so a still scene costs
+// no shadow passes and a moving one costs a copy plus whatever moved.
+//
+// Cascades are fitted to bounding spheres of the view frustum slices (quantised radius,
+// texel-snapped centre), so they only shift by whole texels as the camera moves. Their static
+// layers cover cascade_padding more texels on every side (and as much again in depth), drawn
+// around the centre they were cached at; the sampled layer copies its window out of that at a
+// texel offset, so the static casters are redrawn only once the camera carries a cascade past
+// the padding. Spot lights take one atlas tile, point lights six (one per cube face); a light
+// keeps its tiles while it stays shadowed and in view, so its cache survives other lights
+// coming and going.
+class ShadowMaps
+{
+public:
+    static const int cascade_count = 4;
+    static const int cascade_size = 1024;
+    static const int cascade_padding = 128;     // Texels cached around each side of a cascade's static layer
+    static const int cascade_static_size = cascade_size + 2 * cascade_padding;
+    static const int atlas_size = 2048;
+    static const int tile_size = 256;
+
+    struct Stats
+    {
+        int static_passes = 0;      // Views whose static layer was redrawn this frame
+        int dynamic_passes = 0;     // Views refreshed from their static layer plus dynamic casters
+        int static_casters = 0;     // Instances drawn into static layers
+        int dynamic_casters = 0;
+        int shadowed_lights = 0;
+        int dropped_lights = 0;     // Shadowed lights in view that did not fit in the atlas
+        double prepare_ms = 0.0;
+    };
+
+    // One depth view to draw this frame; casters[first_caster, + caster_count) are sorted by mesh/LOD
+    struct Pass
+    {
+        GLuint framebuffer = 0;
+        GLuint copy_from = 0;       // Non-zero: blit this framebuffer's depth in first, from copy_x/y
+        int copy_x = 0, copy_y = 0;
+        int x = 0, y = 0, size = 0;
+        bool clear = false;
+        bool depth_clamp = false;   // Cascades: casters in front of the near plane are clamped onto it
+        glm::mat4 view_projection = glm::mat4(1.0f);
+        int first_caster = 0, caster_count = 0;
+    };
+
+    bool init();
+    void shutdown();
+
+    // Pick this frame's shadow views, collect their casters and upload the lookup data. Lights are
+    // moved by light_transform first, objects drawn as Scene::animated_transform(animation).
+    // object_lods gives each object's LOD (entries past its end use LOD 0). With draw false
+    // (shadows off or the depth program not built yet) nothing is drawn and lookups are disabled.
+    void prepare(const Scene& scene, const std::vector<Mesh>& meshes, const Bvh* bvh, const std::vector<unsigned char>& object_lods,
+                 const SceneView& view, const glm::mat4& animation, const glm::mat4& light_transform, bool draw);
+    // Instances for every pass's casters, in pass order; the caller streams them after its own
+    int instance_count() const { return (int)casters.size(); }
+    void write_instances(InstanceData* out, const Scene& scene, const glm::mat4& animation) const;
+
+    // Bind the sampled textures and the uniform block
+    void bind() const;
+    // Point a program's ShadowUniforms block and shadow samplers at their bindings; call once after linking
+    static void bind_program(GLuint program);
+    // Drop every cached static layer
+    void invalidate();
+
+    size_t bytes() const;
+
+    bool enabled = true;
+    float shadow_distance = 8.0f;   // Cascades cover view depths up to this
+    float split_lambda = 0.75f;     // Blend of logarithmic (1) and uniform (0) cascade splits
+    float offset_factor = 1.5f;     // glPolygonOffset while drawing casters
+    float offset_units = 4.0f;
+
+    std::vector<Pass> passes;
+    std::vector<uint32_t> casters;      // Object indices for all passes
+    std::vector<uint32_t> caster_keys;  // mesh * Mesh::max_lods + LOD, per caster
+    std::vector<int> light_tiles;       // Per scene light: first atlas tile, or -1 without a shadow
+    ShadowUniforms uniforms;
+    Stats stats;
+
+private:
+    struct CachedView
+    {
+        glm::mat4 view_projection = glm::mat4(0.0f);    // Of the static layer
+        unsigned static_version = 0;
+        glm::vec3 light_direction = glm::vec3(0.0f);    // Cascades: the sun and cascade radius cached,
+        float radius = 0.0f;                            // and the light-space centre drawn around
+        glm::vec3 origin = glm::vec3(0.0f);
+        int copy_x = -1, copy_y = -1;                   // Where the sampled layer was last copied from
+        bool valid = false;         // The static layer holds this view
+        bool clean = false;         // The sampled layer equals the static layer at copy_x/y
+    };
+
+    // Queue a view's passes: its static layer (redrawn unless static_current) and its sampled
+    // layer, which copies from the static one at pass.copy_x/y
+    void add_view(CachedView& cache, bool static_current, const Pass& static_layer, Pass pass,
+                  const Scene& scene, const std::vector<Mesh>& meshes, const Bvh* bvh, const std::vector<unsigned char>& object_lods);
+    void add_casters(const std::vector<uint32_t>& objects, const Scene& scene, const std::vector<unsigned char>& object_lods, Pass& pass);
+    bool allocate_tiles(int light, int count);
+
+    GLuint cascade_textures[2] = {};    // Static, sampled: depth arrays of cascade_count layers
+    GLuint atlas_textures[2] = {};      // Static, sampled
+    GLuint cascade_framebuffers[2][cascade_count] = {};
+    GLuint atlas_framebuffers[2] = {};
+    GLuint uniform_buffer = 0;
+
+    CachedView cascade_cache[cascade_count];
+    CachedView tile_cache[ShadowUniforms::max_tiles];
+    std::vector<int> tile_owner;        // Light using each tile, or -1
+
+    // Dynamic objects, rebuilt when the scene's layout or static set changes, and their
+    // world bounding spheres for this frame
+    std::vector<uint32_t> dynamic_objects;
+    std::vector<glm::vec4> dynamic_spheres;
+    unsigned dynamic_layout_version = ~0u, dynamic_static_version = ~0u;
+    int dynamic_object_count = -1;
+
+    std::vector<uint32_t> scratch;
+    std::vector<uint64_t> sort_scratch;
+};
@@ -0,0 +1,165 @@
+#include "stream_buffer.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool StreamBuffer::init(GLenum buffer_target, size_t size, int count)
+{
+    target = buffer_target;
+    region_size = size;
+    region_count = count < 1 ? 1 : (count > max_regions ? max_regions : count);
+    persistent = (GLAD_GL_VERSION_4_4 || gl_has_extension("GL_ARB_buffer_storage")) && glBufferStorage != nullptr;
+    if (!persistent)
+        region_count = 1;   // Orphaning hands us fresh storage every frame, one region is enough
+    region = 0;
+    create_storage();
+    return buffer != 0;
+}
+
+void StreamBuffer::shutdown()
+{
+    destroy_storage();
+}
+
+void StreamBuffer::create_storage()
+{
+    glGenBuffers(1, &buffer);
+    gl_state().bind_buffer(target, buffer);
+    GLsizeiptr total = (GLsizeiptr)(region_size * region_count);
+    if (persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(target, 0, total, flags);
+        if (mapped == nullptr)
+        {
+            // Mapping can still fail on odd drivers; drop to the fallback path
+            fprintf(stderr, "Stream buffer: persistent mapping failed, falling back to glBufferSubData\n");
+            gl_state().forget_buffer(buffer);
+            glDeleteBuffers(1, &buffer);
+            persistent = false;
+            region_count = 1;
+            create_storage();
+            return;
+        }
+    }
+    else
+    {
+        glBufferData(target, total, nullptr, GL_STREAM_DRAW);
+        staging.resize(region_size);
+    }
+}
+
+void StreamBuffer::destroy_storage()
+{
+    for (GLsync& fence : fences)
+    {
+        if (fence)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (buffer)
+    {
+        if (persistent && mapped)
+        {
+            gl_state().bind_buffer(target, buffer);
+            glUnmapBuffer(target);
+        }
+        gl_state().forget_buffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    staging.clear();
+}
+
+void StreamBuffer::wait_for_region(int r)
+{
+    GLsync& fence = fences[r];
+    if (!fence)
+        return;
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        frame_stats.fence_waits++;
+        do
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);   // 1 ms
+        while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::begin_frame(size_t min_bytes)
+{
+    frame_stats = Stats();
+
+    if (min_bytes > region_size)
+    {
+        // Grow geometrically; destroy_storage waits for the GPU to finish with every region
+        destroy_storage();
+        region_size = min_bytes + min_bytes / 2;
+        create_storage();
+        region = 0;
+        frame_stats.reallocations++;
+    }
+    else if (persistent)
+    {
+        region = (region + 1) % region_count;
+        wait_for_region(region);
+    }
+
+    if (!persistent)
+    {
+        // Orphan: the driver gives us new storage instead of waiting for draws still using the old one
+        gl_state().bind_buffer(target, buffer);
+        glBufferData(target, (GLsizeiptr)region_size, nullptr, GL_STREAM_DRAW);
+        flushed = 0;
+    }
+    write_offset.store(0, std::memory_order_relaxed);
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+    Allocation allocation;
+    size_t offset = write_offset.load(std::memory_order_relaxed);
+    size_t aligned;
+    do
+    {
+        aligned = (offset + alignment - 1) / alignment * alignment;
+        if (aligned + size > region_size)
+            return allocation;
+    }
+    while (!write_offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+
+    size_t region_base = (size_t)region * region_size;
+    allocation.offset = region_base + aligned;
+    allocation.ptr = persistent ? (void*)(mapped + allocation.offset) : (void*)(staging.data() + aligned);
+    return allocation;
+}
+
+void StreamBuffer::flush()
+{
+    if (persistent)
+        return;
+    // Only upload the bytes written since the previous flush
+    size_t end = write_offset.load(std::memory_order_acquire);
+    if (end > flushed)
+    {
+        gl_state().bind_buffer(target, buffer);
+        glBufferSubData(target, (GLintptr)flushed, (GLsizeiptr)(end - flushed), staging.data() + flushed);
+        flushed = end;
+    }
+}
+
+void StreamBuffer::end_frame()
+{
+    flush();
+    frame_stats.bytes_written = write_offset.load(std::memory_order_relaxed);
+    if (persistent)
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
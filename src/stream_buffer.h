@@ -0,0 +1,71 @@
+#pragma once
+#include <glad/glad.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+// Ring buffer for per-frame dynamic data (instance transforms, debug lines, ...).
+//
+// With ARB_buffer_storage (core in GL 4.4) the buffer is mapped once, persistently and coherently,
+// and split into region_count regions (3 = triple buffering). Each frame writes into the next
+// region, and a glFenceSync placed after the frame's draws tells us when the GPU is done with it,
+// so the CPU only ever waits if it gets more than region_count frames ahead.
+// Without the extension the same interface falls back to a CPU staging copy that is uploaded with
+// buffer orphaning + glBufferSubData at flush().
+//
+// allocate() is lock-free, so worker threads may allocate and write into the current region
+// concurrently; flush()/end_frame() must run on the GL thread after all writers are done.
+class StreamBuffer
+{
+public:
+    struct Allocation
+    {
+        void* ptr = nullptr;    // CPU write pointer, valid until end_frame()
+        size_t offset = 0;      // Byte offset into buffer, for attribute pointers/bind ranges
+    };
+
+    // Counters for the last frame
+    struct Stats
+    {
+        size_t bytes_written = 0;
+        int fence_waits = 0;        // Non-zero if the CPU had to wait for the GPU to release the region
+        int reallocations = 0;      // Non-zero if the buffer had to grow
+    };
+
+    static const int max_regions = 4;
+
+    bool init(GLenum target, size_t region_size, int region_count = 3);
+    void shutdown();
+
+    // Start writing the next region, growing the buffer first if min_bytes does not fit
+    void begin_frame(size_t min_bytes = 0);
+    // Returns a null ptr if the region is full (call begin_frame with a larger min_bytes)
+    Allocation allocate(size_t size, size_t alignment = 16);
+    // Make everything written so far visible to GL, call before drawing from it
+    // (no-op when persistently mapped, since the mapping is coherent)
+    void flush();
+    // Fence the current region; call after the last draw reading this frame's data
+    void end_frame();
+
+    bool is_persistent() const { return persistent; }
+    const Stats& stats() const { return frame_stats; }
+
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint buffer = 0;
+    size_t region_size = 0;
+
+private:
+    void create_storage();
+    void destroy_storage();
+    void wait_for_region(int region);
+
+    bool persistent = false;
+    int region_count = 0;
+    int region = 0;
+    unsigned char* mapped = nullptr;
+    std::vector<unsigned char> staging;     // Fallback path only
+    size_t flushed = 0;                     // Fallback path only
+    GLsync fences[max_regions] = {};
+    std::atomic<size_t> write_offset{ 0 };
+    Stats frame_stats;
+};
@@ -0,0 +1,294 @@
+#include "texture_cache.h"
+#include "job_system.h"
+#include "shader_manager.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+// Bumped whenever the encoders change, so stale cache entries are re-encoded
+static const uint32_t cache_version = 1;
+
+static const uint8_t ktx2_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must match the file layout");
+
+struct Ktx2Level
+{
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+// VkFormat of each TextureFormat (all UNORM; BC1 is the opaque RGB variant)
+static const uint32_t vk_formats[TEXTURE_FORMAT_COUNT] = { 37, 131, 137, 141, 145 };
+
+// Data format descriptor: one basic block describing the texel layout (KHR Data Format spec)
+static std::vector<uint32_t> ktx2_dfd(TextureFormat format)
+{
+    struct Sample { uint32_t channel, offset, bits, upper; };
+    std::vector<Sample> samples;
+    uint32_t model = 1;     // KHR_DF_MODEL_RGBSDA
+    uint32_t block = 0;     // Texel block dimensions minus one, packed per byte
+    switch (format)
+    {
+    case TEXTURE_FORMAT_BC1:
+        model = 128;
+        samples = { { 0, 0, 64, 0xFFFFFFFFu } };
+        break;
+    case TEXTURE_FORMAT_BC3:
+        model = 130;
+        samples = { { 15, 0, 64, 0xFFFFFFFFu }, { 0, 64, 64, 0xFFFFFFFFu } };
+        break;
+    case TEXTURE_FORMAT_BC5:
+        model = 132;
+        samples = { { 0, 0, 64, 0xFFFFFFFFu }, { 1, 64, 64, 0xFFFFFFFFu } };
+        break;
+    case TEXTURE_FORMAT_BC7:
+        model = 134;
+        samples = { { 0, 0, 128, 0xFFFFFFFFu } };
+        break;
+    default:
+        samples = { { 0, 0, 8, 255 }, { 1, 8, 8, 255 }, { 2, 16, 8, 255 }, { 15, 24, 8, 255 } };
+        break;
+    }
+    if (texture_format_is_compressed(format))
+        block = 3 | (3 << 8);
+
+    const uint32_t block_size = 24 + 16 * (uint32_t)samples.size();
+    std::vector<uint32_t> dfd;
+    dfd.push_back(4 + block_size);
+    dfd.push_back(0);                                   // Vendor Khronos, basic descriptor type
+    dfd.push_back(2 | (block_size << 16));              // Version 2
+    dfd.push_back(model | (1 << 8) | (1 << 16));        // BT.709 primaries, linear transfer, straight alpha
+    dfd.push_back(block);
+    dfd.push_back((uint32_t)texture_image_bytes(format, 1, 1));
+    dfd.push_back(0);
+    for (const Sample& sample : samples)
+    {
+        dfd.push_back(sample.offset | ((sample.bits - 1) << 16) | (sample.channel << 24));
+        dfd.push_back(0);
+        dfd.push_back(0);
+        dfd.push_back(sample.upper);
+    }
+    return dfd;
+}
+
+static int level_side(int size, int level)
+{
+    return std::max(size >> level, 1);
+}
+
+bool ktx2_write(const std::string& path, TextureFormat format, int width, int height, const std::vector<std::vector<uint8_t>>& levels)
+{
+    const std::vector<uint32_t> dfd = ktx2_dfd(format);
+    const uint64_t alignment = std::max<uint64_t>(texture_image_bytes(format, 1, 1), 4);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, ktx2_identifier, sizeof(ktx2_identifier));
+    header.vk_format = vk_formats[format];
+    header.type_size = 1;
+    header.pixel_width = (uint32_t)width;
+    header.pixel_height = (uint32_t)height;
+    header.face_count = 1;
+    header.level_count = (uint32_t)levels.size();
+    header.dfd_byte_offset = (uint32_t)(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level));
+    header.dfd_byte_length = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+    // Level data follows the descriptor, smallest level first, each aligned to the block size
+    std::vector<Ktx2Level> index(levels.size());
+    uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+    for (int level = (int)levels.size() - 1; level >= 0; level--)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        index[level].byte_offset = offset;
+        index[level].byte_length = index[level].uncompressed_byte_length = levels[level].size();
+        offset += levels[level].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)index.data(), index.size() * sizeof(Ktx2Level));
+    file.write((const char*)dfd.data(), dfd.size() * sizeof(uint32_t));
+    for (int level = (int)levels.size() - 1; level >= 0; level--)
+    {
+        static const char padding[16] = {};
+        file.write(padding, (std::streamsize)(index[level].byte_offset - (uint64_t)file.tellp()));
+        file.write((const char*)levels[level].data(), levels[level].size());
+    }
+    return (bool)file;
+}
+
+bool ktx2_read_header(const std::string& path, Ktx2Image& image)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    const uint64_t file_size = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    Ktx2Header header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0)
+        return false;
+    int format = 0;
+    while (format < TEXTURE_FORMAT_COUNT && vk_formats[format] != header.vk_format)
+        format++;
+    if (format == TEXTURE_FORMAT_COUNT || header.supercompression_scheme != 0 || header.face_count != 1 ||
+        header.pixel_depth != 0 || header.layer_count != 0 || header.pixel_width == 0 || header.pixel_height == 0 ||
+        header.pixel_width > 16384 || header.pixel_height > 16384 || header.level_count == 0 || header.level_count > 15)
+        return false;
+
+    std::vector<Ktx2Level> index(header.level_count);
+    if (!file.read((char*)index.data(), index.size() * sizeof(Ktx2Level)))
+        return false;
+
+    image.format = (TextureFormat)format;
+    image.width = (int)header.pixel_width;
+    image.height = (int)header.pixel_height;
+    image.levels = (int)header.level_count;
+    image.level_offsets.resize(image.levels);
+    image.level_sizes.resize(image.levels);
+    for (int level = 0; level < image.levels; level++)
+    {
+        const size_t expected = texture_image_bytes(image.format, level_side(image.width, level), level_side(image.height, level));
+        if (index[level].byte_length != expected || index[level].byte_offset + index[level].byte_length > file_size)
+            return false;
+        image.level_offsets[level] = index[level].byte_offset;
+        image.level_sizes[level] = index[level].byte_length;
+    }
+    return true;
+}
+
+bool ktx2_read_level(const std::string& path, const Ktx2Image& image, int level, uint8_t* out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.seekg((std::streamoff)image.level_offsets[level]);
+    return (bool)file.read((char*)out, (std::streamsize)image.level_sizes[level]);
+}
+
+// Next level of a mip chain: each texel averages a 2x2 footprint (clamped once a side reaches 1)
+static void downsample(const uint8_t* source, int width, int height, std::vector<uint8_t>& out)
+{
+    const int out_width = level_side(width, 1);
+    const int out_height = level_side(height, 1);
+    out.resize((size_t)out_width * out_height * 4);
+    job_system().parallel_for(out_height, 16, [&](int begin, int end)
+    {
+        for (int y = begin; y < end; y++)
+        {
+            const uint8_t* row0 = source + (size_t)std::min(y * 2, height - 1) * width * 4;
+            const uint8_t* row1 = source + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+            for (int x = 0; x < out_width; x++)
+            {
+                const int x0 = std::min(x * 2, width - 1) * 4;
+                const int x1 = std::min(x * 2 + 1, width - 1) * 4;
+                uint8_t* texel = out.data() + ((size_t)y * out_width + x) * 4;
+                for (int c = 0; c < 4; c++)
+                    texel[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    });
+}
+
+void TextureCache::init(const char* cache_directory)
+{
+    cache_dir = cache_directory;
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+    cache_ready = !error;
+    if (error)
+        fprintf(stderr, "Texture cache: cannot create %s (%s), textures are not imported\n", cache_dir.c_str(), error.message().c_str());
+}
+
+bool TextureCache::import(const uint8_t* rgba, int width, int height, TextureFormat format, std::string& path)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (!cache_ready || width < 1 || height < 1 || (width & (width - 1)) != 0 || (height & (height - 1)) != 0)
+        return false;
+    stats.imported++;
+
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0)
+        levels++;
+    for (int level = 0; level < levels; level++)
+    {
+        stats.source_bytes += texture_image_bytes(TEXTURE_FORMAT_RGBA8, level_side(width, level), level_side(height, level));
+        stats.encoded_bytes += texture_image_bytes(format, level_side(width, level), level_side(height, level));
+    }
+
+    const uint32_t key_fields[4] = { (uint32_t)width, (uint32_t)height, (uint32_t)format, cache_version };
+    const uint64_t key = hash_bytes(rgba, (size_t)width * height * 4, hash_bytes(key_fields, sizeof(key_fields)));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ktx2", (unsigned long long)key);
+    path = cache_dir + "/" + name;
+
+    Ktx2Image image;
+    if (ktx2_read_header(path, image) && image.format == format && image.width == width && image.height == height && image.levels == levels)
+    {
+        stats.cache_hits++;
+        return true;
+    }
+
+    // Not cached (or stale): build the mip chain and encode every level
+    std::vector<std::vector<uint8_t>> encoded(levels);
+    std::vector<uint8_t> current, next;
+    const uint8_t* source = rgba;
+    for (int level = 0; level < levels; level++)
+    {
+        const int w = level_side(width, level);
+        const int h = level_side(height, level);
+        encoded[level].resize(texture_image_bytes(format, w, h));
+        encode_texture_image(format, source, w, h, encoded[level].data());
+        if (level + 1 < levels)
+        {
+            downsample(source, w, h, next);
+            current.swap(next);
+            source = current.data();
+        }
+    }
+
+    // Write to a temporary file first so a crash never leaves a truncated entry behind
+    const std::string temp_path = path + ".tmp";
+    std::error_code error;
+    if (!ktx2_write(temp_path, format, width, height, encoded))
+    {
+        fprintf(stderr, "Texture cache: cannot write %s\n", temp_path.c_str());
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        fprintf(stderr, "Texture cache: cannot write %s (%s)\n", path.c_str(), error.message().c_str());
+        return false;
+    }
+    stats.encoded++;
+    stats.encode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
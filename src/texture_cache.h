@@ -0,0 +1,53 @@
+#pragma once
+#include "texture_compression.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Layout of a KTX2 file's mip chain (single 2D image, no supercompression)
+struct Ktx2Image
+{
+    TextureFormat format = TEXTURE_FORMAT_RGBA8;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    std::vector<uint64_t> level_offsets;    // Byte offset in the file, per level (level 0 = largest)
+    std::vector<uint64_t> level_sizes;
+};
+
+// Write levels (level 0 first, each texture_image_bytes of its size) as a KTX2 file
+bool ktx2_write(const std::string& path, TextureFormat format, int width, int height, const std::vector<std::vector<uint8_t>>& levels);
+// Read and validate a KTX2 file's header and level index; only formats in TextureFormat are accepted
+bool ktx2_read_header(const std::string& path, Ktx2Image& image);
+// Read one level's data (image.level_sizes[level] bytes)
+bool ktx2_read_level(const std::string& path, const Ktx2Image& image, int level, uint8_t* out);
+
+// Import step for textures: encodes a source image and its mip chain into a GPU format once and
+// keeps the result as a KTX2 file in the cache directory, keyed by a hash of the source pixels,
+// size and format. Later imports of the same content only read the header back, and the
+// streamer loads the levels straight from the file with no runtime encoding or mip generation.
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        int imported = 0;
+        int cache_hits = 0;
+        int encoded = 0;
+        double encode_ms = 0.0;     // Mip generation, encoding and writing, over all imports
+        size_t source_bytes = 0;    // RGBA8 size of the full mip chains imported
+        size_t encoded_bytes = 0;   // Their size in the imported formats
+    };
+
+    void init(const char* cache_dir);
+
+    // Import a width x height RGBA8 image (both powers of two) as format with a full mip chain.
+    // Sets path to the KTX2 file; false if it could not be written.
+    bool import(const uint8_t* rgba, int width, int height, TextureFormat format, std::string& path);
+
+    Stats stats;
+
+private:
+    std::string cache_dir;
+    bool cache_ready = false;
+};
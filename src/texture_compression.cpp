@@ -0,0 +1,518 @@
+#include "texture_compression.h"
+#include "gl_state.h"
+#include "job_system.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// EXT_texture_compression_s3tc, not in the glad profile
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+const char* texture_format_name(TextureFormat format)
+{
+    static const char* names[TEXTURE_FORMAT_COUNT] = { "RGBA8", "BC1", "BC3", "BC5", "BC7" };
+    return format >= 0 && format < TEXTURE_FORMAT_COUNT ? names[format] : "?";
+}
+
+bool texture_format_is_compressed(TextureFormat format)
+{
+    return format != TEXTURE_FORMAT_RGBA8;
+}
+
+GLenum texture_format_gl(TextureFormat format)
+{
+    switch (format)
+    {
+    case TEXTURE_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_FORMAT_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+    case TEXTURE_FORMAT_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return GL_RGBA8;
+    }
+}
+
+static size_t block_bytes(TextureFormat format)
+{
+    return format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+size_t texture_image_bytes(TextureFormat format, int width, int height)
+{
+    if (!texture_format_is_compressed(format))
+        return (size_t)width * height * 4;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+bool texture_format_supported(TextureFormat format)
+{
+    switch (format)
+    {
+    case TEXTURE_FORMAT_BC1:
+    case TEXTURE_FORMAT_BC3: return gl_has_extension("GL_EXT_texture_compression_s3tc");
+    case TEXTURE_FORMAT_BC7: return GLAD_GL_VERSION_4_2 || gl_has_extension("GL_ARB_texture_compression_bptc");
+    default: return true;
+    }
+}
+
+static float clamp_byte(float v)
+{
+    return std::min(std::max(v, 0.0f), 255.0f);
+}
+
+// Mean and principal axis (unit length, or zero for a flat block) of the first channels
+// components of a block's texels, by power iteration on their covariance
+static void principal_axis(const float (*texels)[4], int channels, float* mean, float* axis)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        mean[c] = 0.0f;
+        axis[c] = 0.0f;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < channels; c++)
+            mean[c] += texels[i][c] * (1.0f / 16.0f);
+    }
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[4];
+        for (int c = 0; c < channels; c++)
+            d[c] = texels[i][c] - mean[c];
+        for (int j = 0; j < channels; j++)
+        {
+            for (int k = 0; k < channels; k++)
+                cov[j][k] += d[j] * d[k];
+        }
+    }
+
+    // Start from the column of the channel with the most variance, which is never orthogonal to the axis
+    int start = 0;
+    for (int c = 1; c < channels; c++)
+    {
+        if (cov[c][c] > cov[start][start])
+            start = c;
+    }
+    if (cov[start][start] < 1e-4f)
+        return;
+    for (int c = 0; c < channels; c++)
+        axis[c] = cov[start][c];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float v[4] = {};
+        float largest = 0.0f;
+        for (int j = 0; j < channels; j++)
+        {
+            for (int k = 0; k < channels; k++)
+                v[j] += cov[j][k] * axis[k];
+            largest = std::max(largest, fabsf(v[j]));
+        }
+        if (largest < 1e-8f)
+            break;
+        for (int c = 0; c < channels; c++)
+            axis[c] = v[c] / largest;
+    }
+    float length = 0.0f;
+    for (int c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+    length = sqrtf(length);
+    for (int c = 0; c < channels; c++)
+        axis[c] = length > 1e-8f ? axis[c] / length : 0.0f;
+}
+
+// Endpoints at the extremes of the texels' projections onto the principal axis, pulled in by
+// inset of the range (the palette's end entries then land on texels rather than beyond them)
+static void axis_endpoints(const float (*texels)[4], int channels, float inset, float* a, float* b)
+{
+    float mean[4], axis[4];
+    principal_axis(texels, channels, mean, axis);
+    float lo = 1e30f, hi = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float d = 0.0f;
+        for (int c = 0; c < channels; c++)
+            d += (texels[i][c] - mean[c]) * axis[c];
+        lo = std::min(lo, d);
+        hi = std::max(hi, d);
+    }
+    const float pull = (hi - lo) * inset;
+    lo += pull;
+    hi -= pull;
+    for (int c = 0; c < 4; c++)
+    {
+        a[c] = clamp_byte(mean[c] + axis[c] * lo);
+        b[c] = clamp_byte(mean[c] + axis[c] * hi);
+    }
+}
+
+// Least-squares endpoints for fixed per-texel weights (0 selects a, 1 selects b); false when
+// every texel has the same weight and the system is singular
+static bool fit_endpoints(const float (*texels)[4], const float* weights, int channels, float* a, float* b)
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        const float w = weights[i];
+        const float u = 1.0f - w;
+        aa += u * u;
+        ab += u * w;
+        bb += w * w;
+        for (int c = 0; c < channels; c++)
+        {
+            ax[c] += u * texels[i][c];
+            bx[c] += w * texels[i][c];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < channels; c++)
+    {
+        a[c] = clamp_byte((ax[c] * bb - bx[c] * ab) / det);
+        b[c] = clamp_byte((bx[c] * aa - ax[c] * ab) / det);
+    }
+    return true;
+}
+
+// BC1 -------------------------------------------------------------------------------------------
+
+static uint16_t pack_565(const float* c)
+{
+    int r = (int)(c[0] * (31.0f / 255.0f) + 0.5f);
+    int g = (int)(c[1] * (63.0f / 255.0f) + 0.5f);
+    int b = (int)(c[2] * (31.0f / 255.0f) + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t v, float* c)
+{
+    int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (float)((r << 3) | (r >> 2));
+    c[1] = (float)((g << 2) | (g >> 4));
+    c[2] = (float)((b << 3) | (b >> 2));
+}
+
+// Four-colour mode indices of a block for endpoints c0 and c1, and their squared error
+static float bc1_indices(const float (*texels)[4], uint16_t c0, uint16_t c1, uint32_t& indices)
+{
+    float palette[4][3];
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) * (1.0f / 3.0f);
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) * (1.0f / 3.0f);
+    }
+    float error = 0.0f;
+    indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float best_error = 1e30f;
+        for (int k = 0; k < 4; k++)
+        {
+            float dr = texels[i][0] - palette[k][0];
+            float dg = texels[i][1] - palette[k][1];
+            float db = texels[i][2] - palette[k][2];
+            float e = dr * dr + dg * dg + db * db;
+            if (e < best_error)
+            {
+                best = k;
+                best_error = e;
+            }
+        }
+        indices |= (uint32_t)best << (2 * i);
+        error += best_error;
+    }
+    return error;
+}
+
+static void encode_bc1_block(const float (*texels)[4], uint8_t* out)
+{
+    float a[4], b[4];
+    axis_endpoints(texels, 3, 1.0f / 16.0f, a, b);
+    uint16_t c0 = pack_565(b);
+    uint16_t c1 = pack_565(a);
+    uint32_t indices;
+    float error = bc1_indices(texels, c0, c1, indices);
+
+    // One least-squares pass with the indices fixed
+    static const float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = index_weights[(indices >> (2 * i)) & 3];
+    if (fit_endpoints(texels, weights, 3, a, b))
+    {
+        uint16_t r0 = pack_565(a);
+        uint16_t r1 = pack_565(b);
+        uint32_t refined_indices;
+        if (bc1_indices(texels, r0, r1, refined_indices) < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            indices = refined_indices;
+        }
+    }
+
+    // Four-colour mode needs c0 > c1; swapping the endpoints swaps index 0 with 1 and 2 with 3.
+    // Equal endpoints select three-colour mode, where index 0 is still the endpoint itself.
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        indices ^= 0x55555555u;
+    }
+    else if (c0 == c1)
+    {
+        indices = 0;
+    }
+    out[0] = (uint8_t)c0;
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1;
+    out[3] = (uint8_t)(c1 >> 8);
+    for (int k = 0; k < 4; k++)
+        out[4 + k] = (uint8_t)(indices >> (8 * k));
+}
+
+// BC4 (BC3 alpha, each BC5 channel) -------------------------------------------------------------
+
+static void encode_bc4_block(const float (*texels)[4], int channel, uint8_t* out)
+{
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, texels[i][channel]);
+        hi = std::max(hi, texels[i][channel]);
+    }
+    // Eight-value mode (a0 > a1) interpolates six steps between the extremes
+    const int a0 = (int)(hi + 0.5f);
+    const int a1 = (int)(lo + 0.5f);
+    memset(out, 0, 8);
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    if (a0 == a1)
+        return;
+
+    float palette[8];
+    palette[0] = (float)a0;
+    palette[1] = (float)a1;
+    for (int k = 2; k < 8; k++)
+        palette[k] = ((8 - k) * a0 + (k - 1) * a1) * (1.0f / 7.0f);
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float best_error = 1e30f;
+        for (int k = 0; k < 8; k++)
+        {
+            float e = fabsf(texels[i][channel] - palette[k]);
+            if (e < best_error)
+            {
+                best = k;
+                best_error = e;
+            }
+        }
+        indices |= (uint64_t)best << (3 * i);
+    }
+    for (int k = 0; k < 6; k++)
+        out[2 + k] = (uint8_t)(indices >> (8 * k));
+}
+
+// BC7 mode 6 ------------------------------------------------------------------------------------
+
+static const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Quantise an RGBA endpoint to 7 bits per channel plus the shared p-bit that fits it best; the
+// decoded endpoint is (q << 1) | p. Opaque blocks need p = 1 to decode alpha as exactly 255.
+static void bc7_quantise(const float* c, bool opaque, int* q, int& p)
+{
+    float best_error = 1e30f;
+    for (int pbit = opaque ? 1 : 0; pbit < 2; pbit++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int k = 0; k < 4; k++)
+        {
+            candidate[k] = std::min(std::max((int)floorf((c[k] - pbit) * 0.5f + 0.5f), 0), 127);
+            float d = (float)((candidate[k] << 1) | pbit) - c[k];
+            error += d * d;
+        }
+        if (error < best_error)
+        {
+            best_error = error;
+            p = pbit;
+            memcpy(q, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static float bc7_indices(const float (*texels)[4], const int* q0, int p0, const int* q1, int p1, uint8_t* indices)
+{
+    float palette[16][4];
+    for (int k = 0; k < 16; k++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (q0[c] << 1) | p0;
+            int e1 = (q1[c] << 1) | p1;
+            palette[k][c] = (float)(((64 - bc7_weights[k]) * e0 + bc7_weights[k] * e1 + 32) >> 6);
+        }
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float best_error = 1e30f;
+        for (int k = 0; k < 16; k++)
+        {
+            float e = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                float d = texels[i][c] - palette[k][c];
+                e += d * d;
+            }
+            if (e < best_error)
+            {
+                best = k;
+                best_error = e;
+            }
+        }
+        indices[i] = (uint8_t)best;
+        error += best_error;
+    }
+    return error;
+}
+
+// Appends fields least significant bit first, as BC7 blocks are laid out
+struct BitWriter
+{
+    uint8_t* out;
+    int position = 0;
+
+    void write(uint32_t value, int bits)
+    {
+        for (int k = 0; k < bits; k++, position++)
+        {
+            if ((value >> k) & 1)
+                out[position >> 3] |= (uint8_t)(1 << (position & 7));
+        }
+    }
+};
+
+static void encode_bc7_block(const float (*texels)[4], uint8_t* out)
+{
+    bool opaque = true;
+    for (int i = 0; i < 16; i++)
+        opaque = opaque && texels[i][3] == 255.0f;
+    float a[4], b[4];
+    axis_endpoints(texels, 4, 0.0f, a, b);
+    int q0[4], q1[4], p0 = 0, p1 = 0;
+    bc7_quantise(a, opaque, q0, p0);
+    bc7_quantise(b, opaque, q1, p1);
+    uint8_t indices[16];
+    float error = bc7_indices(texels, q0, p0, q1, p1, indices);
+
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = bc7_weights[indices[i]] * (1.0f / 64.0f);
+    if (fit_endpoints(texels, weights, 4, a, b))
+    {
+        int r0[4], r1[4], rp0 = 0, rp1 = 0;
+        bc7_quantise(a, opaque, r0, rp0);
+        bc7_quantise(b, opaque, r1, rp1);
+        uint8_t refined_indices[16];
+        if (bc7_indices(texels, r0, rp0, r1, rp1, refined_indices) < error)
+        {
+            memcpy(q0, r0, sizeof(q0));
+            memcpy(q1, r1, sizeof(q1));
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices, refined_indices, sizeof(indices));
+        }
+    }
+
+    // The first texel's index is stored without its top bit, so it must be below 8
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; c++)
+            std::swap(q0[c], q1[c]);
+        std::swap(p0, p1);
+        for (int i = 0; i < 16; i++)
+            indices[i] = (uint8_t)(15 - indices[i]);
+    }
+
+    memset(out, 0, 16);
+    BitWriter bits = { out };
+    bits.write(1u << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        bits.write((uint32_t)q0[c], 7);
+        bits.write((uint32_t)q1[c], 7);
+    }
+    bits.write((uint32_t)p0, 1);
+    bits.write((uint32_t)p1, 1);
+    bits.write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        bits.write(indices[i], 4);
+}
+
+// Image ---------------------------------------------------------------------------------------
+
+static void load_block(const uint8_t* rgba, int width, int height, int bx, int by, float (*texels)[4])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        const int sy = std::min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            const int sx = std::min(bx * 4 + x, width - 1);
+            const uint8_t* texel = rgba + ((size_t)sy * width + sx) * 4;
+            for (int c = 0; c < 4; c++)
+                texels[y * 4 + x][c] = (float)texel[c];
+        }
+    }
+}
+
+void encode_texture_image(TextureFormat format, const uint8_t* rgba, int width, int height, uint8_t* out)
+{
+    if (!texture_format_is_compressed(format))
+    {
+        memcpy(out, rgba, texture_image_bytes(format, width, height));
+        return;
+    }
+
+    const int blocks_x = (width + 3) / 4;
+    const int blocks_y = (height + 3) / 4;
+    const size_t bytes = block_bytes(format);
+    job_system().parallel_for(blocks_y, 4, [&](int begin, int end)
+    {
+        float texels[16][4];
+        for (int by = begin; by < end; by++)
+        {
+            for (int bx = 0; bx < blocks_x; bx++)
+            {
+                load_block(rgba, width, height, bx, by, texels);
+                uint8_t* block = out + ((size_t)by * blocks_x + bx) * bytes;
+                switch (format)
+                {
+                case TEXTURE_FORMAT_BC1:
+                    encode_bc1_block(texels, block);
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    encode_bc4_block(texels, 3, block);
+                    encode_bc1_block(texels, block + 8);
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    encode_bc4_block(texels, 0, block);
+                    encode_bc4_block(texels, 1, block + 8);
+                    break;
+                default:
+                    encode_bc7_block(texels, block);
+                    break;
+                }
+            }
+        }
+    });
+}
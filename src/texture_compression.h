@@ -0,0 +1,46 @@
+#pragma once
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// Texel formats a streamed texture can be stored in. The BC formats encode 4x4 texel blocks;
+// smaller levels (2x2, 1x1) still take one whole block.
+//
+//   BC1  RGB, 8 bytes per block (8:1 against RGBA8)      opaque colour
+//   BC3  RGBA, 16 bytes: BC1 colour plus a BC4 alpha     colour with smooth alpha
+//   BC5  RG, 16 bytes: two BC4 channels                  tangent-space normals and other 2-channel data
+//   BC7  RGBA, 16 bytes, much lower error than BC1/BC3   high-quality colour
+enum TextureFormat
+{
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1,
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_BC5,
+    TEXTURE_FORMAT_BC7,
+    TEXTURE_FORMAT_COUNT
+};
+
+// Produces one mip level of a texture in the texture's format (tightly packed RGBA8, or blocks
+// for the BC formats). The streamer runs these on its loader threads, so they must not touch GL
+// or shared state.
+typedef std::function<void(int level, int width, int height, uint8_t* data)> TextureGenerator;
+
+const char* texture_format_name(TextureFormat format);
+bool texture_format_is_compressed(TextureFormat format);
+// GL internal format to create textures of this format with
+GLenum texture_format_gl(TextureFormat format);
+// Bytes of one width x height image
+size_t texture_image_bytes(TextureFormat format, int width, int height);
+// Whether the driver can sample the format: BC1/BC3 need EXT_texture_compression_s3tc, BC7 needs
+// GL 4.2 or ARB_texture_compression_bptc (BC5 is core RGTC). Call on the GL thread.
+bool texture_format_supported(TextureFormat format);
+
+// Encode a width x height RGBA8 image into format (texture_image_bytes(format, width, height)
+// bytes at out). Partial edge blocks repeat the last row and column. Rows of blocks are encoded
+// in parallel on the job system, so this must not be called from inside a job.
+//
+// The encoders fit each block's endpoints along the principal axis of its texels, pick the
+// closest palette entry per texel, then refine the endpoints once by least squares. BC7 uses
+// mode 6 only (one RGBA line with 16 interpolation steps), which handles most colour content well.
+void encode_texture_image(TextureFormat format, const uint8_t* rgba, int width, int height, uint8_t* out);
@@ -0,0 +1,191 @@
+#include "texture_pool.h"
+#include "gl_state.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// The vendored stb_rectpack; ImGui compiles its own static copy, so this one is static too
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+// Skyline packer state of one atlas layer; heap-allocated because the context points into itself
+struct TexturePool::AtlasLayer
+{
+    stbrp_context context;
+    stbrp_node nodes[atlas_size];   // One per column, which stb_rectpack needs to pack without loss
+};
+
+void TexturePool::AtlasLayerDeleter::operator()(AtlasLayer* layer) const
+{
+    delete layer;
+}
+
+void TexturePool::shutdown()
+{
+    for (Page& page : pages)
+    {
+        gl_state().forget_texture(page.texture);
+        glDeleteTextures(1, &page.texture);
+    }
+    pages.clear();
+    bytes = 0;
+}
+
+int TexturePool::create_page(TextureFormat format, int size, int levels, int layers, bool atlas)
+{
+    if ((int)pages.size() >= max_pages)
+    {
+        fprintf(stderr, "Texture pool: all %d pages are in use\n", max_pages);
+        return -1;
+    }
+
+    Page page;
+    page.format = format;
+    page.size = size;
+    page.levels = levels;
+    page.layers = layers;
+    page.atlas = atlas;
+    glGenTextures(1, &page.texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, page.texture);
+    for (int level = 0; level < levels; level++)
+    {
+        const int side = std::max(size >> level, 1);
+        const size_t layer_bytes = texture_image_bytes(format, side, side);
+        if (texture_format_is_compressed(format))
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, texture_format_gl(format), side, side, layers, 0, (GLsizei)(layer_bytes * layers), nullptr);
+        else
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, side, side, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        page.bytes += layer_bytes * layers;
+    }
+    // Atlas textures wrap in the shader, inside their rect; whole layers can use the sampler's wrap
+    const GLint wrap = atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+    if (atlas)
+    {
+        for (int layer = 0; layer < layers; layer++)
+        {
+            page.packers.emplace_back(new AtlasLayer());
+            AtlasLayer& packer = *page.packers.back();
+            stbrp_init_target(&packer.context, atlas_size, atlas_size, packer.nodes, atlas_size);
+        }
+    }
+    bytes += page.bytes;
+    pages.push_back(std::move(page));
+    return (int)pages.size() - 1;
+}
+
+bool TexturePool::add_layer(int size, TextureFormat format, const TextureGenerator& generator, TextureSlot& slot)
+{
+    int levels = 1;
+    while ((size >> levels) > 0)
+        levels++;
+    int index = -1;
+    for (int p = 0; p < (int)pages.size() && index < 0; p++)
+    {
+        const Page& page = pages[p];
+        if (!page.atlas && page.format == format && page.size == size && page.used_layers < page.layers)
+            index = p;
+    }
+    if (index < 0)
+        index = create_page(format, size, levels, array_layers, false);
+    if (index < 0)
+        return false;
+
+    Page& page = pages[index];
+    slot.page = index;
+    slot.layer = page.used_layers++;
+    slot.rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    page.textures++;
+
+    std::vector<uint8_t> data(texture_image_bytes(format, size, size));
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, page.texture);
+    for (int level = 0; level < levels; level++)
+    {
+        const int side = std::max(size >> level, 1);
+        generator(level, side, side, data.data());
+        if (texture_format_is_compressed(format))
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, slot.layer, side, side, 1, texture_format_gl(format),
+                                      (GLsizei)texture_image_bytes(format, side, side), data.data());
+        else
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, slot.layer, side, side, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+    }
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
+
+bool TexturePool::add_atlased(int width, int height, const TextureGenerator& generator, TextureSlot& slot)
+{
+    if (width < 4 || height < 4 || (width & 3) != 0 || (height & 3) != 0 || width > atlas_max_size || height > atlas_max_size)
+        return false;
+
+    // Padded sizes stay multiples of 4, so every packed position is too and the rect scales
+    // exactly down to the last atlas level
+    stbrp_rect rect = {};
+    rect.w = width + 2 * gutter;
+    rect.h = height + 2 * gutter;
+    int index = -1, layer = -1;
+    for (int p = 0; p < (int)pages.size() && index < 0; p++)
+    {
+        Page& page = pages[p];
+        for (int l = 0; page.atlas && l < page.layers && index < 0; l++)
+        {
+            if (stbrp_pack_rects(&page.packers[l]->context, &rect, 1) && rect.was_packed)
+            {
+                index = p;
+                layer = l;
+            }
+        }
+    }
+    if (index < 0)
+    {
+        index = create_page(TEXTURE_FORMAT_RGBA8, atlas_size, atlas_levels, atlas_layers, true);
+        if (index < 0 || !stbrp_pack_rects(&pages[index].packers[0]->context, &rect, 1))
+            return false;
+        layer = 0;
+    }
+
+    Page& page = pages[index];
+    page.used_layers = std::max(page.used_layers, layer + 1);
+    page.textures++;
+    const int x = rect.x + gutter;
+    const int y = rect.y + gutter;
+    slot.page = index;
+    slot.layer = layer;
+    slot.rect = glm::vec4((float)x, (float)y, (float)width, (float)height) / (float)atlas_size;
+
+    // Each level goes in with its gutter filled from the opposite edges
+    std::vector<uint8_t> texels(texture_image_bytes(TEXTURE_FORMAT_RGBA8, width, height));
+    std::vector<uint8_t> padded;
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, page.texture);
+    for (int level = 0; level < atlas_levels; level++)
+    {
+        const int w = width >> level;
+        const int h = height >> level;
+        const int g = gutter >> level;
+        generator(level, w, h, texels.data());
+        const int pw = w + 2 * g;
+        const int ph = h + 2 * g;
+        padded.resize((size_t)pw * ph * 4);
+        for (int py = 0; py < ph; py++)
+        {
+            const int sy = (py - g + h) % h;
+            for (int px = 0; px < pw; px++)
+            {
+                const int sx = (px - g + w) % w;
+                memcpy(&padded[((size_t)py * pw + px) * 4], &texels[((size_t)sy * w + sx) * 4], 4);
+            }
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, (x >> level) - g, (y >> level) - g, layer, pw, ph, 1, GL_RGBA, GL_UNSIGNED_BYTE, padded.data());
+    }
+    gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
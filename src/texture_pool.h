@@ -0,0 +1,70 @@
+#pragma once
+#include "texture_compression.h"
+#include <glad/glad.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Where a pooled texture lives: a layer of one of the pool's GL_TEXTURE_2D_ARRAY pages and the
+// part of that layer it covers, as offset (xy) and scale (zw) in layer UVs
+struct TextureSlot
+{
+    int page = -1;
+    int layer = 0;
+    glm::vec4 rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+// Shares a few array textures between many small, always-resident textures, so objects using
+// different textures still bind the same texture and can be drawn in one instanced call.
+//
+//   - Square power-of-two textures go into array pages of their size and format, one layer each,
+//     with full mip chains.
+//   - Other RGBA8 textures (sides multiples of 4) are packed into the layers of atlas pages with
+//     stb_rectpack. Each gets a gutter of its own texels wrapped around it, so filtering at its
+//     edges repeats like GL_REPEAT would; atlas pages keep atlas_levels mips, which the gutter
+//     covers. The shader wraps UVs into the rect itself.
+//
+// Pages are allocated at full size when first needed and are never freed before shutdown().
+class TexturePool
+{
+public:
+    static const int max_pages = 64;
+    static const int array_layers = 64;         // Layers per same-size page
+    static const int atlas_size = 1024;
+    static const int atlas_layers = 4;
+    static const int atlas_levels = 3;          // 1024, 512 and 256
+    static const int atlas_max_size = 256;      // Largest side packed into an atlas
+    static const int gutter = 4;                // Texels, so one remains at the last atlas level
+
+    // Packer state lives in texture_pool.cpp, which owns stb_rectpack
+    struct AtlasLayer;
+    struct AtlasLayerDeleter { void operator()(AtlasLayer* layer) const; };
+
+    struct Page
+    {
+        GLuint texture = 0;
+        TextureFormat format = TEXTURE_FORMAT_RGBA8;
+        int size = 0;
+        int levels = 0;
+        int layers = 0;
+        int used_layers = 0;                    // Layers holding at least one texture
+        int textures = 0;
+        bool atlas = false;
+        size_t bytes = 0;
+        std::vector<std::unique_ptr<AtlasLayer, AtlasLayerDeleter>> packers;   // Atlas pages only, one per layer
+    };
+
+    void shutdown();
+
+    // Add a size x size texture with a full mip chain to an array page of its size and format
+    bool add_layer(int size, TextureFormat format, const TextureGenerator& generator, TextureSlot& slot);
+    // Pack a width x height RGBA8 texture (sides multiples of 4, at most atlas_max_size) into an atlas
+    bool add_atlased(int width, int height, const TextureGenerator& generator, TextureSlot& slot);
+
+    std::vector<Page> pages;
+    size_t bytes = 0;                           // GPU memory of every page
+
+private:
+    int create_page(TextureFormat format, int size, int levels, int layers, bool atlas);
+};
@@ -0,0 +1,537 @@
+#include "texture_streaming.h"
+#include "texture_cache.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+// The render queue's material field is 12 bits: 0 means untextured, then pool pages, then textures
+static const int max_textures = 4095 - TexturePool::max_pages;
+
+size_t TextureStreamer::level_bytes(TextureFormat format, int size, int level)
+{
+    int side = std::max(size >> level, 1);
+    return texture_image_bytes(format, side, side);
+}
+
+// Define one level of the bound texture; with null data and a zero side this frees it
+static void define_level(TextureFormat format, int level, int side, const uint8_t* data)
+{
+    if (texture_format_is_compressed(format))
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture_format_gl(format), side, side, 0, data ? (GLsizei)texture_image_bytes(format, side, side) : 0, data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, side, side, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+}
+
+bool TextureStreamer::init(int loader_threads)
+{
+    const uint8_t white[4] = { 255, 255, 255, 255 };
+    glGenTextures(1, &white_texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, white_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, 0);
+
+    quit = false;
+    for (int i = 0; i < loader_threads; i++)
+        loaders.emplace_back(&TextureStreamer::loader_loop, this);
+    return true;
+}
+
+void TextureStreamer::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        jobs.clear();
+    }
+    wake.notify_all();
+    for (std::thread& loader : loaders)
+        loader.join();
+    loaders.clear();
+    loaded.clear();
+    ready.clear();
+
+    for (Texture& texture : textures)
+    {
+        gl_state().forget_texture(texture.texture);
+        glDeleteTextures(1, &texture.texture);
+    }
+    textures.clear();
+    pool.shutdown();
+    gl_state().forget_texture(white_texture);
+    glDeleteTextures(1, &white_texture);
+    white_texture = 0;
+    resident_bytes = reserved_bytes = 0;
+}
+
+TextureHandle TextureStreamer::create(const char* name, int size, const TextureGenerator& generator, TextureFormat format)
+{
+    if ((int)textures.size() >= max_textures || size < 1 || (size & (size - 1)) != 0)
+    {
+        fprintf(stderr, "Cannot create texture %s (%d x %d)\n", name, size, size);
+        return INVALID_TEXTURE;
+    }
+    if (!texture_format_supported(format))
+    {
+        fprintf(stderr, "Cannot create texture %s: the driver does not support %s\n", name, texture_format_name(format));
+        return INVALID_TEXTURE;
+    }
+
+    Texture texture;
+    texture.name = name;
+    texture.size = size;
+    texture.format = format;
+    while ((size >> texture.levels) > 0)
+        texture.levels++;
+    while ((size >> texture.tail_level) > tail_size)
+        texture.tail_level++;
+    texture.resident_level = texture.wanted_level = texture.tail_level;
+    texture.generator = generator;
+
+    // Nothing to stream when the whole chain is tail, so the texture can share an array page
+    if (pooling && texture.tail_level == 0)
+    {
+        const size_t pool_bytes = pool.bytes;
+        if (pool.add_layer(size, format, generator, texture.slot))
+        {
+            resident_bytes += pool.bytes - pool_bytes;
+            textures.push_back(texture);
+            return (TextureHandle)textures.size() - 1;
+        }
+    }
+
+    glGenTextures(1, &texture.texture);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, texture.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.tail_level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+
+    // The tail is small (about 21 KB for a 64x64 RGBA8 tail), so it is generated right here
+    std::vector<uint8_t> pixels(level_bytes(format, size, texture.tail_level));
+    for (int level = texture.tail_level; level < texture.levels; level++)
+    {
+        int side = std::max(size >> level, 1);
+        generator(level, side, side, pixels.data());
+        define_level(format, level, side, pixels.data());
+        resident_bytes += level_bytes(format, size, level);
+    }
+    gl_state().bind_texture(0, GL_TEXTURE_2D, 0);
+
+    textures.push_back(texture);
+    return (TextureHandle)textures.size() - 1;
+}
+
+TextureHandle TextureStreamer::create_atlased(const char* name, int width, int height, const TextureGenerator& generator)
+{
+    Texture texture;
+    texture.name = name;
+    texture.size = std::max(width, height);
+    texture.levels = TexturePool::atlas_levels;
+    texture.generator = generator;
+    const size_t pool_bytes = pool.bytes;
+    if ((int)textures.size() >= max_textures || !pool.add_atlased(width, height, generator, texture.slot))
+    {
+        fprintf(stderr, "Cannot create atlased texture %s (%d x %d)\n", name, width, height);
+        return INVALID_TEXTURE;
+    }
+    resident_bytes += pool.bytes - pool_bytes;
+    textures.push_back(texture);
+    return (TextureHandle)textures.size() - 1;
+}
+
+TextureHandle TextureStreamer::create_from_file(const char* name, const std::string& path)
+{
+    Ktx2Image image;
+    if (!ktx2_read_header(path, image) || image.width != image.height || (1 << (image.levels - 1)) != image.width)
+    {
+        fprintf(stderr, "Cannot create texture %s: %s is not a square KTX2 image with a full mip chain\n", name, path.c_str());
+        return INVALID_TEXTURE;
+    }
+    // Every read opens the file itself, so loader threads never share a stream
+    TextureGenerator reader = [path, image](int level, int width, int height, uint8_t* data)
+    {
+        if (!ktx2_read_level(path, image, level, data))
+        {
+            fprintf(stderr, "Cannot read level %d of %s\n", level, path.c_str());
+            memset(data, 0, texture_image_bytes(image.format, width, height));
+        }
+    };
+    return create(name, image.width, reader, image.format);
+}
+
+void TextureStreamer::begin_frame()
+{
+    frame++;
+    for (Texture& texture : textures)
+    {
+        texture.demand_pixels = 0.0f;
+        texture.coverage = 0.0f;
+    }
+}
+
+void TextureStreamer::request(TextureHandle handle, float pixels)
+{
+    if (handle < 0 || handle >= (int)textures.size())
+        return;
+    Texture& texture = textures[handle];
+    pixels = std::max(pixels, 1.0f);
+    texture.demand_pixels = std::max(texture.demand_pixels, pixels);
+    texture.coverage += pixels * pixels;
+    texture.last_used = frame;
+}
+
+uint32_t TextureStreamer::material(TextureHandle handle, bool batch_pooled) const
+{
+    if (handle < 0 || handle >= (int)textures.size())
+        return 0;
+    if (batch_pooled && textures[handle].slot.page >= 0)
+        return 1 + (uint32_t)textures[handle].slot.page;
+    return 1 + TexturePool::max_pages + (uint32_t)handle;
+}
+
+void TextureStreamer::bind_material(uint32_t material) const
+{
+    int page = -1;
+    GLuint texture = white_texture;
+    if (material > TexturePool::max_pages)
+    {
+        const Texture& t = textures[material - 1 - TexturePool::max_pages];
+        page = t.slot.page;
+        texture = t.texture;
+    }
+    else if (material > 0)
+    {
+        page = (int)material - 1;
+    }
+    if (page >= 0)
+        gl_state().bind_texture(TEXTURE_UNIT_ALBEDO_ARRAY, GL_TEXTURE_2D_ARRAY, pool.pages[page].texture);
+    else
+        gl_state().bind_texture(TEXTURE_UNIT_ALBEDO, GL_TEXTURE_2D, texture);
+}
+
+void TextureStreamer::instance_slot(TextureHandle handle, glm::vec4& rect, float& layer) const
+{
+    rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    layer = -1.0f;
+    if (handle >= 0 && handle < (int)textures.size() && textures[handle].slot.page >= 0)
+    {
+        rect = textures[handle].slot.rect;
+        layer = (float)textures[handle].slot.layer;
+    }
+}
+
+void TextureStreamer::bind_samplers(GLuint program)
+{
+    GLint location = glGetUniformLocation(program, "uAlbedoMap");
+    if (location >= 0)
+        glUniform1i(location, TEXTURE_UNIT_ALBEDO);
+    location = glGetUniformLocation(program, "uAlbedoArray");
+    if (location >= 0)
+        glUniform1i(location, TEXTURE_UNIT_ALBEDO_ARRAY);
+}
+
+void TextureStreamer::loader_loop()
+{
+    cpu_profiler().name_thread("Texture Loader");
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || !jobs.empty(); });
+            if (quit)
+                return;
+            // Most needed first; the queue is short, so a linear scan is fine
+            size_t best = 0;
+            for (size_t k = 1; k < jobs.size(); k++)
+            {
+                if (jobs[k].priority > jobs[best].priority)
+                    best = k;
+            }
+            job = std::move(jobs[best]);
+            jobs.erase(jobs.begin() + best);
+            generating++;
+        }
+
+        PROFILE_ZONE("Generate Level");
+        LoadedLevel level;
+        level.texture = job.texture;
+        level.level = job.level;
+        level.pixels.resize(job.bytes);
+        job.generator(job.level, job.size, job.size, level.pixels.data());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.push_back(std::move(level));
+        generating--;
+    }
+}
+
+void TextureStreamer::upload_level(Texture& texture, int level, const uint8_t* pixels)
+{
+    int side = std::max(texture.size >> level, 1);
+    gl_state().bind_texture(0, GL_TEXTURE_2D, texture.texture);
+    define_level(texture.format, level, side, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    texture.resident_level = level;
+    resident_bytes += level_bytes(texture.format, texture.size, level);
+    stats.uploads++;
+    stats.upload_bytes += level_bytes(texture.format, texture.size, level);
+}
+
+void TextureStreamer::evict_level(Texture& texture)
+{
+    // Redefining the level as 0x0 lets the driver free its storage; levels below
+    // GL_TEXTURE_BASE_LEVEL do not count towards completeness
+    const int level = texture.resident_level;
+    gl_state().bind_texture(0, GL_TEXTURE_2D, texture.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    define_level(texture.format, level, 0, nullptr);
+    texture.resident_level = level + 1;
+    resident_bytes -= level_bytes(texture.format, texture.size, level);
+    stats.evictions++;
+}
+
+// How much one level of a texture is worth keeping or loading. Levels finer than anything wants
+// rank below every wanted level, the longest unused first. Wanted levels are worth the texture's
+// screen coverage, doubled for each step coarser than the wanted level, so memory goes to the
+// blurriest textures first instead of one texture getting all its levels before another gets any.
+static float level_priority(const TextureStreamer::Texture& texture, int level, unsigned frame)
+{
+    if (level < texture.wanted_level)
+        return -1.0f - (float)(frame - texture.last_used);
+    return texture.coverage * exp2f((float)(level - texture.wanted_level));
+}
+
+int TextureStreamer::eviction_candidate(float priority) const
+{
+    int best = -1;
+    float best_priority = priority;
+    for (int t = 0; t < (int)textures.size(); t++)
+    {
+        const Texture& texture = textures[t];
+        if (texture.resident_level >= texture.tail_level)
+            continue;
+        float p = level_priority(texture, texture.resident_level, frame);
+        if (p < best_priority)
+        {
+            best = t;
+            best_priority = p;
+        }
+    }
+    return best;
+}
+
+bool TextureStreamer::make_room(size_t bytes, float priority, bool evict)
+{
+    if (resident_bytes + reserved_bytes + bytes <= budget_bytes)
+        return true;
+    if (evict)
+    {
+        while (resident_bytes + reserved_bytes + bytes > budget_bytes)
+        {
+            int victim = eviction_candidate(priority);
+            if (victim < 0)
+                return false;
+            evict_level(textures[victim]);
+        }
+        return true;
+    }
+
+    // Only check: would evicting everything of lower priority free enough? Priorities grow
+    // towards the tail, so each texture's evictable levels are a run from its finest one.
+    size_t evictable = 0;
+    for (const Texture& texture : textures)
+    {
+        for (int level = texture.resident_level; level < texture.tail_level && level_priority(texture, level, frame) < priority; level++)
+            evictable += level_bytes(texture.format, texture.size, level);
+    }
+    return resident_bytes + reserved_bytes + bytes <= budget_bytes + evictable;
+}
+
+void TextureStreamer::update()
+{
+    PROFILE_ZONE("Stream Textures");
+    auto start = std::chrono::steady_clock::now();
+    stats.uploads = stats.evictions = stats.budget_limited = 0;
+    stats.upload_bytes = 0;
+
+    // Wanted level: the coarsest one that still has a texel per pixel of the largest user
+    stats.visible_textures = 0;
+    for (Texture& texture : textures)
+    {
+        texture.wanted_level = texture.tail_level;
+        if (texture.last_used != frame)
+            continue;
+        stats.visible_textures++;
+        float level = floorf(log2f((float)texture.size / texture.demand_pixels));
+        texture.wanted_level = (int)std::min(std::max(level, 0.0f), (float)texture.tail_level);
+    }
+
+    // Take finished levels, and drop queued jobs nobody wants any more
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (LoadedLevel& level : loaded)
+            ready.push_back(std::move(level));
+        loaded.clear();
+        size_t kept = 0;
+        for (size_t k = 0; k < jobs.size(); k++)
+        {
+            Texture& texture = textures[jobs[k].texture];
+            if (jobs[k].level < texture.wanted_level || !streaming)
+            {
+                texture.loading_level = -1;
+                reserved_bytes -= jobs[k].bytes;
+                continue;
+            }
+            jobs[kept++] = std::move(jobs[k]);
+        }
+        jobs.resize(kept);
+        stats.pending_loads = (int)jobs.size() + generating;
+    }
+
+    // Upload the most needed finished levels first, up to the per-frame upload budget
+    std::sort(ready.begin(), ready.end(), [&](const LoadedLevel& a, const LoadedLevel& b)
+    {
+        return level_priority(textures[a.texture], a.level, frame) > level_priority(textures[b.texture], b.level, frame);
+    });
+    size_t kept = 0;
+    for (size_t k = 0; k < ready.size(); k++)
+    {
+        LoadedLevel& level = ready[k];
+        Texture& texture = textures[level.texture];
+        const size_t bytes = level_bytes(texture.format, texture.size, level.level);
+        if (level.level >= texture.wanted_level && stats.uploads > 0 && stats.upload_bytes + bytes > upload_budget)
+        {
+            ready[kept++] = std::move(level);
+            continue;
+        }
+        reserved_bytes -= bytes;
+        texture.loading_level = -1;
+        if (level.level >= texture.wanted_level && level.level == texture.resident_level - 1 &&
+            make_room(bytes, level_priority(texture, level.level, frame), true))
+            upload_level(texture, level.level, level.pixels.data());
+    }
+    ready.resize(kept);
+
+    // Queue the next level of the blurriest, most visible textures
+    if (streaming)
+    {
+        order.clear();
+        for (int t = 0; t < (int)textures.size(); t++)
+        {
+            const Texture& texture = textures[t];
+            if (texture.wanted_level < texture.resident_level && texture.loading_level < 0)
+                order.push_back(t);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            return level_priority(textures[a], textures[a].resident_level - 1, frame) > level_priority(textures[b], textures[b].resident_level - 1, frame);
+        });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        int pending = (int)jobs.size() + generating + (int)ready.size();
+        bool queued = false;
+        for (int t : order)
+        {
+            Texture& texture = textures[t];
+            const int level = texture.resident_level - 1;
+            const size_t bytes = level_bytes(texture.format, texture.size, level);
+            const float priority = level_priority(texture, level, frame);
+            if (!make_room(bytes, priority, false))
+            {
+                stats.budget_limited++;
+                continue;
+            }
+            if (pending >= max_pending_loads)
+                break;
+            Job job;
+            job.texture = t;
+            job.level = level;
+            job.size = std::max(texture.size >> level, 1);
+            job.bytes = bytes;
+            job.priority = priority;
+            job.generator = texture.generator;
+            jobs.push_back(std::move(job));
+            texture.loading_level = level;
+            reserved_bytes += bytes;
+            pending++;
+            queued = true;
+        }
+        stats.pending_loads = pending;
+        lock.unlock();
+        if (queued)
+            wake.notify_all();
+    }
+
+    // A lowered budget takes effect straight away
+    while (resident_bytes > budget_bytes)
+    {
+        int victim = eviction_candidate(1e30f);
+        if (victim < 0)
+            break;
+        evict_level(textures[victim]);
+    }
+    gl_state().bind_texture(0, GL_TEXTURE_2D, 0);
+
+    stats.textures = (int)textures.size();
+    stats.resident_bytes = resident_bytes;
+    stats.requested_bytes = stats.full_bytes = 0;
+    stats.pooled_textures = 0;
+    for (const Texture& texture : textures)
+    {
+        // Pool pages are counted whole, in resident_bytes
+        if (texture.slot.page >= 0)
+        {
+            stats.pooled_textures++;
+            continue;
+        }
+        for (int level = 0; level < texture.levels; level++)
+        {
+            size_t bytes = level_bytes(texture.format, texture.size, level);
+            stats.full_bytes += bytes;
+            if (level >= texture.wanted_level)
+                stats.requested_bytes += bytes;
+        }
+    }
+    stats.update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TextureGenerator make_test_texture(unsigned seed)
+{
+    // Hue from the seed (golden-ratio steps keep neighbouring seeds apart)
+    float hue = fmodf((float)seed * 0.618034f, 1.0f) * 6.0f;
+    float r = std::min(std::max(fabsf(hue - 3.0f) - 1.0f, 0.0f), 1.0f);
+    float g = std::min(std::max(2.0f - fabsf(hue - 2.0f), 0.0f), 1.0f);
+    float b = std::min(std::max(2.0f - fabsf(hue - 4.0f), 0.0f), 1.0f);
+    const uint8_t dark[3] = { (uint8_t)(r * 160.0f + 40.0f), (uint8_t)(g * 160.0f + 40.0f), (uint8_t)(b * 160.0f + 40.0f) };
+    const uint8_t light[3] = { (uint8_t)(r * 55.0f + 200.0f), (uint8_t)(g * 55.0f + 200.0f), (uint8_t)(b * 55.0f + 200.0f) };
+
+    return [=](int level, int width, int height, uint8_t* rgba)
+    {
+        (void)level;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                // 8x8 checker over the whole texture, with grid lines every 16 texels of this level
+                bool checker = (((x * 8) / width) + ((y * 8) / height)) & 1;
+                bool line = width >= 32 && ((x & 15) == 0 || (y & 15) == 0);
+                const uint8_t* c = checker ? dark : light;
+                uint8_t* out = rgba + ((size_t)y * width + x) * 4;
+                out[0] = line ? 30 : c[0];
+                out[1] = line ? 30 : c[1];
+                out[2] = line ? 30 : c[2];
+                out[3] = 255;
+            }
+        }
+    };
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "texture_compression.h"
+#include "texture_pool.h"
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Index of a streamed texture, stable for the lifetime of the streamer
+typedef int TextureHandle;
+static const TextureHandle INVALID_TEXTURE = -1;
+
+// Texture units object textures are bound to (clear of the deferred lighting pass's inputs)
+enum
+{
+    TEXTURE_UNIT_ALBEDO = 4,
+    TEXTURE_UNIT_ALBEDO_ARRAY = 5
+};
+
+// Streams texture mip levels in and out against a GPU memory budget.
+//
+// Only the mip tail (levels of tail_size texels and smaller) is created up front and it is never
+// evicted, so every texture can always be sampled. During culling the renderer reports how many
+// pixels each textured object covers on screen (request()); the most detailed level any object
+// needs is the texture's wanted level. update() then, once per frame on the GL thread:
+//
+//   - uploads finished levels (at most upload_budget bytes per frame) and lowers GL_TEXTURE_BASE_LEVEL
+//   - queues the next missing level of the textures most in need, for the loader threads
+//   - evicts levels while resident memory is over budget, least useful first: levels finer than
+//     anything wants, then those of the textures covering the fewest pixels
+//
+// Levels come in one at a time from coarse to fine, so a texture sharpens progressively. A level's
+// priority is its texture's screen coverage, doubled for every step it is coarser than wanted;
+// a level is only loaded if it fits in the budget or displaces levels of strictly lower priority,
+// so two textures never evict each other back and forth.
+//
+// Textures with nothing to stream (no larger than the tail) and small atlased textures live in
+// the pool instead (see texture_pool.h). All textures on one pool page share a sort-key material,
+// and objects pick their layer and rect through their instance data, so they batch together.
+class TextureStreamer
+{
+public:
+    static const int tail_size = 64;
+
+    struct Stats
+    {
+        int textures = 0;
+        int visible_textures = 0;       // Requested by at least one object this frame
+        int pending_loads = 0;          // Queued or being generated
+        int pooled_textures = 0;
+        int uploads = 0;                // This frame
+        int evictions = 0;              // This frame
+        int budget_limited = 0;         // Textures below their wanted level that the budget keeps out
+        size_t resident_bytes = 0;
+        size_t requested_bytes = 0;     // Resident if every texture had its wanted level
+        size_t full_bytes = 0;          // Every level of every texture
+        size_t upload_bytes = 0;        // This frame
+        double update_ms = 0.0;
+    };
+
+    struct Texture
+    {
+        std::string name;
+        GLuint texture = 0;
+        int size = 0;                   // Level 0 width and height
+        TextureFormat format = TEXTURE_FORMAT_RGBA8;
+        int levels = 0;
+        int tail_level = 0;             // First level of the always-resident tail
+        int resident_level = 0;         // Finest level on the GPU (GL_TEXTURE_BASE_LEVEL)
+        int wanted_level = 0;           // Finest level needed this frame
+        int loading_level = -1;         // Level queued or being generated, or -1
+        float demand_pixels = 0.0f;     // Largest screen size of an object using it this frame
+        float coverage = 0.0f;          // Sum of squared screen sizes this frame, the priority
+        unsigned last_used = 0;         // Frame it was last requested
+        TextureGenerator generator;
+        TextureSlot slot;               // Pool placement, or page -1 for a texture of its own
+    };
+
+    bool init(int loader_threads = 2);
+    void shutdown();
+
+    // Create a size x size texture (size a power of two); its mip tail is generated and uploaded now.
+    // With pooling, textures no larger than the tail go into an array page of the pool.
+    TextureHandle create(const char* name, int size, const TextureGenerator& generator, TextureFormat format = TEXTURE_FORMAT_RGBA8);
+    // Create a small RGBA8 texture of any size (sides multiples of 4, at most TexturePool::atlas_max_size)
+    // packed into a pool atlas; it is created whole and never streams
+    TextureHandle create_atlased(const char* name, int width, int height, const TextureGenerator& generator);
+    // Create a texture from a KTX2 file with a full mip chain (see TextureCache); levels are read
+    // from the file and uploaded as they are, compressed formats with glCompressedTexImage2D
+    TextureHandle create_from_file(const char* name, const std::string& path);
+
+    // Clear this frame's demand; call before the renderer's request() calls
+    void begin_frame();
+    // An object covering pixels on screen uses the texture (UVs spanning [0, 1] across it)
+    void request(TextureHandle texture, float pixels);
+    // Upload, queue and evict levels for this frame's demand (GL thread)
+    void update();
+
+    // Sort-key material for objects using a texture: 0 for none, then one per pool page, then one
+    // per texture. Pooled textures get their page's material when batch_pooled is set.
+    uint32_t material(TextureHandle texture, bool batch_pooled) const;
+    // Bind what a material samples: its own texture (or a white texel) on TEXTURE_UNIT_ALBEDO, or
+    // a pool page on TEXTURE_UNIT_ALBEDO_ARRAY
+    void bind_material(uint32_t material) const;
+    // Array layer (-1 for the texture on TEXTURE_UNIT_ALBEDO) and layer rect an object samples
+    void instance_slot(TextureHandle texture, glm::vec4& rect, float& layer) const;
+    // Point a program's uAlbedoMap and uAlbedoArray samplers at their units; call once after linking
+    static void bind_samplers(GLuint program);
+
+    static size_t level_bytes(TextureFormat format, int size, int level);
+
+    size_t budget_bytes = (size_t)256 << 20;
+    size_t upload_budget = (size_t)32 << 20;   // Bytes uploaded per frame at most
+    int max_pending_loads = 8;
+    bool streaming = true;                     // With false, nothing new is loaded (eviction still runs)
+    bool pooling = true;                       // Place textures created from now on in the pool where possible
+
+    std::vector<Texture> textures;
+    TexturePool pool;
+    Stats stats;
+
+private:
+    struct Job
+    {
+        TextureHandle texture;
+        int level;
+        int size;                   // Of the level
+        size_t bytes;
+        float priority;
+        TextureGenerator generator;
+    };
+
+    struct LoadedLevel
+    {
+        TextureHandle texture;
+        int level;
+        std::vector<uint8_t> pixels;
+    };
+
+    void loader_loop();
+    void upload_level(Texture& texture, int level, const uint8_t* pixels);
+    void evict_level(Texture& texture);
+    // Texture whose finest resident (non-tail) level has the lowest priority below priority, or -1
+    int eviction_candidate(float priority) const;
+    // Evict lower-priority levels until bytes more fit in the budget; false if they cannot
+    bool make_room(size_t bytes, float priority, bool evict);
+
+    GLuint white_texture = 0;
+    unsigned frame = 0;
+    size_t resident_bytes = 0;
+    size_t reserved_bytes = 0;              // Levels queued, generating or waiting for upload
+
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Job> jobs;                  // Guarded by mutex
+    std::vector<LoadedLevel> loaded;        // Guarded by mutex
+    int generating = 0;                     // Guarded by mutex
+    bool quit = false;                      // Guarded by mutex
+    std::vector<LoadedLevel> ready;         // Loaded levels taken off the queue, waiting for upload budget
+    std::vector<int> order;
+};
+
+// Procedural test texture: a coloured checker with a grid whose lines stay one texel wide at every
+// level, so each level has its own detail; hue from seed
+TextureGenerator make_test_texture(unsigned seed);
@@ -0,0 +1,202 @@
+#include "vertex_format.h"
+#include "mesh.h"
+
+#include <math.h>
+#include <string.h>
+
+glm::vec2 octahedral_encode(const glm::vec3& n)
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if (l1 <= 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+    if (n.z < 0.0f)
+    {
+        glm::vec2 folded = glm::vec2(1.0f - fabsf(p.y), 1.0f - fabsf(p.x));
+        p = glm::vec2(p.x >= 0.0f ? folded.x : -folded.x, p.y >= 0.0f ? folded.y : -folded.y);
+    }
+    return p;
+}
+
+glm::vec3 octahedral_decode(const glm::vec2& e)
+{
+    // Same as oct_decode() in shaders/scene.vert
+    glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+    float t = glm::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0u));     // Inf / NaN
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7C00u);                                  // Overflow to infinity
+    if (exponent <= 0)
+    {
+        // Subnormal half (or zero): shift the implicit bit in, rounding to nearest
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    // Round to nearest; a carry out of the mantissa correctly bumps the exponent
+    if (mantissa & 0x1000u)
+        half++;
+    return (uint16_t)half;
+}
+
+static uint16_t to_unorm16(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint16_t)(value * 65535.0f + 0.5f);
+}
+
+static int16_t to_snorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t)lrintf(value * 32767.0f);
+}
+
+static int8_t to_snorm8(float value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int8_t)lrintf(value * 127.0f);
+}
+
+VertexDequantization vertex_dequantization(const std::vector<Vertex>& vertices, const VertexFormat& format)
+{
+    VertexDequantization dequantization;
+    dequantization.octahedral_normals = format.normal != VERTEX_NORMAL_FLOAT;
+    if (vertices.empty())
+        return dequantization;
+
+    glm::vec3 lo = vertices[0].position, hi = lo;
+    glm::vec2 uv_lo = vertices[0].uv, uv_hi = uv_lo;
+    for (const Vertex& v : vertices)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+        uv_lo = glm::min(uv_lo, v.uv);
+        uv_hi = glm::max(uv_hi, v.uv);
+    }
+    if (format.position == VERTEX_POSITION_UNORM16)
+    {
+        dequantization.position_offset = lo;
+        // A flat axis still needs a non-zero scale to avoid dividing by zero while packing
+        dequantization.position_scale = glm::max(hi - lo, glm::vec3(1e-20f));
+    }
+    if (format.uv == VERTEX_UV_UNORM16)
+    {
+        dequantization.uv_offset = uv_lo;
+        dequantization.uv_scale = glm::max(uv_hi - uv_lo, glm::vec2(1e-20f));
+    }
+    return dequantization;
+}
+
+void pack_vertices(const std::vector<Vertex>& vertices, const VertexFormat& format, const VertexDequantization& dequantization, std::vector<unsigned char>& out)
+{
+    const size_t stride = format.stride();
+    out.assign(vertices.size() * stride, 0);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& v = vertices[i];
+        unsigned char* position = &out[i * stride + format.position_offset()];
+        unsigned char* normal = &out[i * stride + format.normal_offset()];
+        unsigned char* uv = &out[i * stride + format.uv_offset()];
+
+        if (format.position == VERTEX_POSITION_FLOAT)
+        {
+            memcpy(position, &v.position, sizeof(glm::vec3));
+        }
+        else
+        {
+            glm::vec3 t = (v.position - dequantization.position_offset) / dequantization.position_scale;
+            uint16_t q[4] = { to_unorm16(t.x), to_unorm16(t.y), to_unorm16(t.z), 0 };
+            memcpy(position, q, sizeof(q));
+        }
+
+        if (format.normal == VERTEX_NORMAL_FLOAT)
+        {
+            memcpy(normal, &v.normal, sizeof(glm::vec3));
+        }
+        else
+        {
+            glm::vec2 e = octahedral_encode(v.normal);
+            if (format.normal == VERTEX_NORMAL_OCT16)
+            {
+                int16_t q[2] = { to_snorm16(e.x), to_snorm16(e.y) };
+                memcpy(normal, q, sizeof(q));
+            }
+            else
+            {
+                int8_t q[2] = { to_snorm8(e.x), to_snorm8(e.y) };
+                memcpy(normal, q, sizeof(q));
+            }
+        }
+
+        if (format.uv == VERTEX_UV_FLOAT)
+        {
+            memcpy(uv, &v.uv, sizeof(glm::vec2));
+        }
+        else if (format.uv == VERTEX_UV_HALF)
+        {
+            uint16_t q[2] = { float_to_half(v.uv.x), float_to_half(v.uv.y) };
+            memcpy(uv, q, sizeof(q));
+        }
+        else
+        {
+            glm::vec2 t = (v.uv - dequantization.uv_offset) / dequantization.uv_scale;
+            uint16_t q[2] = { to_unorm16(t.x), to_unorm16(t.y) };
+            memcpy(uv, q, sizeof(q));
+        }
+    }
+}
+
+void set_vertex_attributes(const VertexFormat& format)
+{
+    const GLsizei stride = (GLsizei)format.stride();
+    glEnableVertexAttribArray(MESH_ATTRIB_POSITION);
+    if (format.position == VERTEX_POSITION_FLOAT)
+        glVertexAttribPointer(MESH_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void*)format.position_offset());
+    else
+        glVertexAttribPointer(MESH_ATTRIB_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)format.position_offset());
+
+    glEnableVertexAttribArray(MESH_ATTRIB_NORMAL);
+    if (format.normal == VERTEX_NORMAL_FLOAT)
+        glVertexAttribPointer(MESH_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (void*)format.normal_offset());
+    else if (format.normal == VERTEX_NORMAL_OCT16)
+        glVertexAttribPointer(MESH_ATTRIB_NORMAL, 2, GL_SHORT, GL_TRUE, stride, (void*)format.normal_offset());
+    else
+        glVertexAttribPointer(MESH_ATTRIB_NORMAL, 2, GL_BYTE, GL_TRUE, stride, (void*)format.normal_offset());
+
+    glEnableVertexAttribArray(MESH_ATTRIB_UV);
+    if (format.uv == VERTEX_UV_FLOAT)
+        glVertexAttribPointer(MESH_ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, stride, (void*)format.uv_offset());
+    else if (format.uv == VERTEX_UV_HALF)
+        glVertexAttribPointer(MESH_ATTRIB_UV, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)format.uv_offset());
+    else
+        glVertexAttribPointer(MESH_ATTRIB_UV, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)format.uv_offset());
+}
+
+void set_vertex_dequantization(const VertexDequantization& d)
+{
+    const glm::vec3& o = d.position_offset;
+    const glm::vec3& s = d.position_scale;
+    glVertexAttrib4f(MESH_ATTRIB_DEQUANT_POSITION_OFFSET, o.x, o.y, o.z, d.octahedral_normals ? 1.0f : 0.0f);
+    glVertexAttrib4f(MESH_ATTRIB_DEQUANT_POSITION_SCALE, s.x, s.y, s.z, 0.0f);
+    glVertexAttrib4f(MESH_ATTRIB_DEQUANT_UV, d.uv_offset.x, d.uv_offset.y, d.uv_scale.x, d.uv_scale.y);
+}
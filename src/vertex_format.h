@@ -0,0 +1,79 @@
+#pragma once
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+// How each vertex attribute is stored in a mesh's vertex buffer. The compact formats quantize:
+//
+//  - positions to unorm16 relative to the mesh's bounding box (the 4th component pads to 8 bytes)
+//  - normals to an octahedral map (the unit sphere folded onto a square) in 2 x snorm16 or snorm8
+//  - UVs to half floats, or to unorm16 relative to the mesh's UV bounds
+//
+// Everything is read back as normalized floats by glVertexAttribPointer, so the vertex shader
+// sees the same inputs for every format. The per-mesh ranges (VertexDequantization) are set as
+// constant values of attributes whose arrays are disabled, which are context state rather than
+// program state: one program handles every format and batching is unaffected.
+enum VertexPositionFormat
+{
+    VERTEX_POSITION_FLOAT = 0,      // 12 bytes
+    VERTEX_POSITION_UNORM16 = 1     // 8 bytes
+};
+
+enum VertexNormalFormat
+{
+    VERTEX_NORMAL_FLOAT = 0,        // 12 bytes
+    VERTEX_NORMAL_OCT16 = 1,        // 4 bytes
+    VERTEX_NORMAL_OCT8 = 2          // 4 bytes (2 used, padded for alignment)
+};
+
+enum VertexUVFormat
+{
+    VERTEX_UV_FLOAT = 0,            // 8 bytes
+    VERTEX_UV_HALF = 1,             // 4 bytes
+    VERTEX_UV_UNORM16 = 2           // 4 bytes
+};
+
+struct VertexFormat
+{
+    VertexPositionFormat position = VERTEX_POSITION_FLOAT;
+    VertexNormalFormat normal = VERTEX_NORMAL_FLOAT;
+    VertexUVFormat uv = VERTEX_UV_FLOAT;
+
+    // 32-byte layout matching Vertex
+    static VertexFormat full() { return VertexFormat(); }
+    // 16 bytes: unorm16 positions, octahedral snorm16 normals, half UVs
+    static VertexFormat compact() { return { VERTEX_POSITION_UNORM16, VERTEX_NORMAL_OCT16, VERTEX_UV_HALF }; }
+
+    size_t position_offset() const { return 0; }
+    size_t normal_offset() const { return position == VERTEX_POSITION_FLOAT ? 12 : 8; }
+    size_t uv_offset() const { return normal_offset() + (normal == VERTEX_NORMAL_FLOAT ? 12 : 4); }
+    size_t stride() const { return uv_offset() + (uv == VERTEX_UV_FLOAT ? 8 : 4); }
+};
+
+// Maps stored attribute values back to mesh space: value * scale + offset
+struct VertexDequantization
+{
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+    glm::vec2 uv_offset = glm::vec2(0.0f);
+    glm::vec2 uv_scale = glm::vec2(1.0f);
+    bool octahedral_normals = false;
+};
+
+// Ranges for packing the vertices in the given format
+VertexDequantization vertex_dequantization(const std::vector<Vertex>& vertices, const VertexFormat& format);
+// Encode the vertices into format.stride() bytes each
+void pack_vertices(const std::vector<Vertex>& vertices, const VertexFormat& format, const VertexDequantization& dequantization, std::vector<unsigned char>& out);
+// Point MESH_ATTRIB_POSITION/NORMAL/UV of the bound VAO at the bound GL_ARRAY_BUFFER
+void set_vertex_attributes(const VertexFormat& format);
+// Set the constant MESH_ATTRIB_DEQUANT* values for the next draws
+void set_vertex_dequantization(const VertexDequantization& dequantization);
+
+// Octahedral normal mapping, in [-1, 1]^2
+glm::vec2 octahedral_encode(const glm::vec3& normal);
+glm::vec3 octahedral_decode(const glm::vec2& encoded);
+uint16_t float_to_half(float value);